@@ -0,0 +1,88 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// Minimal benchmark harness, results are saved as JSON
+class BenchState {
+public:
+    BenchState(double minTime): minTime(minTime), iterations(0), items(1) {}
+
+    // Returns true while the benchmark should keep running, the first call starts the timer
+    inline bool run() {
+        auto now = std::chrono::steady_clock::now();
+        if (iterations++ == 0) {
+            start = now;
+            return true;
+        }
+        stop = now;
+        if (std::chrono::duration<double>(now - start).count() < minTime) return true;
+        --iterations;
+        return false;
+    }
+
+    // Number of processed items (e.g. data points) per iteration
+    inline void setItems(double itemsPerIteration) { items = itemsPerIteration; }
+    inline void setCounter(const std::string& name, double value) { counters.emplace_back(name, value); }
+
+    inline long long getIterations() const { return iterations; }
+    inline double getItems() const { return items; }
+    inline double getTime() const { return iterations ? std::chrono::duration<double>(stop - start).count() : 0; }
+    inline const std::vector<std::pair<std::string, double>>& getCounters() const { return counters; }
+
+private:
+    double minTime;
+    long long iterations;
+    double items;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point stop;
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<void(BenchState&)> func;
+    bool macro;
+};
+
+struct BenchConfig {
+    double minTime = 0.5;   // Minimal time of a single micro benchmark (s)
+    int repetitions = 3;    // Results are reported as median of repetitions
+    int threads = 1;        // Threads used by macro benchmarks
+    int seed = 0;
+    std::string tmpDir = std::filesystem::temp_directory_path().string(); // Directory for files created by benchmarks
+};
+
+void addMicroBenchmarks(std::vector<Benchmark>& benchmarks, BenchConfig& config);
+void addMacroBenchmarks(std::vector<Benchmark>& benchmarks, BenchConfig& config);
+
+// Prevents the compiler from optimizing away the computed value
+template <typename T> inline void doNotOptimize(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
@@ -0,0 +1,117 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <memory>
+
+#include "args.h"
+#include "basic_types.h"
+#include "bench.h"
+#include "matrix.h"
+#include "misc.h"
+#include "model.h"
+#include "synthetic_data.h"
+
+
+struct SyntheticData {
+    SRMatrix trainLabels;
+    SRMatrix trainFeatures;
+    SRMatrix testLabels;
+    SRMatrix testFeatures;
+};
+
+std::shared_ptr<SyntheticData> getData(std::shared_ptr<SyntheticData>& data, const BenchConfig& config) {
+    if (data != nullptr) return data;
+
+    const int trainRows = 10000;
+    const int testRows = 2000;
+    Args args;
+    args.parseArgs({"--labels", "1000", "--features", "20000", "--labelsPerRow", "2", "--featuresPerRow", "30",
+                    "--seed", std::to_string(config.seed)});
+
+    SyntheticDataGenerator generator(args);
+    data = std::make_shared<SyntheticData>();
+    generator.generateRows(data->trainLabels, data->trainFeatures, 0, trainRows);
+    generator.generateRows(data->testLabels, data->testFeatures, trainRows, testRows);
+    return data;
+}
+
+Real precisionAt1(SRMatrix& labels, std::vector<std::vector<Prediction>>& predictions) {
+    int correct = 0;
+    for (int r = 0; r < labels.rows(); ++r) {
+        if (predictions[r].empty()) continue;
+        for (auto& l : labels[r])
+            if (l.index == predictions[r][0].label) ++correct;
+    }
+    return static_cast<Real>(correct) / labels.rows();
+}
+
+void addMacroBenchmarks(std::vector<Benchmark>& benchmarks, BenchConfig& config) {
+    auto data = std::make_shared<std::shared_ptr<SyntheticData>>();
+
+    std::vector<std::pair<std::string, std::vector<std::string>>> models = {
+        {"plt", {"-m", "plt"}},
+        {"plt_beam", {"-m", "plt", "--treeSearchType", "beam"}},
+        // Training time and precision of PLT with subsampled negatives, to compare with the plain PLT
+        {"plt_neg_sampling_8", {"-m", "plt", "--negSamplingRatio", "8"}},
+        {"plt_neg_sampling_1", {"-m", "plt", "--negSamplingRatio", "1"}},
+        {"hsm", {"-m", "hsm", "--pickOneLabelWeighting", "1"}},
+        {"br", {"-m", "br"}}
+    };
+
+    for (auto& m : models) {
+        auto getArgs = [=]() {
+            std::vector<std::string> argsList = m.second;
+            argsList.insert(argsList.end(), {"-o", joinPath(config.tmpDir, m.first), "-t", std::to_string(config.threads),
+                                             "--seed", std::to_string(config.seed)});
+            Args args;
+            args.parseArgs(argsList);
+            return args;
+        };
+
+        auto train = [=](Args& args, SyntheticData& d) {
+            makeDir(args.output);
+            args.saveToFile(joinPath(args.output, "args.bin"));
+            auto model = Model::factory(args);
+            model->train(d.trainLabels, d.trainFeatures, args, args.output);
+        };
+
+        benchmarks.push_back({"train_" + m.first, [=](BenchState& state) {
+            auto d = getData(*data, config);
+            Args args = getArgs();
+            while (state.run()) train(args, *d);
+            state.setItems(d->trainFeatures.rows());
+        }, true});
+
+        benchmarks.push_back({"predict_" + m.first, [=](BenchState& state) {
+            auto d = getData(*data, config);
+            Args args = getArgs();
+            if (!std::filesystem::exists(joinPath(args.output, "weights.bin"))) train(args, *d);
+
+            auto model = Model::factory(args);
+            model->load(args, args.output);
+            std::vector<std::vector<Prediction>> predictions;
+            while (state.run()) predictions = model->predictBatch(d->testFeatures, args);
+            state.setItems(d->testFeatures.rows());
+            state.setCounter("p@1", precisionAt1(d->testLabels, predictions));
+        }, true});
+    }
+}
@@ -0,0 +1,158 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+
+#include "bench.h"
+#include "log.h"
+#include "misc.h"
+#include "version.h"
+
+
+struct BenchResult {
+    std::string name;
+    long long iterations;
+    double nsPerIteration;
+    double itemsPerSecond;
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+void printHelp() {
+    std::cout << R"HELP(Usage: nxc_bench [arg...]
+
+Args:
+    --filter                Run only benchmarks with names matching given regular expression
+    --micro                 Run micro benchmarks (default = 1)
+    --macro                 Run macro benchmarks (default = 1)
+    --minTime               Minimum time of a single run of micro benchmark in seconds (default = 0.5)
+    --repetitions           Number of runs of each benchmark, median is reported (default = 3)
+    -t, --threads           Number of threads used by macro benchmarks (default = 1)
+    --seed                  Seed of generated data (default = 0)
+    --tmpDir                Directory in which a temporary directory for files created by benchmarks
+                            is made (default = system temporary directory)
+    -o, --output            Save results to given JSON file instead of printing them
+    )HELP";
+}
+
+std::string resultsToJson(const std::vector<BenchResult>& results, BenchConfig& config) {
+    std::ostringstream out;
+    out << "{\n  \"version\": \"" << VERSION << "\",\n  \"threads\": " << config.threads
+        << ",\n  \"repetitions\": " << config.repetitions << ",\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto& r = results[i];
+        out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+            << ", \"ns_per_iteration\": " << r.nsPerIteration << ", \"items_per_second\": " << r.itemsPerSecond;
+        for (auto& c : r.counters) out << ", \"" << c.first << "\": " << c.second;
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+int main(int argc, char** argv) {
+    logLevel = NONE;
+
+    BenchConfig config;
+    std::string filter = ".*";
+    std::string output;
+    bool micro = true, macro = true;
+
+    std::vector<std::string> args(argv + 1, argv + argc);
+    try {
+        for (size_t ai = 0; ai < args.size(); ai += 2) {
+            if (args[ai] == "-h" || args[ai] == "--help") {
+                printHelp();
+                return EXIT_SUCCESS;
+            } else if (args[ai] == "--filter")
+                filter = args.at(ai + 1);
+            else if (args[ai] == "--micro")
+                micro = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--macro")
+                macro = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--minTime")
+                config.minTime = std::stod(args.at(ai + 1));
+            else if (args[ai] == "--repetitions")
+                config.repetitions = std::max(1, std::stoi(args.at(ai + 1)));
+            else if (args[ai] == "-t" || args[ai] == "--threads")
+                config.threads = std::max(1, std::stoi(args.at(ai + 1)));
+            else if (args[ai] == "--seed")
+                config.seed = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--tmpDir")
+                config.tmpDir = args.at(ai + 1);
+            else if (args[ai] == "-o" || args[ai] == "--output")
+                output = args.at(ai + 1);
+            else
+                throw std::invalid_argument("Unknown argument: " + args[ai]);
+        }
+    } catch (std::exception& e) {
+        std::cout << e.what() << "\n";
+        printHelp();
+        return EXIT_FAILURE;
+    }
+
+    // Files of benchmarks are kept in own directory, that is removed at the end
+    config.tmpDir = joinPath(config.tmpDir, "nxc_bench_" + std::to_string(
+        std::chrono::system_clock::now().time_since_epoch().count()));
+    makeDir(config.tmpDir);
+
+    std::vector<Benchmark> benchmarks;
+    if (micro) addMicroBenchmarks(benchmarks, config);
+    if (macro) addMacroBenchmarks(benchmarks, config);
+
+    std::regex filterRegex(filter);
+    std::vector<BenchResult> results;
+    for (auto& b : benchmarks) {
+        if (!std::regex_search(b.name, filterRegex)) continue;
+        std::cerr << "Running " << b.name << " ...\n";
+
+        // Report median of repetitions by time per iteration
+        std::vector<BenchResult> runs;
+        for (int r = 0; r < config.repetitions; ++r) {
+            BenchState state(b.macro ? 0 : config.minTime);
+            b.func(state);
+            long long iterations = std::max(1LL, state.getIterations());
+            double time = state.getTime();
+            runs.push_back({b.name, iterations, time * 1e9 / iterations, time > 0 ? state.getItems() * iterations / time : 0,
+                            state.getCounters()});
+        }
+        std::sort(runs.begin(), runs.end(), [](const BenchResult& a, const BenchResult& b) {
+            return a.nsPerIteration < b.nsPerIteration;
+        });
+        results.push_back(runs[runs.size() / 2]);
+    }
+
+    remove(config.tmpDir);
+
+    std::string json = resultsToJson(results, config);
+    if (output.empty()) std::cout << json;
+    else {
+        std::ofstream out(output);
+        out << json;
+    }
+
+    return EXIT_SUCCESS;
+}
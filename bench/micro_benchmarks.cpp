@@ -0,0 +1,255 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+
+#include "args.h"
+#include "base.h"
+#include "basic_types.h"
+#include "bench.h"
+#include "kmeans.h"
+#include "label_tree.h"
+#include "misc.h"
+#include "read_data.h"
+#include "vector.h"
+
+
+// Random sparse vector with given number of non-zero features from [0, size) range, sorted by index
+std::vector<IRVPair> randomFeatures(std::default_random_engine& rng, int size, int nonZero) {
+    std::uniform_int_distribution<int> indexDist(0, size - 1);
+    std::uniform_real_distribution<Real> valueDist(-1, 1);
+    UnorderedMap<int, Real> features;
+    while (features.size() < nonZero) features[indexDist(rng)] = valueDist(rng);
+
+    std::vector<IRVPair> vec;
+    for (auto& f : features) vec.emplace_back(f.first, f.second);
+    std::sort(vec.begin(), vec.end(), IRVPairIndexComp());
+    return vec;
+}
+
+std::shared_ptr<AbstractVector> toRepresentation(MapVector& vec, RepresentationType type) {
+    // Implicit copy constructor of MapVector is shallow, so conversion from AbstractVector is used
+    const AbstractVector& src = vec;
+    std::shared_ptr<AbstractVector> result;
+    if (type == dense) result = std::make_shared<Vector>(src);
+    else if (type == map) result = std::make_shared<MapVector>(src);
+    else result = std::make_shared<SparseVector>(src);
+    result->resize(vec.size());
+    result->checkD();
+    return result;
+}
+
+void addVectorBenchmarks(std::vector<Benchmark>& benchmarks, BenchConfig& config) {
+    const int size = 100000;
+    const int weightsNonZero = 10000;
+    const int featuresNonZero = 100;
+    const int rows = 256;
+
+    std::vector<std::pair<std::string, RepresentationType>> types = {{"dense", dense}, {"map", map}, {"sparse", sparse}};
+    for (auto& t : types) {
+        RepresentationType type = t.second;
+
+        // Features are drawn from non-zero weights, so adding them does not change the sparsity of weights
+        auto prepare = [=](std::shared_ptr<AbstractVector>& W, std::vector<SparseVector>& features) {
+            std::default_random_engine rng(config.seed);
+            auto weights = randomFeatures(rng, size, weightsNonZero);
+            MapVector mapW;
+            for (auto& w : weights) mapW.insertD(w.index, w.value);
+            mapW.resize(size);
+            W = toRepresentation(mapW, type);
+
+            std::uniform_int_distribution<int> weightDist(0, weightsNonZero - 1);
+            for (int r = 0; r < rows; ++r) {
+                UnorderedMap<int, Real> rFeatures;
+                while (rFeatures.size() < featuresNonZero) rFeatures[weights[weightDist(rng)].index] = 1.0 / featuresNonZero;
+                std::vector<IRVPair> vec;
+                for (auto& f : rFeatures) vec.emplace_back(f.first, f.second);
+                features.emplace_back(vec, false);
+            }
+        };
+
+        benchmarks.push_back({"vector_dot_" + t.first, [=](BenchState& state) {
+            std::shared_ptr<AbstractVector> W;
+            std::vector<SparseVector> features;
+            prepare(W, features);
+
+            while (state.run())
+                for (auto& f : features) doNotOptimize(W->dot(f));
+            state.setItems(rows);
+        }, false});
+
+        benchmarks.push_back({"vector_add_" + t.first, [=](BenchState& state) {
+            std::shared_ptr<AbstractVector> W;
+            std::vector<SparseVector> features;
+            prepare(W, features);
+
+            while (state.run())
+                for (auto& f : features) W->add(f, 0.001);
+            doNotOptimize(W->at(0));
+            state.setItems(rows);
+        }, false});
+    }
+}
+
+void addReadLineBenchmark(std::vector<Benchmark>& benchmarks, BenchConfig& config) {
+    benchmarks.push_back({"read_line", [=](BenchState& state) {
+        const int lines = 1000;
+        std::default_random_engine rng(config.seed);
+        std::uniform_int_distribution<int> labelDist(0, 9999);
+
+        // Lines in libsvm format with 1-5 labels and 100 features
+        std::vector<std::string> data;
+        for (int i = 0; i < lines; ++i) {
+            std::ostringstream line;
+            int labels = 1 + i % 5;
+            for (int l = 0; l < labels; ++l) line << (l ? "," : "") << labelDist(rng);
+            for (auto& f : randomFeatures(rng, 100000, 100)) line << " " << f.index << ":" << f.value;
+            data.push_back(line.str());
+        }
+
+        std::vector<IRVPair> lLabels;
+        std::vector<IRVPair> lFeatures;
+        while (state.run()) {
+            for (auto& line : data) {
+                lLabels.clear();
+                lFeatures.clear();
+                prepareFeaturesVector(lFeatures);
+                readLine(line, lLabels, lFeatures);
+                processFeaturesVector(lFeatures);
+                doNotOptimize(lFeatures.data());
+            }
+        }
+        state.setItems(lines);
+    }, false});
+}
+
+void addTopKQueueBenchmark(std::vector<Benchmark>& benchmarks, BenchConfig& config) {
+    benchmarks.push_back({"top_k_queue", [=](BenchState& state) {
+        const int k = 5;
+        const int nodes = 1000;
+        std::default_random_engine rng(config.seed);
+        std::uniform_real_distribution<Real> dist(0, 1);
+        std::vector<TreeNodeValue> values;
+        for (int i = 0; i < nodes; ++i) values.emplace_back(nullptr, dist(rng));
+
+        while (state.run()) {
+            TopKQueue<TreeNodeValue> queue(k);
+            for (int i = 0; i < nodes; ++i) queue.push(values[i], i % 10 == 0);
+            while (!queue.empty()) {
+                doNotOptimize(queue.top().value);
+                queue.pop();
+            }
+        }
+        state.setItems(nodes);
+    }, false});
+}
+
+void addLabelTreeBenchmark(std::vector<Benchmark>& benchmarks, BenchConfig& config) {
+    benchmarks.push_back({"label_tree_traversal", [=](BenchState& state) {
+        Args args;
+        args.arity = 16;
+        LabelTree tree;
+        tree.buildCompleteTree(100000, false, args);
+
+        // Breadth-first traversal of the whole tree and paths from leaves to the root
+        std::vector<TreeNode*> queue;
+        while (state.run()) {
+            queue.clear();
+            queue.push_back(tree.root);
+            for (size_t i = 0; i < queue.size(); ++i)
+                queue.insert(queue.end(), queue[i]->children.begin(), queue[i]->children.end());
+
+            long long pathsLength = 0;
+            for (auto l : tree.leaves)
+                if (l != nullptr)
+                    for (TreeNode* n = l; n != nullptr; n = n->parent) ++pathsLength;
+            doNotOptimize(pathsLength);
+        }
+        state.setItems(tree.size());
+    }, false});
+}
+
+void addBaseLoadBenchmark(std::vector<Benchmark>& benchmarks, BenchConfig& config) {
+    std::vector<std::pair<std::string, RepresentationType>> types = {{"dense", dense}, {"map", map}, {"sparse", sparse}};
+    for (auto& t : types) {
+        RepresentationType type = t.second;
+        benchmarks.push_back({"base_load_" + t.first, [=](BenchState& state) {
+            const int bases = 100;
+            const int size = 100000;
+            std::string file = joinPath(config.tmpDir, "bases.bin");
+
+            // Save bases with 5% of non-zero weights
+            {
+                Args args;
+                std::default_random_engine rng(config.seed);
+                std::ofstream out(file, std::ios::out | std::ios::binary);
+                for (int i = 0; i < bases; ++i) {
+                    Base base;
+                    base.setupOnlineTraining(args);
+                    for (auto& w : randomFeatures(rng, size, size / 20)) base.getW()->insertD(w.index, w.value);
+                    base.save(out);
+                }
+            }
+
+            std::vector<Base> loaded(bases);
+            while (state.run()) {
+                std::ifstream in(file, std::ios::in | std::ios::binary);
+                for (auto& b : loaded) b.load(in, false, type);
+            }
+            state.setItems(bases);
+            remove(file);
+        }, false});
+    }
+}
+
+void addKmeansBenchmark(std::vector<Benchmark>& benchmarks, BenchConfig& config) {
+    benchmarks.push_back({"kmeans", [=](BenchState& state) {
+        const int points = 2000;
+        std::default_random_engine rng(config.seed);
+        SRMatrix pointsFeatures;
+        for (int i = 0; i < points; ++i) {
+            auto features = randomFeatures(rng, 10000, 50);
+            unitNorm(features.begin(), features.end());
+            pointsFeatures.appendRow(features);
+        }
+
+        while (state.run()) {
+            std::vector<Assignation> partition(points);
+            for (int i = 0; i < points; ++i) partition[i].index = i;
+            kmeans(&partition, pointsFeatures, 16, 0.0001, true, config.seed);
+            doNotOptimize(partition.data());
+        }
+        state.setItems(points);
+    }, false});
+}
+
+void addMicroBenchmarks(std::vector<Benchmark>& benchmarks, BenchConfig& config) {
+    addVectorBenchmarks(benchmarks, config);
+    addReadLineBenchmark(benchmarks, config);
+    addTopKQueueBenchmark(benchmarks, config);
+    addLabelTreeBenchmark(benchmarks, config);
+    addBaseLoadBenchmark(benchmarks, config);
+    addKmeansBenchmark(benchmarks, config);
+}
@@ -28,13 +28,19 @@
 
 #include "args.h"
 #include "basic_types.h"
+#include "labels_map.h"
 #include "measure.h"
+#include "misc.h"
 #include "model.h"
 #include "plt.h"
+#include "prediction_stream.h"
 #include "read_data.h"
 #include "resources.h"
+#include "sharded_plt.h"
+#include "synthetic_data.h"
 #include "threads.h"
 #include "version.h"
+#include "weights_file.h"
 
 #include <thread>
 #include <future>
@@ -53,45 +59,42 @@ enum InputDataType {
 typedef std::tuple<py::array_t<Real>, py::array_t<int>, py::array_t<int>> ScipyCSRMatrixData;
 
 
+// Runs the function in a separate thread with released GIL, so the calling thread can check for signals (e.g. Ctrl-C)
+// and interrupt the operation. The function must not access Python objects. Each call has its own interrupt flag,
+// so it does not interrupt or reset other calls running at the same time.
 template<typename F> void runAsInterruptable(F func) {
-    func();
-
-    // Interruption without correct exception handling
-    /*
-    std::atomic<bool> done(false);
-    std::thread t([&] {
+    std::atomic<bool> interruptFlag(false);
+    auto result = std::async(std::launch::async, [&] {
+        setInterruptFlag(&interruptFlag);
         func();
-        done = true;
     });
 
-    try {
-        while (!done) {
-            std::this_thread::sleep_for(100ms);
-            std::cout << "running ..." << std::endl;
-            if (PyErr_CheckSignals() != 0) throw py::error_already_set();
+    bool interrupted = false;
+    {
+        py::gil_scoped_release release;
+        while (result.wait_for(50ms) != std::future_status::ready) {
+            py::gil_scoped_acquire acquire;
+            if (PyErr_CheckSignals() != 0) {
+                interruptFlag = true;
+                interrupted = true;
+                break;
+            }
         }
-    } catch (py::error_already_set& e) { throw py::error_already_set(); }
-
-    t.join();
-     */
+        result.wait();
+    }
 
-    // Async, correct exception handling, but not working interruption
-    /*
-    auto feature = std::async(std::launch::async,
-    [&]{
-        func();
-        return true;
-    });
+    if (interrupted) {
+        try { result.get(); } catch (...) {} // Ignore exception caused by the interruption
+        throw py::error_already_set();
+    }
+    result.get();
+}
 
-    try {
-        while (feature.wait_for(100ms) != std::future_status::ready) {
-            std::this_thread::sleep_for(100ms);
-            std::cout << "running ..." << std::endl;
-            if (PyErr_CheckSignals() != 0) throw py::error_already_set();
-        }
-        feature.get();
-    } catch (py::error_already_set &e){ throw; }
-     */
+// Takes the lock with released GIL, so a thread waiting for it does not block the thread that holds it,
+// which releases and acquires the GIL while it runs
+std::unique_lock<std::mutex> lockWithoutGIL(std::mutex& mtx){
+    py::gil_scoped_release release;
+    return std::unique_lock<std::mutex>(mtx);
 }
 
 template<typename T> std::vector<T> pyListToVector(py::list const &pyList){
@@ -180,10 +183,68 @@ std::tuple<ScipyCSRMatrixData, ScipyCSRMatrixData> loadLibSvmFileLabelsCSRMatrix
     return std::make_tuple(pyLabels, pyFeatures);
 }
 
+std::tuple<std::vector<std::vector<int>>, ScipyCSRMatrixData> makeSynthetic(const std::vector<std::string>& arg){
+    SRMatrix labels;
+    SRMatrix features;
+
+    Args args;
+    args.parseArgs(arg);
+    args.processData = false;
+    runAsInterruptable([&] {
+        SyntheticDataGenerator generator(args);
+        generator.generate(labels, features);
+    });
+
+    std::vector<std::vector<int>> pyLabels(labels.rows());
+    for(auto r = 0; r < labels.rows(); ++r)
+        for(auto &l : labels[r]) pyLabels[r].push_back(l.index);
+
+    return std::make_tuple(pyLabels, SRMatrixToScipyCSRMatrix(features, false));
+}
+
+void makeSyntheticFile(const std::vector<std::string>& arg, std::string path){
+    Args args;
+    args.parseArgs(arg);
+    runAsInterruptable([&] {
+        SyntheticDataGenerator generator(args);
+        generator.save(path);
+    });
+}
+
+class CPPPredictionStream {
+public:
+    CPPPredictionStream(std::shared_ptr<Model> model, std::shared_ptr<std::mutex> modelMtx, Args streamArgs): args(streamArgs), modelMtx(modelMtx) {
+        stream = std::make_shared<PredictionStream>(model, args);
+    }
+
+    // Returns predictions for the next chunk of the file, empty list if the whole file has been processed
+    std::vector<std::vector<std::pair<int, Real>>> next(){
+        std::vector<std::vector<Prediction>> predictions;
+        auto lock = lockWithoutGIL(*modelMtx); // The model may be used by other calls at the same time
+        runAsInterruptable([&] {
+            SRMatrix labels;
+            if (!stream->next(predictions, labels)) predictions.clear();
+        });
+
+        // This is only safe because it's struct with two fields casted to pair, don't do this with tuples!
+        return reinterpret_cast<std::vector<std::vector<std::pair<int, Real>>>&>(predictions);
+    }
+
+private:
+    Args args;
+    std::shared_ptr<std::mutex> modelMtx;
+    std::shared_ptr<PredictionStream> stream;
+};
 
 class CPPModel {
 public:
-    CPPModel(){};
+    CPPModel(): mtx(std::make_shared<std::mutex>()) {};
+
+    // Methods of the model release the GIL while they run, so calls from different Python threads take the lock
+    // of the model first and run one at a time, as they share args and the model, which is loaded on first use
+    std::unique_lock<std::mutex> lock(){
+        return lockWithoutGIL(*mtx);
+    }
 
     void setArgs(const std::vector<std::string>& arg){
         args.parseArgs(arg);
@@ -200,11 +261,11 @@ public:
     }
 
     void fit(py::object inputFeatures, py::object inputLabels, int featuresDataType, int labelsDataType){
+        SRMatrix labels;
+        SRMatrix features;
+        readSRMatrix(features, inputFeatures, (InputDataType) featuresDataType, true);
+        readSRMatrix(labels, inputLabels, (InputDataType) labelsDataType);
         runAsInterruptable([&] {
-            SRMatrix labels;
-            SRMatrix features;
-            readSRMatrix(features, inputFeatures, (InputDataType) featuresDataType, true);
-            readSRMatrix(labels, inputLabels, (InputDataType) labelsDataType);
             fitHelper(labels, features);
         });
     }
@@ -223,12 +284,35 @@ public:
             model = Model::factory(args);
         }
         if(!model->isLoaded()) model->load(args, args.output);
+        loadLabelsMap();
+    }
+
+    void loadLabelsMap(){
+        if(args.relabel && labelsMap.empty()) labelsMap.loadFromFile(joinPath(args.output, "labels_map.bin"));
     }
 
     void unload(){
         if(model != nullptr && model->isLoaded()) model->unload();
     }
 
+    // Converts weights of the saved model to the format set in args
+    void convert(){
+        if(args.modelType == extremeText) throw std::invalid_argument("Weights of extremeText model cannot be converted");
+        runAsInterruptable([&] {
+            unload(); // Files with weights are replaced
+            for (auto& file : findWeightsFiles(args.output))
+                convertWeights(file, file, args.weightsFormat, args.weightsPrecision);
+        });
+    }
+
+    // Splits the saved PLT model into the number of shards set in args
+    void shard(){
+        runAsInterruptable([&] {
+            args.loadFromFile(joinPath(args.output, "args.bin"));
+            ShardedPLT::createShards(args, args.output);
+        });
+    }
+
     void setThresholds(std::vector<Real> thresholds){
         load();
         model->setThresholds(thresholds);
@@ -246,24 +330,69 @@ public:
 
     std::vector<std::vector<std::pair<int, Real>>> predictProba(py::object inputFeatures, int featuresDataType, int topK, Real threshold){
         std::vector<std::vector<std::pair<int, Real>>> pred;
+        runAsInterruptable([&] { load(); }); // Loads also args required to process features
+
+        SRMatrix features;
+        readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
         runAsInterruptable([&] {
-            load();
-            SRMatrix features;
-            readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
             pred = predictHelper(features, topK, threshold);
         });
 
         return pred;
     }
 
+    // Returns top-k predictions as two arrays with shape rows x k, with labels (-1 if there is less than k predictions)
+    // and their scores. Rows of scipy csr_matrix are read directly from its buffers by prediction threads.
+    std::tuple<py::array_t<int>, py::array_t<Real>> predictTopK(py::object inputFeatures, int featuresDataType, int topK, Real threshold){
+        if (topK <= 0) throw py::value_error("top_k has to be greater than 0.");
+        runAsInterruptable([&] { load(); }); // Loads also args required to process features
+
+        int rows = (featuresDataType == csr_matrix) ? py::tuple(inputFeatures.attr("shape"))[0].cast<int>() : py::len(inputFeatures);
+        py::array_t<int> labels({rows, topK});
+        py::array_t<Real> scores({rows, topK});
+        int* labelsPtr = labels.mutable_data();
+        Real* scoresPtr = scores.mutable_data();
+
+        if (featuresDataType == csr_matrix && args.treeSearchType != beam) {
+            if (!py::hasattr(inputFeatures, "indptr") || !py::hasattr(inputFeatures, "indices") || !py::hasattr(inputFeatures, "data"))
+                throw py::value_error("Expected scipy.sparse.csr_matrix type or matrix in this format (data, indices, indptr).");
+
+            py::array indptr(inputFeatures.attr("indptr"));
+            py::array indices(inputFeatures.attr("indices"));
+            py::array data(inputFeatures.attr("data"));
+
+            if(isArrayType<std::int32_t>(indptr) && isArrayType<std::int32_t>(indices) && isArrayType<float>(data)) predictTopKCSRMatrix<std::int32_t, float>(inputFeatures, rows, topK, threshold, labelsPtr, scoresPtr);
+            else if(isArrayType<std::int32_t>(indptr) && isArrayType<std::int32_t>(indices) && isArrayType<double>(data)) predictTopKCSRMatrix<std::int32_t, double>(inputFeatures, rows, topK, threshold, labelsPtr, scoresPtr);
+            else if(isArrayType<std::int64_t>(indptr) && isArrayType<std::int64_t>(indices) && isArrayType<float>(data)) predictTopKCSRMatrix<std::int64_t, float>(inputFeatures, rows, topK, threshold, labelsPtr, scoresPtr);
+            else if(isArrayType<std::int64_t>(indptr) && isArrayType<std::int64_t>(indices) && isArrayType<double>(data)) predictTopKCSRMatrix<std::int64_t, double>(inputFeatures, rows, topK, threshold, labelsPtr, scoresPtr);
+            else throw py::value_error("Unsupported data types of the csr_matrix.");
+        } else { // Other input types and beam search require conversion to SRMatrix
+            SRMatrix features;
+            readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
+            runAsInterruptable([&] {
+                args.printArgs("predict");
+                args.topK = topK;
+                args.threshold = threshold;
+                auto pred = model->predictBatch(features, args);
+                for (int r = 0; r < rows; ++r)
+                    copyTopK(pred[r], topK, labelsPtr + static_cast<size_t>(r) * topK, scoresPtr + static_cast<size_t>(r) * topK);
+            });
+        }
+        if(!labelsMap.empty()) labelsMap.restore(labelsPtr, rows * topK);
+
+        return std::make_tuple(labels, scores);
+    }
+
     std::vector<Real> ofo(py::object inputFeatures, py::object inputLabels, int featuresDataType, int labelsDataType) {
         std::vector<Real> thresholds;
+        runAsInterruptable([&] { load(); }); // Loads also args required to process features
+
+        SRMatrix labels;
+        SRMatrix features;
+        readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
+        readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
+        if(!labelsMap.empty()) labelsMap.relabel(labels); // Thresholds are optimized for dense label ids of the model
         runAsInterruptable([&] {
-            load();
-            SRMatrix labels;
-            SRMatrix features;
-            readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
-            readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
             args.printArgs("ofo");
             thresholds = model->ofo(features, labels, args);
         });
@@ -277,29 +406,58 @@ public:
     }
 
     std::vector<std::vector<std::pair<int, Real>>> predictProbaForFile(std::string path, int topK, Real threshold) {
-        std::vector<std::vector<std::pair<int, Real>>> pred;
+        // Read and predict in chunks, so only predictions are kept for the whole file
+        std::vector<std::vector<Prediction>> pred;
         runAsInterruptable([&] {
             load();
+            args.printArgs("predict");
             args.input = path;
+            args.topK = topK;
+            args.threshold = threshold;
 
+            PredictionStream stream(model, args);
             SRMatrix labels;
-            SRMatrix features;
-            readData(labels, features, args);
-            pred = predictHelper(features, topK, threshold);
+            std::vector<std::vector<Prediction>> chunkPred;
+            while (stream.next(chunkPred, labels))
+                std::move(chunkPred.begin(), chunkPred.end(), std::back_inserter(pred));
         });
 
-        return pred;
+        // This is only safe because it's struct with two fields casted to pair, don't do this with tuples!
+        return reinterpret_cast<std::vector<std::vector<std::pair<int, Real>>>&>(pred);
+    }
+
+    std::shared_ptr<CPPPredictionStream> predictProbaForFileStream(std::string path, int topK, Real threshold, int chunkSize) {
+        runAsInterruptable([&] { load(); });
+        args.printArgs("predict");
+
+        Args streamArgs = args;
+        streamArgs.input = path;
+        streamArgs.topK = topK;
+        streamArgs.threshold = threshold;
+        streamArgs.chunkSize = chunkSize;
+        return std::make_shared<CPPPredictionStream>(model, mtx, streamArgs);
+    }
+
+    std::vector<std::pair<std::string, unsigned long long>> getCacheStats(){
+        if(model == nullptr) return {};
+        return model->getCacheStats();
+    }
+
+    std::string getStats(){
+        if(model == nullptr) return StatsSummary().toJson();
+        return model->getStats().toJson();
     }
 
     std::vector<std::pair<std::string, Real>> test(py::object inputFeatures, py::object inputLabels, int featuresDataType, int labelsDataType,
                                                      int topK, Real threshold, std::string measuresStr){
         std::vector<std::pair<std::string, Real>> results;
+        runAsInterruptable([&] { load(); }); // Loads also args required to process features
+
+        SRMatrix labels;
+        SRMatrix features;
+        readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
+        readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
         runAsInterruptable([&] {
-            load();
-            SRMatrix labels;
-            SRMatrix features;
-            readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
-            readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
             results = testHelper(labels, features, topK, threshold, measuresStr);
         });
 
@@ -323,17 +481,22 @@ public:
 
     void buildTree(py::object inputFeatures, py::object inputLabels, int featuresDataType, int labelsDataType){
         if(args.modelType == plt || args.modelType == hsm) {
+            SRMatrix labels;
+            SRMatrix features;
+            readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
+            readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
+
             runAsInterruptable([&] {
                 if(model == nullptr) model = Model::factory(args);
                 auto treeModel = std::dynamic_pointer_cast<PLT>(model);
 
-                SRMatrix labels;
-                SRMatrix features;
-                readSRMatrix(features, inputFeatures, (InputDataType)featuresDataType, true);
-                readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
-
                 makeDir(args.output);
                 args.saveToFile(joinPath(args.output, "args.bin"));
+                if(args.relabel) {
+                    labelsMap.build(labels);
+                    labelsMap.relabel(labels);
+                    labelsMap.saveToFile(joinPath(args.output, "labels_map.bin"));
+                }
                 treeModel->buildTree(labels, features, args, args.output);
             });
         }
@@ -346,6 +509,8 @@ public:
             readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
 
             preload();
+            loadLabelsMap();
+            if(!labelsMap.empty()) labelsMap.relabel(labels); // Tree leaves use dense label ids of the model
             auto treeModel = std::dynamic_pointer_cast<PLT>(model);
             nodesToUpdate = treeModel->getNodesToUpdate(labels);
         }
@@ -359,6 +524,8 @@ public:
             readSRMatrix(labels, inputLabels, (InputDataType)labelsDataType);
 
             preload();
+            loadLabelsMap();
+            if(!labelsMap.empty()) labelsMap.relabel(labels); // Tree leaves use dense label ids of the model
             auto treeModel = std::dynamic_pointer_cast<PLT>(model);
             nodesUpdates = treeModel->getNodesUpdates(labels);
         }
@@ -409,6 +576,8 @@ public:
 private:
     Args args;
     std::shared_ptr<Model> model;
+    LabelsMap labelsMap;
+    std::shared_ptr<std::mutex> mtx; // Shared with prediction streams of the model
 	
 	template<typename T> bool isArrayType(py::array& pyArray){
 		return py::isinstance<py::array_t<T>>(pyArray);
@@ -438,7 +607,7 @@ private:
                     if (v != 0) rVec.emplace_back(f, v);
                 }
 
-                if (process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold);
+                if (process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold, args.hashSign);
                 output.appendRow(rVec);
             }
         }
@@ -461,7 +630,7 @@ private:
             for (int i = indptr.at(rId); i < indptr.at(rId + 1); ++i)
                 rVec.emplace_back(indices.at(i), data.at(i));
 
-            if(process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold);
+            if(process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold, args.hashSign);
             output.appendRow(rVec);
         }
     }
@@ -493,7 +662,7 @@ private:
                     rVec.emplace_back(py::cast<int>(pyList[i]), 1);
                 else throw py::value_error("Unsupported row data type, can be list or tuple of ints or typles of int and floats.");
 
-                if(process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold);
+                if(process) processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold, args.hashSign);
 
                 output.appendRow(rVec);
             }
@@ -535,6 +704,13 @@ private:
         makeDir(args.output);
         args.saveToFile(joinPath(args.output, "args.bin"));
 
+        // Map labels to dense ids, so the model is trained on the labels space without gaps
+        if(args.relabel) {
+            labelsMap.build(labels);
+            labelsMap.relabel(labels);
+            labelsMap.saveToFile(joinPath(args.output, "labels_map.bin"));
+        }
+
         // Create and train model (train function also saves model)
         if(model == nullptr) model = Model::factory(args);
         model->train(labels, features, args, args.output);
@@ -547,6 +723,7 @@ private:
         args.topK = topK;
         args.threshold = threshold;
         auto predictions = model->predictBatch(features, args);
+        if(!labelsMap.empty()) labelsMap.restore(predictions);
 
         // This is only safe because it's struct with two fields casted to pair, don't do this with tuples!
         return reinterpret_cast<std::vector<std::vector<std::pair<int, Real>>>&>(predictions);
@@ -558,9 +735,10 @@ private:
         args.topK = topK;
         args.threshold = threshold;
         auto predictions = model->predictBatch(features, args);
+        if(!labelsMap.empty()) labelsMap.restore(predictions);
 
         args.measures = measuresStr;
-        auto measures = Measure::factory(args, model->outputSize());
+        auto measures = Measure::factory(args, labelsMap.empty() ? model->outputSize() : labelsMap.originalSize());
         for (auto& m : measures) m->accumulate(labels, predictions);
 
         std::vector<std::pair<std::string, Real>> results;
@@ -570,6 +748,62 @@ private:
         return results;
     }
 
+    template<typename T, typename U> void predictTopKCSRMatrix(py::object& input, int rows, int topK, Real threshold, int* labels, Real* scores){
+        py::array_t<T, py::array::c_style> indptr(input.attr("indptr"));
+        py::array_t<T, py::array::c_style> indices(input.attr("indices"));
+        py::array_t<U, py::array::c_style> data(input.attr("data"));
+        const T* indptrPtr = indptr.data();
+        const T* indicesPtr = indices.data();
+        const U* dataPtr = data.data();
+
+        runAsInterruptable([&] {
+            args.printArgs("predict");
+            args.topK = topK;
+            args.threshold = threshold;
+            model->initCaches(args);
+
+            Log(CERR) << "Starting prediction in " << args.threads << " threads ...\n";
+            ThreadSet tSet;
+            int tRows = ceil(static_cast<Real>(rows) / args.threads);
+            for (int t = 0; t < args.threads; ++t)
+                tSet.add(predictTopKCSRMatrixThread<T, U>, t, model.get(), std::ref(args), indptrPtr, indicesPtr, dataPtr,
+                         labels, scores, t * tRows, std::min((t + 1) * tRows, rows));
+            tSet.joinAll();
+            checkInterrupted();
+        });
+    }
+
+    // Converts rows straight from csr_matrix buffers, without creating the whole SRMatrix
+    template<typename T, typename U> static void predictTopKCSRMatrixThread(int threadId, Model* model, Args& args, const T* indptr, const T* indices,
+                                                                            const U* data, int* labels, Real* scores, int startRow, int stopRow){
+        std::vector<IRVPair> rVec;
+        std::vector<Prediction> prediction;
+        for (int r = startRow; r < stopRow && !isInterrupted(); ++r) {
+            if (!threadId) printProgress(r - startRow, stopRow - startRow);
+
+            rVec.clear();
+            prepareFeaturesVector(rVec, args.bias);
+            for (T i = indptr[r]; i < indptr[r + 1]; ++i)
+                rVec.emplace_back(indices[i], data[i]);
+            processFeaturesVector(rVec, args.norm, args.hash, args.featuresThreshold, args.hashSign);
+            SparseVector features(rVec);
+
+            prediction.clear();
+            model->predictWithCache(prediction, features, args);
+            copyTopK(prediction, args.topK, labels + static_cast<size_t>(r) * args.topK, scores + static_cast<size_t>(r) * args.topK);
+        }
+    }
+
+    static void copyTopK(const std::vector<Prediction>& prediction, int topK, int* labels, Real* scores){
+        int size = std::min<int>(topK, prediction.size());
+        for (int i = 0; i < size; ++i) {
+            labels[i] = prediction[i].label;
+            scores[i] = prediction[i].value;
+        }
+        std::fill(labels + size, labels + topK, -1);
+        std::fill(scores + size, scores + topK, 0);
+    }
+
     inline std::vector<std::vector<int>> dropProbaHelper(std::vector<std::vector<std::pair<int, Real>>>& predWithProba){
         std::vector<std::vector<int>> pred;
         pred.reserve(predWithProba.size());
@@ -583,39 +817,58 @@ private:
 };
 
 
+// Wraps a method of CPPModel, so it runs holding the lock of the model
+template<typename R, typename... A> auto locked(R (CPPModel::*method)(A...)) {
+    return [method](CPPModel& model, A... args) -> R {
+        auto lock = model.lock();
+        return (model.*method)(std::forward<A>(args)...);
+    };
+}
+
 PYBIND11_MODULE(_napkinxc, n) {
     n.doc() = "Python bindings for napkinXC C++ core";
     n.attr("__version__") = VERSION;
 
     n.def("_load_libsvm_file_labels_list", &loadLibSvmFileLabelsList);
     n.def("_load_libsvm_file_labels_csr_matrix", &loadLibSvmFileLabelsCSRMatrix);
+    n.def("_make_synthetic", &makeSynthetic);
+    n.def("_make_synthetic_file", &makeSyntheticFile);
 
     py::enum_<InputDataType>(n, "InputDataType")
     .value("list", list)
     .value("ndarray", ndarray)
     .value("csr_matrix", csr_matrix);
 
+    py::class_<CPPPredictionStream, std::shared_ptr<CPPPredictionStream>>(n, "CPPPredictionStream")
+    .def("next", &CPPPredictionStream::next);
+
     py::class_<CPPModel>(n, "CPPModel")
     .def(py::init<>())
-    .def("set_args", &CPPModel::setArgs)
-    .def("fit", &CPPModel::fit)
-    .def("fit_on_file", &CPPModel::fitOnFile)
-    .def("load", &CPPModel::load)
-    .def("unload", &CPPModel::unload)
-    .def("set_thresholds", &CPPModel::setThresholds)
-    .def("set_labels_weights", &CPPModel::setLabelsWeights)
-    .def("predict", &CPPModel::predict)
-    .def("predict_proba", &CPPModel::predictProba)
-    .def("predict_for_file", &CPPModel::predictForFile)
-    .def("predict_proba_for_file", &CPPModel::predictProbaForFile)
-    .def("ofo", &CPPModel::ofo)
-    .def("test", &CPPModel::test)
-    .def("test_on_file", &CPPModel::testOnFile)
-    .def("build_tree", &CPPModel::buildTree)
-    .def("get_nodes_to_update", &CPPModel::getNodesToUpdate)
-    .def("get_nodes_updates", &CPPModel::getNodesUpdates)
-    .def("get_tree_structure", &CPPModel::getTreeStructure)
-    .def("set_tree_structure", &CPPModel::setTreeStructure);
+    .def("set_args", locked(&CPPModel::setArgs))
+    .def("fit", locked(&CPPModel::fit))
+    .def("fit_on_file", locked(&CPPModel::fitOnFile))
+    .def("load", locked(&CPPModel::load))
+    .def("unload", locked(&CPPModel::unload))
+    .def("convert", locked(&CPPModel::convert))
+    .def("shard", locked(&CPPModel::shard))
+    .def("set_thresholds", locked(&CPPModel::setThresholds))
+    .def("set_labels_weights", locked(&CPPModel::setLabelsWeights))
+    .def("predict", locked(&CPPModel::predict))
+    .def("predict_proba", locked(&CPPModel::predictProba))
+    .def("predict_top_k", locked(&CPPModel::predictTopK))
+    .def("predict_for_file", locked(&CPPModel::predictForFile))
+    .def("predict_proba_for_file", locked(&CPPModel::predictProbaForFile))
+    .def("predict_proba_for_file_stream", locked(&CPPModel::predictProbaForFileStream))
+    .def("get_cache_stats", locked(&CPPModel::getCacheStats))
+    .def("get_stats", locked(&CPPModel::getStats))
+    .def("ofo", locked(&CPPModel::ofo))
+    .def("test", locked(&CPPModel::test))
+    .def("test_on_file", locked(&CPPModel::testOnFile))
+    .def("build_tree", locked(&CPPModel::buildTree))
+    .def("get_nodes_to_update", locked(&CPPModel::getNodesToUpdate))
+    .def("get_nodes_updates", locked(&CPPModel::getNodesUpdates))
+    .def("get_tree_structure", locked(&CPPModel::getTreeStructure))
+    .def("set_tree_structure", locked(&CPPModel::setTreeStructure));
 //    .def("get_weights", &CPPModel::getWeights)
 //    .def("set_weights", &CPPModel::setWeights);
 }
@@ -31,7 +31,8 @@ import numpy as np
 from scipy.sparse import csr_matrix
 
 try:
-    from ._napkinxc import _load_libsvm_file_labels_list, _load_libsvm_file_labels_csr_matrix
+    from ._napkinxc import _load_libsvm_file_labels_list, _load_libsvm_file_labels_csr_matrix, \
+        _make_synthetic, _make_synthetic_file
 except ImportError:
     warnings.warn("Couldn't import napkinXC cpp module, some functions may fail.")
 
@@ -648,6 +649,56 @@ def load_dataset(dataset, subset='train', format='bow', root='./data', verbose=F
         raise ValueError("File format {} is not supported".format(file_format))
 
 
+def make_synthetic(n_samples=10000, n_features=100000, n_labels=10000, labels_per_sample=5, features_per_sample=50,
+                   labels_power=1.0, features_power=1.0, cooccurrence=0.5, seed=0, file=None, threads=0, verbose=False):
+    """
+    Generates synthetic multi-label dataset shaped like extreme classification datasets:
+    power-law distributed label frequencies, clusters of co-occurring labels
+    and sparse TF-IDF-like features, each label has its own pool of informative features.
+    Generated data is deterministic for given parameters and seed,
+    rows can be generated in parallel and written to a file in the libsvm format with a header,
+    that can be read with :func:`load_libsvm_file` and by models' ``fit_on_file`` methods.
+
+    :param n_samples: Number of rows to generate, defaults to 10000
+    :type n_samples: int, optional
+    :param n_features: Number of features, defaults to 100000
+    :type n_features: int, optional
+    :param n_labels: Number of labels, defaults to 10000
+    :type n_labels: int, optional
+    :param labels_per_sample: Average number of labels per row, defaults to 5
+    :type labels_per_sample: float, optional
+    :param features_per_sample: Average number of features per row, defaults to 50
+    :type features_per_sample: float, optional
+    :param labels_power: Exponent of power-law distribution of labels frequencies, defaults to 1.0
+    :type labels_power: float, optional
+    :param features_power: Exponent of power-law distribution of features frequencies, defaults to 1.0
+    :type features_power: float, optional
+    :param cooccurrence: Probability of sampling next label of a row from the cluster of its first label, defaults to 0.5
+    :type cooccurrence: float, optional
+    :param seed: Seed, defaults to 0
+    :type seed: int, optional
+    :param file: If given, data is written to this file instead of being returned, defaults to None
+    :type file: str, optional
+    :param threads: Number of threads used to generate the file, 0 to use all available CPUs, defaults to 0
+    :type threads: int, optional
+    :param verbose: If True print progress, defaults to False
+    :type verbose: bool, optional
+    :return: Features matrix and labels if file is not given
+    :rtype: (csr_matrix, list[list[int]]) or None
+    """
+    args = ["--rows", str(n_samples), "--features", str(n_features), "--labels", str(n_labels),
+            "--labelsPerRow", str(labels_per_sample), "--featuresPerRow", str(features_per_sample),
+            "--labelsPower", str(labels_power), "--featuresPower", str(features_power),
+            "--cooccurrence", str(cooccurrence), "--seed", str(seed), "--threads", str(threads),
+            "--verbose", str(2 if verbose else 0)]
+    if file is not None:
+        _make_synthetic_file(args, file)
+        return None
+
+    labels, features = _make_synthetic(args)
+    return csr_matrix(features, shape=(n_samples, n_features)), labels
+
+
 def to_csr_matrix(X, shape=None, sort_indices=False, dtype=np.float32):
     """
     Converts sparse matrix-like data, like list of list of tuples (idx, value), to Scipy csr_matrix.
@@ -18,6 +18,7 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+import json
 import re
 from numpy import ndarray
 from scipy.sparse import csr_matrix
@@ -66,6 +67,19 @@ class Model():
         """
         self._model.unload()
 
+    def convert(self, weights_format="compact", weights_precision="fp32"):
+        """
+        Convert weights of the saved model to a different format, the model is unloaded from RAM.
+        Compact format does not store gradients saved with ``save_grads`` parameter.
+
+        :param weights_format: Format of weights files: ``legacy`` or ``compact`` (delta and varint coded indices), defaults to "compact"
+        :type weights_format: str, optional
+        :param weights_precision: Precision of weights in compact format: ``fp32``, ``fp16`` or ``bf16``, defaults to "fp32"
+        :type weights_precision: str, optional
+        """
+        self.set_params(weights_format=weights_format, weights_precision=weights_precision)
+        self._model.convert()
+
     def predict(self, X, top_k=0, threshold=0, labels_weights=None):
         """
         Predict labels for data points in X.
@@ -108,6 +122,30 @@ class Model():
         threshold = self._prepare_pred(top_k, threshold, labels_weights)
         return self._model.predict_proba(X, Model._check_data_type(X), top_k, threshold)
 
+    def predict_top_k(self, X, top_k=5, threshold=0, labels_weights=None):
+        """
+        Predict top-k labels with probability estimates for data points in X and return them as two NumPy arrays.
+        Prediction is done without holding the GIL and rows of csr_matrix are read directly from its buffers,
+        which makes it faster than :meth:`predict_proba` for large inputs.
+
+        :param X: Data points as a matrix or list of lists of int or tuples of int and float (feature id, value).
+        :type X: csr_matrix, ndarray, list[list[int]|tuple[int]], list[list[tuple[int, float]]
+        :param top_k: Predict top-k labels, has to be greater than 0, defaults to 5
+        :type top_k: int
+        :param threshold: Predict labels with probability above the threshold in case of single value
+            or above the specific threshold for each label in case of list or array of values,
+            if 0, the option is ignored, defaults to 0
+        :type threshold: float, list[float], ndarray, optional
+        :param labels_weights: Predict labels according to their weights multiplied by probability
+            if None, the option is ignored, defaults to None
+        :type labels_weights: list[float], ndarray, optional
+        :return: Tuple of arrays with shape (number of data points, top_k) with predicted labels and their probabilities,
+            if less than top_k labels are predicted for a data point, remaining labels are set to -1 and probabilities to 0
+        :rtype: tuple[ndarray, ndarray]
+        """
+        threshold = self._prepare_pred(top_k, threshold, labels_weights)
+        return self._model.predict_top_k(X, Model._check_data_type(X), top_k, threshold)
+
     def predict_for_file(self, path, top_k=0, threshold=0, labels_weights=None):
         """
         Predict labels for data points in the given file in multi-label svmlight/libsvm format.
@@ -150,6 +188,79 @@ class Model():
         threshold = self._prepare_pred(top_k, threshold, labels_weights)
         return self._model.predict_proba_for_file(path, top_k, threshold)
 
+    def predict_for_file_iter(self, path, top_k=0, threshold=0, labels_weights=None, chunk_size=10000):
+        """
+        Predict labels for data points in the given file in multi-label svmlight/libsvm format.
+        The file is read and predicted in chunks, so memory usage does not depend on the size of the file.
+
+        :param path: Path to the file
+        :type path: str
+        :param top_k: Predict top-k labels, if 0, the option is ignored, defaults to 0
+        :type top_k: int
+        :param threshold: Predict labels with probability above the threshold in case of single value
+            or above the specific threshold for each label in case of list or array of values,
+            if 0, the option is ignored, defaults to 0
+        :type threshold: float, list[float], ndarray, optional
+        :param labels_weights: Predict labels according to their weights multiplied by probability
+            if None, the option is ignored, defaults to None
+        :type labels_weights: list[float], ndarray, optional
+        :param chunk_size: Number of data points read and predicted at once, defaults to 10000
+        :type chunk_size: int
+        :return: Generator of lists with predicted labels, one list per data point.
+        :rtype: Iterator[list[int]]
+        """
+        for p in self.predict_proba_for_file_iter(path, top_k, threshold, labels_weights, chunk_size):
+            yield [l for l, _ in p]
+
+    def predict_proba_for_file_iter(self, path, top_k=0, threshold=0, labels_weights=None, chunk_size=10000):
+        """
+        Predict labels with probability estimates for data points in the given file in multi-label svmlight/libsvm format.
+        The file is read and predicted in chunks, so memory usage does not depend on the size of the file.
+
+        :param path: Path to the file.
+        :type path: str
+        :param top_k: Predict top-k labels, if 0, the option is ignored, defaults to 0
+        :type top_k: int
+        :param threshold: Predict labels with probability above the threshold in case of single value
+            or above the specific threshold for each label in case of list or array of values,
+            if 0, the option is ignored, defaults to 0
+        :type threshold: float, list[float], ndarray, optional
+        :param labels_weights: Predict labels according to their weights multiplied by probability
+            if None, the option is ignored, defaults to None
+        :type labels_weights: list[float], ndarray, optional
+        :param chunk_size: Number of data points read and predicted at once, defaults to 10000
+        :type chunk_size: int
+        :return: Generator of lists of tuples (label id, probability), one list per data point.
+        :rtype: Iterator[list[tuple[int, float]]]
+        """
+        threshold = self._prepare_pred(top_k, threshold, labels_weights)
+        stream = self._model.predict_proba_for_file_stream(path, top_k, threshold, chunk_size)
+        while True:
+            chunk = stream.next()
+            if not chunk:
+                break
+            yield from chunk
+
+    def get_cache_stats(self):
+        """
+        Get hit and miss counters of the prediction caches enabled with ``prediction_cache`` and ``node_cache`` parameters.
+
+        :return: Mapping of counter name to its value, empty if caches are disabled or no prediction was made yet
+        :rtype: dict
+        """
+        return dict(self._model.get_cache_stats())
+
+    def get_stats(self):
+        """
+        Get inference statistics collected since the model was loaded: number of predicted data points,
+        evaluated node classifiers in total and per tree depth (and per node if enabled with ``node_stats`` parameter),
+        and histogram of prediction latencies in nanoseconds with its percentiles.
+
+        :return: Statistics as a nested dictionary, same as saved by ``nxc test --statsOutput``
+        :rtype: dict
+        """
+        return json.loads(self._model.get_stats())
+
     def ofo(self, X, Y, type='micro', a=10, b=20, epochs=1):
         """
         Perform Online F-measure Optimization procedure on the given data to find optimal thresholds.
@@ -406,10 +517,14 @@ class PLT(LabelTreeModel):
 
                  # Features params
                  hash=None,
+                 hash_sign=False,
                  features_threshold=0,
                  norm=True,
                  bias=1.0,
 
+                 # Labels params
+                 relabel=False,
+
                  # Base (node) classifiers params
                  optimizer='liblinear',
                  loss='log',
@@ -426,6 +541,10 @@ class PLT(LabelTreeModel):
                  tree_search_type='exact',
                  beam_search_width=10,
                  load_as='map',
+                 prediction_cache=0,
+                 node_cache=0,
+                 node_cache_depth=2,
+                 node_stats=False,
 
                  # Other
                  ensemble=1,
@@ -461,14 +580,26 @@ class PLT(LabelTreeModel):
         :type tree_search_type: str, optional
         :param beam_search_width: Width of the tree beam search, makes effect only if ``tree_search_type='beam'``, defaults to 10
         :type beam_search_width: int, optional
+        :param prediction_cache: Size of LRU cache of predictions for repeated data points, if 0 disable the cache, defaults to 0
+        :type prediction_cache: int, optional
+        :param node_cache: Size of LRU cache of values of nodes of top levels of the tree, reused for any top k and thresholds, if 0 disable the cache, defaults to 0
+        :type node_cache: int, optional
+        :param node_cache_depth: Number of top levels of the tree cached by node cache, defaults to 2
+        :type node_cache_depth: int, optional
+        :param node_stats: Count evaluations of each tree node in statistics returned by ``get_stats``, defaults to False
+        :type node_stats: bool, optional
         :param hash: Hash features to a space of given size, value of this argument is saved with model weights, if None or 0 disable hashing, defaults to None
         :type hash: int, optional
+        :param hash_sign: Multiply hashed features by a sign given by a second hash to reduce bias caused by collisions, value of this argument is saved with model weights, defaults to False
+        :type hash_sign: bool, optional
         :param features_threshold: Prune features below given threshold, value of this argument is saved with model weights, defaults to 0
         :type features_threshold: float, optional
         :param norm: Unit norm feature vector, value of this argument is saved with model weights, defaults to True
         :type norm: bool, optional
         :param bias: Value of the bias features, value of this argument is saved with model weights, defaults to 1.0
         :type bias: float, optional
+        :param relabel: Map labels to dense ids before training and back to original ids in predictions, useful for labels with sparse ids, value of this argument is saved with model weights, defaults to False
+        :type relabel: bool, optional
         :param optimizer: Optimizer used for training node classifiers {``'liblinear'``, ``'sgd'``, ``'adagrad'``}, defaults to ``'liblinear'``
         :type optimizer: str, optional
         :param loss: Loss optimized while training node classifiers {``'log'`` (alias ``'logistic'``), ``'l2'`` (alias ``'squaredHinge'``)}, defaults to ``'log'``
@@ -513,6 +644,19 @@ class PLT(LabelTreeModel):
         all_params.update({"model": "plt"})
         super(PLT, self).__init__(**all_params)
 
+    def shard(self, shards, shard_level=1):
+        """
+        Split the saved model into shards. To predict with the sharded model, construct it with ``shards`` parameter,
+        sharded model supports only exact tree search.
+
+        :param shards: Number of shards to split the model into
+        :type shards: int
+        :param shard_level: Tree level at which subtrees are assigned to shards, nodes above it are evaluated by the coordinator, defaults to 1
+        :type shard_level: int, optional
+        """
+        self.set_params(shards=shards, shard_level=shard_level)
+        self._model.shard()
+
 
 class HSM(LabelTreeModel):
     """
@@ -533,9 +677,13 @@ class HSM(LabelTreeModel):
 
                  # Features params
                  hash=None,
+                 hash_sign=False,
                  features_threshold=0,
                  norm=True,
                  bias=1.0,
+
+                 # Labels params
+                 relabel=False,
                  pick_one_label_weighting=False,
 
                  # Base (node) classifiers params
@@ -585,12 +733,16 @@ class HSM(LabelTreeModel):
         :type kmeans_balanced: bool, optional
         :param hash: Hash features to a space of given size, value of this argument is saved with model weights, if None or 0 disable hashing, defaults to None
         :type hash: int, optional
+        :param hash_sign: Multiply hashed features by a sign given by a second hash to reduce bias caused by collisions, value of this argument is saved with model weights, defaults to False
+        :type hash_sign: bool, optional
         :param features_threshold: Prune features below given threshold, value of this argument is saved with model weights, defaults to 0
         :type features_threshold: float, optional
         :param norm: Unit norm feature vector, value of this argument is saved with model weights, defaults to True
         :type norm: bool, optional
         :param bias: Value of the bias features, value of this argument is saved with model weights, defaults to 1.0
         :type bias: float, optional
+        :param relabel: Map labels to dense ids before training and back to original ids in predictions, useful for labels with sparse ids, value of this argument is saved with model weights, defaults to False
+        :type relabel: bool, optional
         :param optimizer: Optimizer used for training node classifiers {``'liblinear'``, ``'sgd'``, ``'adagrad'``}, defaults to ``'liblinear'``
         :type optimizer: str, optional
         :param loss: Loss optimized while training node classifiers {``'log'`` (alias ``'logistic'``), ``'l2'`` (alias ``'squaredHinge'``)}, defaults to ``'log'``
@@ -646,10 +798,14 @@ class BR(Model):
 
                  # Features params
                  hash=None,
+                 hash_sign=False,
                  features_threshold=0,
                  norm=True,
                  bias=1.0,
 
+                 # Labels params
+                 relabel=False,
+
                  # Base classifiers params
                  optimizer='liblinear',
                  loss='log',
@@ -677,12 +833,16 @@ class BR(Model):
         :type output: str
         :param hash: Hash features to a space of given size, value of this argument is saved with model weights, if None or 0 disable hashing, defaults to None
         :type hash: int, optional
+        :param hash_sign: Multiply hashed features by a sign given by a second hash to reduce bias caused by collisions, value of this argument is saved with model weights, defaults to False
+        :type hash_sign: bool, optional
         :param features_threshold: Prune features below given threshold, value of this argument is saved with model weights, defaults to 0
         :type features_threshold: float, optional
         :param norm: Unit norm feature vector, value of this argument is saved with model weights, defaults to True
         :type norm: bool, optional
         :param bias: Value of the bias features, value of this argument is saved with model weights, defaults to 1.0
         :type bias: float, optional
+        :param relabel: Map labels to dense ids before training and back to original ids in predictions, useful for labels with sparse ids, value of this argument is saved with model weights, defaults to False
+        :type relabel: bool, optional
         :param optimizer: Optimizer used for training node classifiers {``'liblinear'``, ``'sgd'``, ``'adagrad'``}, defaults to ``'liblinear'``
         :type optimizer: str, optional
         :param loss: Loss optimized while training node classifiers {``'log'`` (alias ``'logistic'``), ``'l2'`` (alias ``'squaredHinge'``)}, defaults to ``'log'``
@@ -736,9 +896,13 @@ class OVR(BR):
 
                  # Features params
                  hash=None,
+                 hash_sign=False,
                  features_threshold=0,
                  norm=True,
                  bias=1.0,
+
+                 # Labels params
+                 relabel=False,
                  pick_one_label_weighting=False,
 
                  # Base classifiers params
@@ -768,12 +932,16 @@ class OVR(BR):
         :type output: str
         :param hash: Hash features to a space of given size, value of this argument is saved with model weights, if None or 0 disable hashing, defaults to None
         :type hash: int, optional
+        :param hash_sign: Multiply hashed features by a sign given by a second hash to reduce bias caused by collisions, value of this argument is saved with model weights, defaults to False
+        :type hash_sign: bool, optional
         :param features_threshold: Prune features below given threshold, value of this argument is saved with model weights, defaults to 0
         :type features_threshold: float, optional
         :param norm: Unit norm feature vector, value of this argument is saved with model weights, defaults to True
         :type norm: bool, optional
         :param bias: Value of the bias features, value of this argument is saved with model weights, defaults to 1.0
         :type bias: float, optional
+        :param relabel: Map labels to dense ids before training and back to original ids in predictions, useful for labels with sparse ids, value of this argument is saved with model weights, defaults to False
+        :type relabel: bool, optional
         :param pick_one_label_weighting: Allows to use multi-label data by transforming it into multi-class, defaults to False
         :type pick_one_label_weighting: bool, optional
         :param optimizer: Optimizer used for training node classifiers {``'liblinear'``, ``'sgd'``, ``'adagrad'``}, defaults to ``'liblinear'``
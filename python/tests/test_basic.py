@@ -1,5 +1,6 @@
+import os
 import shutil
-from napkinxc.datasets import load_dataset
+from napkinxc.datasets import load_dataset, load_libsvm_file, make_synthetic
 from napkinxc.models import *
 from napkinxc.measures import precision_at_k
 
@@ -26,6 +27,39 @@ def test_plt_train_test():
     _test_model(PLT, {})
 
 
+def test_plt_signed_hashing_train_test():
+    _test_model(PLT, {"hash": 64, "hash_sign": True})
+
+
+def test_plt_neg_sampling_train_test():
+    _test_model(PLT, {"neg_sampling_ratio": 1})
+
+
+def test_hsm_neg_sampling_train_test():
+    _test_model(HSM, {"pick_one_label_weighting": True, "neg_sampling_ratio": 4})
+
+
+def test_plt_relabel_train_test():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    # Sparse label ids, far above the number of labels
+    Y_train = [[l * 1000 + 7 for l in y] for y in Y_train]
+    Y_test = [[l * 1000 + 7 for l in y] for y in Y_test]
+    train_labels = set(l for y in Y_train for l in y)
+
+    model = PLT(MODEL_PATH, seed=TEST_SEED, relabel=True)
+    model.fit(X_train, Y_train)
+
+    Y_pred = model.predict(X_test, top_k=3)
+    assert all(l in train_labels for y in Y_pred for l in y)
+
+    p_at_1 = precision_at_k(Y_test, [y[:1] for y in Y_pred], k=1)
+    assert SCORE_RANGE[0] < p_at_1 < SCORE_RANGE[1]
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
 def test_hsm_train_test():
     _test_model(HSM, {"pick_one_label_weighting": True})
 
@@ -36,3 +70,123 @@ def test_br_train_test():
 
 def test_ovr_train_test():
     _test_model(OVR, {"pick_one_label_weighting": True})
+
+
+def test_plt_prediction_cache():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    model = PLT(MODEL_PATH, seed=TEST_SEED, prediction_cache=10000, node_cache=10000)
+    model.fit(X_train, Y_train)
+
+    Y_pred = model.predict_proba(X_test, top_k=3)
+    assert Y_pred == model.predict_proba(X_test, top_k=3)
+
+    stats = model.get_cache_stats()
+    assert stats["prediction_cache_hits"] > 0
+    assert stats["node_cache_misses"] > 0
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_plt_node_cache():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    model = PLT(MODEL_PATH, seed=TEST_SEED)
+    model.fit(X_train, Y_train)
+    Y_pred_top_3 = model.predict_proba(X_test, top_k=3)
+    Y_pred_top_5 = model.predict_proba(X_test, top_k=5)
+
+    # Values of top nodes are reused by queries with different top k
+    model = PLT(MODEL_PATH, node_cache=10000)
+    assert Y_pred_top_3 == model.predict_proba(X_test, top_k=3)
+    assert Y_pred_top_5 == model.predict_proba(X_test, top_k=5)
+
+    stats = model.get_cache_stats()
+    assert stats["node_cache_misses"] > 0
+    assert stats["node_cache_hits"] >= stats["node_cache_misses"]
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_plt_predict_top_k():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    model = PLT(MODEL_PATH, seed=TEST_SEED)
+    model.fit(X_train, Y_train)
+
+    Y_pred = model.predict_proba(X_test, top_k=3)
+    labels, scores = model.predict_top_k(X_test, top_k=3)
+    assert labels.shape == (X_test.shape[0], 3)
+    assert [[(l, s) for l, s in zip(r_l, r_s) if l >= 0] for r_l, r_s in zip(labels.tolist(), scores.tolist())] == Y_pred
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_plt_concurrent_predict():
+    from concurrent.futures import ThreadPoolExecutor
+
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    model = PLT(MODEL_PATH, seed=TEST_SEED)
+    model.fit(X_train, Y_train)
+    Y_pred = {k: model.predict_proba(X_test, top_k=k) for k in range(1, 5)}
+
+    # Calls with different top k from many threads on a model that is not loaded yet
+    model = PLT(MODEL_PATH)
+    with ThreadPoolExecutor(max_workers=4) as executor:
+        results = list(executor.map(lambda k: (k, model.predict_proba(X_test, top_k=k)), [1, 2, 3, 4] * 4))
+    for k, y in results:
+        assert y == Y_pred[k]
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_plt_predict_for_file_iter():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    test_path = os.path.join(TEST_DATA_PATH, TEST_DATASET, "{}_test.txt".format(TEST_DATASET))
+
+    model = PLT(MODEL_PATH, seed=TEST_SEED)
+    model.fit(X_train, Y_train)
+
+    Y_pred = model.predict_proba_for_file(test_path, top_k=3)
+    assert list(model.predict_proba_for_file_iter(test_path, top_k=3, chunk_size=100)) == Y_pred
+    assert list(model.predict_for_file_iter(test_path, top_k=3, chunk_size=100)) == [[l for l, _ in p] for p in Y_pred]
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_plt_get_stats():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    model = PLT(MODEL_PATH, seed=TEST_SEED, node_stats=True)
+    model.fit(X_train, Y_train)
+    model.predict(X_test, top_k=1)
+
+    stats = model.get_stats()
+    assert stats["data_points"] == X_test.shape[0]
+    assert stats["latency_ns"]["count"] == X_test.shape[0]
+    assert sum(stats["depth_evaluations"]) == stats["node_evaluations"]
+    assert sum(stats["nodes_evaluations"]) == stats["node_evaluations"]
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_make_synthetic():
+    X, Y = make_synthetic(n_samples=1000, n_features=5000, n_labels=500, seed=TEST_SEED)
+    assert X.shape == (1000, 5000)
+    assert len(Y) == 1000 and all(0 < len(y) and max(y) < 500 for y in Y)
+
+    X2, Y2 = make_synthetic(n_samples=1000, n_features=5000, n_labels=500, seed=TEST_SEED)
+    assert Y == Y2 and (X != X2).nnz == 0
+
+    file_path = os.path.join(TEST_DATA_PATH, "synthetic.txt")
+    make_synthetic(n_samples=1000, n_features=5000, n_labels=500, seed=TEST_SEED, file=file_path, threads=2)
+    X_file, Y_file = load_libsvm_file(file_path)
+    assert Y_file == Y and X_file.nnz == X.nnz
+
+    os.remove(file_path)
@@ -1,6 +1,11 @@
+import _thread
 import shutil
 import os
-from napkinxc.datasets import load_dataset
+import threading
+import time
+import numpy as np
+import pytest
+from napkinxc.datasets import load_dataset, make_synthetic
 from napkinxc.models import BR, PLT
 from napkinxc.measures import precision_at_k
 
@@ -66,3 +71,124 @@ def test_seed_reproducibility():
 
         shutil.rmtree(MODEL_PATH + "-1", ignore_errors=True)
         shutil.rmtree(MODEL_PATH + "-2", ignore_errors=True)
+
+
+def _assert_same_top_k(Y_pred_1, Y_pred_2):
+    assert len(Y_pred_1) == len(Y_pred_2)
+    for p_1, p_2 in zip(Y_pred_1, Y_pred_2):
+        assert [l for l, _ in p_1] == [l for l, _ in p_2]
+        assert np.allclose([s for _, s in p_1], [s for _, s in p_2])
+
+
+def test_plt_compact_weights_reproducibility():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    plt = PLT(MODEL_PATH, seed=TEST_SEED)
+    plt.fit(X_train, Y_train)
+    plt.convert(weights_format="legacy")
+    Y_pred_legacy = PLT(MODEL_PATH).predict_proba(X_test, top_k=5)
+
+    plt.convert(weights_format="compact", weights_precision="fp32")
+    Y_pred_compact = PLT(MODEL_PATH).predict_proba(X_test, top_k=5)
+    _assert_same_top_k(Y_pred_legacy, Y_pred_compact)
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_threads_loading_reproducibility():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    for model_class in [BR, PLT]:
+        model = model_class(MODEL_PATH, seed=TEST_SEED)
+        model.fit(X_train, Y_train)
+
+        Y_pred_1 = model_class(MODEL_PATH, threads=1).predict_proba(X_test, top_k=5)
+        Y_pred_4 = model_class(MODEL_PATH, threads=4).predict_proba(X_test, top_k=5)
+        _assert_same_top_k(Y_pred_1, Y_pred_4)
+
+        shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_lazy_loading_reproducibility():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    for model_class in [BR, PLT]:
+        model = model_class(MODEL_PATH, seed=TEST_SEED)
+        model.fit(X_train, Y_train)
+
+        Y_pred_eager = model_class(MODEL_PATH).predict_proba(X_test, top_k=5)
+        # Cache small enough to hold a single base, so bases are evicted and reloaded
+        lazy = model_class(MODEL_PATH, lazy_loading=True, bases_cache_mem=0.000001)
+        _assert_same_top_k(Y_pred_eager, lazy.predict_proba(X_test, top_k=5))
+
+        shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_sibling_blocks_reproducibility():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    plt = PLT(MODEL_PATH, seed=TEST_SEED)
+    plt.fit(X_train, Y_train)
+
+    Y_pred_unpacked = PLT(MODEL_PATH).predict_proba(X_test, top_k=5)
+    Y_pred_packed = PLT(MODEL_PATH, sibling_blocks=True).predict_proba(X_test, top_k=5)
+    _assert_same_top_k(Y_pred_unpacked, Y_pred_packed)
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def test_sharded_plt_reproducibility():
+    X_train, Y_train = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    X_test, Y_test = load_dataset(TEST_DATASET, "test", root=TEST_DATA_PATH)
+
+    plt = PLT(MODEL_PATH, seed=TEST_SEED)
+    plt.fit(X_train, Y_train)
+    Y_pred = plt.predict_proba(X_test, top_k=5)
+
+    for shards, shard_level in [(2, 1), (3, 2)]:
+        plt.shard(shards, shard_level=shard_level)
+        sharded_plt = PLT(MODEL_PATH, shards=shards, shard_level=shard_level)
+        _assert_same_top_k(Y_pred, sharded_plt.predict_proba(X_test, top_k=5))
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+
+def _interrupt_after_checkpoint(manifest_path, segments):
+    # Interrupts the main thread like Ctrl+C, once given number of segments is saved in the checkpoint
+    while True:
+        if os.path.exists(manifest_path):
+            with open(manifest_path) as f:
+                if len(f.readlines()) > segments:  # The first line is a fingerprint
+                    _thread.interrupt_main()
+                    return
+        time.sleep(0.01)
+
+
+def test_plt_resumed_checkpoint_reproducibility():
+    X, Y = make_synthetic(n_samples=2000, n_features=5000, n_labels=1000, seed=TEST_SEED)
+    params = {"seed": TEST_SEED, "threads": 2}
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+
+    plt = PLT(MODEL_PATH + "-full", **params)
+    plt.fit(X, Y)
+    Y_pred = plt.predict_proba(X, top_k=5)
+
+    checkpoint_path = os.path.join(MODEL_PATH, "weights.bin.checkpoint")
+    poller = threading.Thread(target=_interrupt_after_checkpoint, args=(os.path.join(checkpoint_path, "manifest.txt"), 2), daemon=True)
+    poller.start()
+    with pytest.raises(KeyboardInterrupt):
+        PLT(MODEL_PATH, checkpoint=10, **params).fit(X, Y)
+    poller.join()
+    assert os.path.exists(checkpoint_path)
+
+    resumed_plt = PLT(MODEL_PATH, checkpoint=10, resume=True, **params)
+    resumed_plt.fit(X, Y)
+    assert not os.path.exists(checkpoint_path)
+    _assert_same_top_k(Y_pred, resumed_plt.predict_proba(X, top_k=5))
+
+    shutil.rmtree(MODEL_PATH, ignore_errors=True)
+    shutil.rmtree(MODEL_PATH + "-full", ignore_errors=True)
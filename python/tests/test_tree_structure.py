@@ -42,3 +42,20 @@ def test_build_tree_structure_reproducibility():
 
     shutil.rmtree(MODEL_PATH + "-1", ignore_errors=True)
     shutil.rmtree(MODEL_PATH + "-2", ignore_errors=True)
+
+
+def test_nodes_to_update_with_relabel():
+    X, Y = load_dataset(TEST_DATASET, "train", root=TEST_DATA_PATH)
+    Y_sparse = [[l * 1000 + 7 for l in y] for y in Y]
+
+    # Relabeling keeps the order of labels, so both trees are the same
+    plt = PLT(MODEL_PATH + "-1", seed=1993)
+    plt.build_tree(X, Y)
+    plt2 = PLT(MODEL_PATH + "-2", seed=1993, relabel=True)
+    plt2.build_tree(X, Y_sparse)
+
+    assert plt.get_nodes_to_update(Y) == plt2.get_nodes_to_update(Y_sparse)
+    assert plt.get_nodes_updates(Y) == plt2.get_nodes_updates(Y_sparse)
+
+    shutil.rmtree(MODEL_PATH + "-1", ignore_errors=True)
+    shutil.rmtree(MODEL_PATH + "-2", ignore_errors=True)
@@ -43,6 +43,7 @@ Args::Args() {
     memLimit = getSystemMemory();
     saveGrads = false;
     resume = false;
+    checkpoint = 0;
     loadAs = map;
 
     // Input/output options
@@ -52,10 +53,12 @@ Args::Args() {
     modelName = "plt";
     modelType = plt;
     hash = 0;
+    hashSign = false;
     processData = true;
     bias = 1.0;
     norm = true;
     featuresThreshold = 0.0;
+    relabel = false;
 
     // Training options
     eps = 0.1;
@@ -70,6 +73,10 @@ Args::Args() {
     solverName = "L2R_LR_DUAL";
     inbalanceLabelsWeighting = false;
     pickOneLabelWeighting = false;
+    negSamplingRatio = 0;
+    negSamplingMax = 0;
+    shards = 0;
+    shardLevel = 1;
     optimizerName = "liblinear";
     optimizerType = liblinear;
     weightsThreshold = 0.1;
@@ -119,6 +126,20 @@ Args::Args() {
     treeSearchType = exact;
     beamSearchWidth = 10;
     beamSearchUnpack = true;
+    predictionCache = 0;
+    nodeCache = 0;
+    nodeCacheDepth = 2;
+    lazyLoading = false;
+    basesCacheMem = 1024ULL * 1024 * 1024;
+    pinLevels = 2;
+    siblingBlocks = false;
+    siblingBlocksMinFill = 0.25;
+    chunkSize = 10000;
+    predictionFormat = textFormat;
+    predictionFormatName = "text";
+    statsOutput = "";
+    perfCounters = false;
+    nodeStats = false;
 
     // Measures for test command
     measures = "p@1,p@3,p@5";
@@ -129,6 +150,7 @@ Args::Args() {
     ofoTopLabels = 1000;
     ofoA = 10;
     ofoB = 20;
+    ofoBatchSize = 1000;
 
     psA = 0.55;
     psB = 1.5;
@@ -136,6 +158,25 @@ Args::Args() {
     // Args for testPredictionTime command
     batchSizes = "100,1000,10000";
     batches = 10;
+    clients = 0;
+    warmup = 10;
+    requestRate = 0;
+
+    // Args for generate command
+    genRows = 10000;
+    genFeatures = 100000;
+    genLabels = 10000;
+    genLabelsPerRow = 5;
+    genFeaturesPerRow = 50;
+    genLabelsPower = 1.0;
+    genFeaturesPower = 1.0;
+    genCooccurrence = 0.5;
+
+    // Args for convert command
+    weightsFormat = compactWeights;
+    weightsFormatName = "compact";
+    weightsPrecision = fp32;
+    weightsPrecisionName = "fp32";
 }
 
 // Parse args
@@ -170,6 +211,8 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                 saveGrads = std::stoi(args.at(ai + 1)) != 0;
             else if (args[ai] == "--resume")
                 resume = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--checkpoint")
+                checkpoint = std::stoi(args.at(ai + 1));
             else if (args[ai] == "--loadAs") {
                 representationName = args.at(ai + 1);
                 if (args.at(ai + 1) == "dense")
@@ -185,7 +228,7 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                 input = std::string(args.at(ai + 1));
             else if (args[ai] == "-o" || args[ai] == "--output")
                 output = std::string(args.at(ai + 1));
-            else if (args[ai] == "--prediction")
+            else if (args[ai] == "-p" || args[ai] == "--prediction")
                 prediction = std::string(args.at(ai + 1));
             else if (args[ai] == "--ensemble")
                 ensemble = std::stoi(args.at(ai + 1));
@@ -215,8 +258,12 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                 norm = std::stoi(args.at(ai + 1)) != 0;
             else if (args[ai] == "--hash")
                 hash = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--hashSign")
+                hashSign = std::stoi(args.at(ai + 1)) != 0;
             else if (args[ai] == "--featuresThreshold")
                 featuresThreshold = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--relabel")
+                relabel = std::stoi(args.at(ai + 1)) != 0;
             else if (args[ai] == "--weightsThreshold")
                 weightsThreshold = std::stof(args.at(ai + 1));
 
@@ -231,6 +278,14 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                 inbalanceLabelsWeighting = std::stoi(args.at(ai + 1)) != 0;
             else if (args[ai] == "--pickOneLabelWeighting")
                 pickOneLabelWeighting = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--negSamplingRatio")
+                negSamplingRatio = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--negSamplingMax")
+                negSamplingMax = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--shards")
+                shards = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--shardLevel")
+                shardLevel = std::stoi(args.at(ai + 1));
             else if (args[ai] == "--loss") {
                 lossName = args.at(ai + 1);
                 if (args.at(ai + 1) == "logistic" || args.at(ai + 1) == "log")
@@ -351,6 +406,8 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                 ofoA = std::stoi(args.at(ai + 1));
             else if (args[ai] == "--ofoB")
                 ofoB = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--ofoBatchSize")
+                ofoBatchSize = std::stoi(args.at(ai + 1));
 
             // Prediction/test options
             else if (args[ai] == "--topK")
@@ -375,10 +432,89 @@ void Args::parseArgs(const std::vector<std::string>& args, bool keepArgs) {
                 beamSearchWidth = std::stoi(args.at(ai + 1));
             else if (args[ai] == "--beamSearchUnpack")
                 beamSearchUnpack = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--predictionCache")
+                predictionCache = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--nodeCache")
+                nodeCache = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--nodeCacheDepth")
+                nodeCacheDepth = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--lazyLoading")
+                lazyLoading = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--basesCacheMem")
+                basesCacheMem = static_cast<unsigned long long>(std::stof(args.at(ai + 1)) * 1024 * 1024 * 1024);
+            else if (args[ai] == "--pinLevels")
+                pinLevels = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--siblingBlocks")
+                siblingBlocks = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--siblingBlocksMinFill")
+                siblingBlocksMinFill = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--chunkSize")
+                chunkSize = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--predictionFormat") {
+                predictionFormatName = args.at(ai + 1);
+                if (args.at(ai + 1) == "text")
+                    predictionFormat = textFormat;
+                else if (args.at(ai + 1) == "binary")
+                    predictionFormat = binaryFormat;
+                else
+                    throw std::invalid_argument("Unknown prediction format: " + args.at(ai + 1));
+            }
+            else if (args[ai] == "--statsOutput")
+                statsOutput = std::string(args.at(ai + 1));
+            else if (args[ai] == "--nodeStats")
+                nodeStats = std::stoi(args.at(ai + 1)) != 0;
+            else if (args[ai] == "--perfCounters")
+                perfCounters = std::stoi(args.at(ai + 1)) != 0;
             else if (args[ai] == "--batchSizes")
                 batchSizes = args.at(ai + 1);
             else if (args[ai] == "--batches")
                 batches = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--clients") {
+                clients = std::stoi(args.at(ai + 1));
+                if (clients < 0) throw std::invalid_argument("Number of clients must be non-negative: " + args.at(ai + 1));
+            }
+            else if (args[ai] == "--warmup")
+                warmup = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--requestRate") {
+                requestRate = std::stof(args.at(ai + 1));
+                if (requestRate < 0) throw std::invalid_argument("Request rate must be non-negative: " + args.at(ai + 1));
+            }
+            else if (args[ai] == "--rows")
+                genRows = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--features")
+                genFeatures = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--labels")
+                genLabels = std::stoi(args.at(ai + 1));
+            else if (args[ai] == "--labelsPerRow")
+                genLabelsPerRow = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--featuresPerRow")
+                genFeaturesPerRow = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--labelsPower")
+                genLabelsPower = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--featuresPower")
+                genFeaturesPower = std::stof(args.at(ai + 1));
+            else if (args[ai] == "--cooccurrence")
+                genCooccurrence = std::stof(args.at(ai + 1));
+
+            else if (args[ai] == "--weightsFormat") {
+                weightsFormatName = args.at(ai + 1);
+                if (args.at(ai + 1) == "legacy")
+                    weightsFormat = legacyWeights;
+                else if (args.at(ai + 1) == "compact")
+                    weightsFormat = compactWeights;
+                else
+                    throw std::invalid_argument("Unknown weights format: " + args.at(ai + 1));
+            } else if (args[ai] == "--weightsPrecision") {
+                weightsPrecisionName = args.at(ai + 1);
+                if (args.at(ai + 1) == "fp32")
+                    weightsPrecision = fp32;
+                else if (args.at(ai + 1) == "fp16")
+                    weightsPrecision = fp16;
+                else if (args.at(ai + 1) == "bf16")
+                    weightsPrecision = bf16;
+                else
+                    throw std::invalid_argument("Unknown weights precision: " + args.at(ai + 1));
+            }
 
             else if (args[ai] == "--measures")
                 measures = std::string(args.at(ai + 1));
@@ -454,8 +590,11 @@ void Args::printArgs(std::string command) {
     Log(CERR) << "napkinXC " << VERSION << " - " << command;
     if (!input.empty())
         Log(CERR) << "\n  Input: " << input << "\n    Bias: " << bias << ", norm: " << norm
-        << ", hash size: " << hash << ", features threshold: " << featuresThreshold;
-    Log(CERR) << "\n  Model: " << output << "\n    Type: " << modelName;
+        << ", hash size: " << hash << (hashSign ? " (signed)" : "") << ", features threshold: " << featuresThreshold;
+    if (command == "generate")
+        Log(CERR) << "\n  Output: " << output;
+    else Log(CERR) << "\n  Model: " << output << "\n    Type: " << modelName;
+    if (relabel && command != "generate") Log(CERR) << ", relabel: " << relabel;
     if (ensemble > 1){
         Log(CERR) << ", ensemble: " << ensemble;
         if (command == "test" || command == "predict")
@@ -489,24 +628,57 @@ void Args::printArgs(std::string command) {
             } else {
                 Log(CERR) << "\n    Tree: " << treeStructure;
             }
+            if (negSamplingRatio > 0 || negSamplingMax > 0)
+                Log(CERR) << "\n  Negative sampling ratio: " << negSamplingRatio << ", max negatives: " << negSamplingMax;
         }
     }
 
     if(!labelsWeights.empty()) Log(CERR) << "\n  Label weights: " << labelsWeights;
 
-    if (command == "test" || command == "predict") {
+    if (command == "test" || command == "predict" || command == "testPredictionTime") {
         if (modelType == plt || modelType == hsm || modelType == oplt) {
             Log(CERR) << "\n  Tree search type: " << treeSearchName;
             if(treeSearchType == beam && threshold <= 0 && thresholds.empty())
                 Log(CERR) << ", beam search width: " << beamSearchWidth;
+            if (shards > 0) Log(CERR) << "\n  Shards: " << shards;
+            if (nodeCache > 0) Log(CERR) << "\n  Node cache size: " << nodeCache << ", depth: " << nodeCacheDepth;
+            if (lazyLoading) Log(CERR) << "\n  Lazy loading, bases cache memory: " << formatMem(basesCacheMem) << ", pinned levels: " << pinLevels;
+            if (siblingBlocks) Log(CERR) << "\n  Sibling blocks, min fill: " << siblingBlocksMinFill;
         }
+        if (predictionCache > 0) Log(CERR) << "\n  Prediction cache size: " << predictionCache;
+        if (command == "test" || command == "predict") Log(CERR) << "\n  Prediction chunk size: " << chunkSize;
+        if (!prediction.empty()) Log(CERR) << "\n  Prediction format: " << predictionFormatName;
+        if (!statsOutput.empty()) Log(CERR) << "\n  Stats output: " << statsOutput << ", per-node stats: " << nodeStats;
         Log(CERR) << "\n  Base classifiers representation: " << representationName << " vector";
         if(thresholds.empty()) Log(CERR) << "\n  Top k: " << topK << ", threshold: " << threshold;
         else Log(CERR) << "\n  Thresholds: " << thresholds;
     }
 
+    if (command == "testPredictionTime") {
+        Log(CERR) << "\n  Batch sizes: " << batchSizes << ", batches: " << batches;
+        if (clients > 0) {
+            Log(CERR) << "\n  Clients: " << clients << ", warmup batches: " << warmup;
+            if (requestRate > 0) Log(CERR) << ", request rate: " << requestRate << "/s";
+        }
+    }
+
+    if (command == "shard")
+        Log(CERR) << "\n  Shards: " << shards << ", shard level: " << shardLevel;
+
     if (command == "ofo")
-        Log(CERR) << "\n  Epochs: " << epochs << ", initial a: " << ofoA << ", initial b: " << ofoB;
+        Log(CERR) << "\n  Epochs: " << epochs << ", initial a: " << ofoA << ", initial b: " << ofoB
+                  << ", batch size: " << ofoBatchSize;
+
+    if (command == "generate")
+        Log(CERR) << "\n  Rows: " << genRows << ", features: " << genFeatures << ", labels: " << genLabels
+                  << "\n  Labels / row: " << genLabelsPerRow << ", features / row: " << genFeaturesPerRow
+                  << "\n  Labels power: " << genLabelsPower << ", features power: " << genFeaturesPower
+                  << ", cooccurrence: " << genCooccurrence;
+
+    if (command == "convert") {
+        Log(CERR) << "\n  Weights format: " << weightsFormatName;
+        if (weightsFormat == compactWeights) Log(CERR) << ", precision: " << weightsPrecisionName;
+    }
 
     Log(CERR) << "\n  Threads: " << threads << ", memory limit: " << formatMem(memLimit)
     << "\n  Seed: " << seed << "\n";
@@ -537,6 +709,10 @@ void Args::save(std::ofstream& out) {
     saveVar(out, modelType);
     saveVar(out, modelName);
     saveVar(out, ensemble);
+
+    // Saved at the end, so args of models saved before they were added can still be loaded
+    saveVar(out, hashSign);
+    saveVar(out, relabel);
 }
 
 void Args::load(std::ifstream& in) {
@@ -555,6 +731,8 @@ void Args::load(std::ifstream& in) {
     loadVar(in, modelType);
     loadVar(in, modelName);
     loadVar(in, ensemble);
+    if (in.peek() != EOF) loadVar(in, hashSign);
+    if (in.peek() != EOF) loadVar(in, relabel);
 
     parseArgs(parsedArgs, false);
 }
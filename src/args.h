@@ -44,9 +44,10 @@ public:
     // Threading, memory and seed options
     int seed;
     int threads;
-    unsigned long long memLimit; // TODO: Implement this for some models
+    unsigned long long memLimit;
     bool saveGrads;
     bool resume;
+    int checkpoint;
     RepresentationType loadAs;
 
     // Input/output options
@@ -58,7 +59,9 @@ public:
     Real bias;
     bool norm;
     int hash;
+    bool hashSign;
     Real featuresThreshold;
+    bool relabel;
 
     // Training options
     int solverType;
@@ -70,6 +73,8 @@ public:
     Real weightsThreshold;
     bool inbalanceLabelsWeighting;
     bool pickOneLabelWeighting;
+    Real negSamplingRatio;
+    int negSamplingMax;
     bool autoCLin;
     bool autoCLog;
     bool reportLoss;
@@ -94,6 +99,8 @@ public:
     int arity;
     int maxLeaves;
     int flattenTree;
+    int shards;
+    int shardLevel;
 
     // K-Means tree options
     Real kmeansEps;
@@ -118,6 +125,19 @@ public:
     TreeSearchType treeSearchType;
     int beamSearchWidth;
     bool beamSearchUnpack;
+    int predictionCache;
+    int nodeCache;
+    int nodeCacheDepth;
+    bool lazyLoading;
+    unsigned long long basesCacheMem;
+    int pinLevels;
+    bool siblingBlocks;
+    Real siblingBlocksMinFill;
+    int chunkSize;
+    PredictionFormat predictionFormat;
+    std::string statsOutput;
+    bool perfCounters;
+    bool nodeStats;
 
     // Measures for test command
     std::string measures;
@@ -127,6 +147,7 @@ public:
     Real ofoTopLabels;
     Real ofoA;
     Real ofoB;
+    int ofoBatchSize;
 
     Real psA;
     double psB;
@@ -134,6 +155,23 @@ public:
     // Args for testPredictionTime command
     std::string batchSizes;
     int batches;
+    int clients;
+    int warmup;
+    Real requestRate;
+
+    // Args for generate command
+    int genRows;
+    int genFeatures;
+    int genLabels;
+    Real genLabelsPerRow;
+    Real genFeaturesPerRow;
+    Real genLabelsPower;
+    Real genFeaturesPower;
+    Real genCooccurrence;
+
+    // Args for convert command
+    WeightsFormat weightsFormat;
+    WeightsPrecision weightsPrecision;
 
 private:
     std::default_random_engine rngSeeder;
@@ -147,6 +185,9 @@ private:
     std::string ofoTypeName;
     std::string treeSearchName;
     std::string representationName;
+    std::string predictionFormatName;
+    std::string weightsFormatName;
+    std::string weightsPrecisionName;
 
     std::vector<std::string> parsedArgs;
 };
@@ -111,6 +111,7 @@ void Base::trainLiblinear(ProblemData& problemData, Args& args) {
     auto output = check_parameter(&P, &C);
     assert(output == NULL);
 
+    set_rand_seed(problemData.seed);
     model* M = train_liblinear(&P, &C);
 
     assert(M->nr_class <= 2);
@@ -275,6 +276,10 @@ void Base::finalizeOnlineTraining(Args& args) {
 }
 
 Real Base::predictValue(SparseVector& features) {
+    return predictValue(features, W);
+}
+
+Real Base::predictValue(SparseVector& features, AbstractVector* W) {
     if (classCount < 2 || !W) return static_cast<Real>((1 - 2 * firstClass) * -10);
     Real val = W->dot(features);
     if (firstClass == 0) val *= -1;
@@ -283,7 +288,14 @@ Real Base::predictValue(SparseVector& features) {
 }
 
 Real Base::predictProbability(SparseVector& features) {
-    Real val = predictValue(features);
+    return predictProbability(features, W);
+}
+
+Real Base::predictProbability(SparseVector& features, AbstractVector* W) {
+    return valueToProbability(predictValue(features, W), lossType);
+}
+
+Real Base::valueToProbability(Real val, LossType lossType) {
     if (lossType == squaredHinge)
         //val = 1.0 / (1.0 + std::exp(-2 * val)); // Probability for squared Hinge loss solver
         val = std::exp(-std::pow(std::max(0.0, 1.0 - val), 2));
@@ -371,6 +383,54 @@ void Base::load(std::ifstream& in, bool loadGrads, RepresentationType loadAs) {
     }
 }
 
+void Base::skipLoad(std::ifstream& in) {
+    int classCount, firstClass;
+    LossType lossType;
+    loadVar(in, classCount);
+    loadVar(in, firstClass);
+    loadVar(in, lossType);
+
+    if (classCount > 1) {
+        in.seekg(2 * sizeof(size_t), std::ios::cur);
+        AbstractVector::skipLoad(in);
+        bool grads;
+        loadVar(in, grads);
+        if (grads) AbstractVector::skipLoad(in);
+    }
+}
+
+void Base::saveCompact(std::vector<uint8_t>& out, WeightsPrecision precision) {
+    saveVarint(out, classCount);
+    saveVarint(out, static_cast<uint32_t>(firstClass));
+    saveVarint(out, lossType);
+    if (classCount > 1) W->saveCompact(out, precision);
+}
+
+void Base::loadCompact(const uint8_t* in, WeightsPrecision precision, RepresentationType loadAs) {
+    clear();
+    classCount = loadVarint(in);
+    firstClass = static_cast<int>(static_cast<uint32_t>(loadVarint(in)));
+    setLoss(static_cast<LossType>(loadVarint(in)));
+
+    if (classCount > 1) {
+        size_t s;
+        size_t n0;
+        AbstractVector::peekCompact(in, s, n0);
+
+        // Decide on optimal representation in case of map
+        size_t denseSize = Vector::estimateMem(s, n0);
+        size_t mapSize = MapVector::estimateMem(s, n0);
+        size_t sparseSize = SparseVector::estimateMem(s, n0);
+        bool loadMap = (mapSize < denseSize || s == 0);
+        bool loadSparse = (sparseSize < denseSize || s == 0);
+
+        if(loadAs == map && loadMap) W = new MapVector();
+        else if(loadAs == sparse && loadSparse) W = new SparseVector();
+        else W = new Vector();
+        W->loadCompact(in, precision);
+    }
+}
+
 void Base::setLoss(LossType lossType){
     this->lossType = lossType;
     if (lossType == logistic) {
@@ -46,6 +46,7 @@ struct ProblemData {
     Real invPs; // inverse propensity
     int r; // number of all examples
     Real loss;
+    unsigned int seed; // seed of the solver
 
     ProblemData(std::vector<Real>& binLabels, std::vector<Feature*>& binFeatures, int n, std::vector<Real>& instancesWeights):
                 binLabels(binLabels), binFeatures(binFeatures), n(n), instancesWeights(instancesWeights) {
@@ -54,6 +55,7 @@ struct ProblemData {
         labelsWeights = NULL;
         invPs = 1.0;
         r = 0;
+        seed = 0;
     }
 };
 
@@ -77,6 +79,11 @@ public:
     Real predictValue(SparseVector& features);
     Real predictProbability(SparseVector& features);
 
+    // Versions using given weights instead of own ones, e.g. an unpacked copy of them
+    Real predictValue(SparseVector& features, AbstractVector* W);
+    Real predictProbability(SparseVector& features, AbstractVector* W);
+    static Real valueToProbability(Real val, LossType lossType);
+
     inline AbstractVector* getW() { return W; };
     inline AbstractVector* getG() { return G; };
 
@@ -85,6 +92,7 @@ public:
 
     unsigned long long mem();
     inline int getFirstClass() { return firstClass; }
+    inline LossType getLoss() { return lossType; }
     void clear();
 
     void to(RepresentationType type); // Change representation type of base classifier
@@ -95,6 +103,11 @@ public:
 
     void save(std::ofstream& out, bool saveGrads=false);
     void load(std::ifstream& in, bool loadGrads=false, RepresentationType loadAs=map);
+    static void skipLoad(std::ifstream& in);
+
+    // Compact coding of a base, used by compact weights files, gradients are not stored
+    void saveCompact(std::vector<uint8_t>& out, WeightsPrecision precision=fp32);
+    void loadCompact(const uint8_t* in, WeightsPrecision precision=fp32, RepresentationType loadAs=map);
 
     Base* copy();
     Base* copyInverted();
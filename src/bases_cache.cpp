@@ -0,0 +1,127 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bases_cache.h"
+#include "log.h"
+#include "misc.h"
+
+
+BasesCache::BasesCache(std::string infile, unsigned long long memLimit, RepresentationType loadAs):
+    infile(infile), memLimit(memLimit), loadAs(loadAs), hand(0), memUsed(0), hitsCount(0), missesCount(0), evictionsCount(0) {
+    auto reader = std::make_unique<WeightsReader>(infile);
+    offsets = reader->buildIndex();
+    readers.push_back(std::move(reader));
+    slots = std::make_unique<Slot[]>(size());
+}
+
+std::vector<Base*> BasesCache::loadPinned(const std::vector<bool>& pinned) {
+    Log(CERR) << "Loading pinned base estimators ...\n";
+
+    int size = this->size();
+    std::vector<Base*> bases(size, nullptr);
+    int count = 0;
+    unsigned long long pinnedMem = 0;
+    for (int i = 0; i < size; ++i) {
+        printProgress(i, size);
+        if (!pinned[i]) continue;
+        bases[i] = new Base();
+        read(i, *bases[i]);
+        pinnedMem += bases[i]->mem();
+        ++count;
+    }
+
+    Log(CERR) << "  Pinned bases: " << count << "/" << size << ", size: " << formatMem(pinnedMem)
+              << "\n  Other bases are loaded on first use, cache memory limit: " << formatMem(memLimit) << "\n";
+
+    return bases;
+}
+
+std::shared_ptr<Base> BasesCache::get(int index) {
+    Slot& slot = slots[index];
+    std::shared_ptr<Base> base;
+    {
+        std::lock_guard<std::mutex> lock(slot.mtx);
+        slot.referenced = true;
+        if (slot.base != nullptr) {
+            ++hitsCount;
+            return slot.base;
+        }
+
+        // Threads that need the same base wait for it to be loaded once
+        ++missesCount;
+        base = std::make_shared<Base>();
+        read(index, *base);
+        slot.base = base;
+        slot.mem = base->mem();
+        memUsed += slot.mem;
+    }
+
+    std::lock_guard<std::mutex> lock(clockMtx);
+    clock.push_back(index);
+    if (memUsed > memLimit) evict();
+    return base;
+}
+
+void BasesCache::read(int index, Base& base) {
+    std::unique_ptr<WeightsReader> reader;
+    {
+        std::lock_guard<std::mutex> lock(readersMtx);
+        if (!readers.empty()) {
+            reader = std::move(readers.back());
+            readers.pop_back();
+        }
+    }
+    if (reader == nullptr) reader = std::make_unique<WeightsReader>(infile);
+
+    reader->seek(offsets[index]);
+    reader->read(base, false, loadAs);
+
+    std::lock_guard<std::mutex> lock(readersMtx);
+    readers.push_back(std::move(reader));
+}
+
+void BasesCache::evict() {
+    // Called with clock mutex locked, slots are only tried to be locked, because get locks them in the opposite order.
+    // Bases still used by other threads are freed when they release them.
+    size_t steps = 0;
+    while (memUsed > memLimit && clock.size() > 1 && steps++ < 4 * clock.size()) {
+        if (hand >= clock.size()) hand = 0;
+        Slot& slot = slots[clock[hand]];
+        if (slot.referenced.exchange(false)) {
+            ++hand;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(slot.mtx, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            ++hand;
+            continue;
+        }
+
+        memUsed -= slot.mem;
+        slot.mem = 0;
+        slot.base = nullptr;
+        ++evictionsCount;
+        clock[hand] = clock.back();
+        clock.pop_back();
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base.h"
+#include "weights_file.h"
+
+
+// Reference to a base estimator, keeps a base loaded on demand alive while it's used
+class BaseRef {
+public:
+    BaseRef(Base* base): base(base) {}
+    BaseRef(std::shared_ptr<Base> cached): base(cached.get()), cached(std::move(cached)) {}
+
+    inline Base* operator->() const { return base; }
+    inline Base* get() const { return base; }
+
+private:
+    Base* base;
+    std::shared_ptr<Base> cached;
+};
+
+// Base estimators loaded from weights file on first use, located with the offset index of the file.
+// Loaded bases are kept within the memory limit, the ones not used recently are evicted with CLOCK algorithm.
+class BasesCache {
+public:
+    BasesCache(std::string infile, unsigned long long memLimit, RepresentationType loadAs = map);
+
+    // Loads bases selected to stay in memory, other bases are nullptr
+    std::vector<Base*> loadPinned(const std::vector<bool>& pinned);
+
+    std::shared_ptr<Base> get(int index);
+
+    inline int size() const { return offsets.size() - 1; }
+    inline unsigned long long mem() const { return memUsed; }
+    inline unsigned long long hits() const { return hitsCount; }
+    inline unsigned long long misses() const { return missesCount; }
+    inline unsigned long long evictions() const { return evictionsCount; }
+
+private:
+    struct Slot {
+        std::mutex mtx;
+        std::shared_ptr<Base> base;
+        std::atomic<bool> referenced{false};
+        unsigned long long mem = 0;
+    };
+
+    std::string infile;
+    unsigned long long memLimit;
+    RepresentationType loadAs;
+    std::vector<unsigned long long> offsets;
+    std::unique_ptr<Slot[]> slots;
+
+    // Indices of loaded bases, swept by the clock hand
+    std::mutex clockMtx;
+    std::vector<int> clock;
+    size_t hand;
+
+    // Readers are not thread-safe, so each load takes one from the pool
+    std::mutex readersMtx;
+    std::vector<std::unique_ptr<WeightsReader>> readers;
+
+    std::atomic<unsigned long long> memUsed;
+    std::atomic<unsigned long long> hitsCount;
+    std::atomic<unsigned long long> missesCount;
+    std::atomic<unsigned long long> evictionsCount;
+
+    void read(int index, Base& base);
+    void evict();
+};
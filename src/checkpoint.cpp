@@ -0,0 +1,145 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+
+#include "checkpoint.h"
+#include "log.h"
+#include "misc.h"
+
+
+BasesCheckpoint::BasesCheckpoint(std::string dir, int segmentSize, bool resume, std::string fingerprint):
+    dir(dir), segmentSize(segmentSize) {
+    current = {-1, -1, 0, ""};
+    if (!resume) ::remove(dir);
+    makeDir(dir);
+    loadManifest(fingerprint);
+}
+
+BasesCheckpoint::~BasesCheckpoint() {
+    closeSegment();
+}
+
+void BasesCheckpoint::loadManifest(std::string& fingerprint) {
+    segments.clear();
+    std::string manifest = joinPath(dir, "manifest.txt");
+    if (!std::filesystem::exists(manifest)) {
+        std::ofstream out(manifest);
+        out << "fingerprint " << fingerprint << "\n";
+        out.close();
+        return;
+    }
+
+    // Estimators trained on other data or with other arguments can't be mixed with the new ones
+    std::ifstream in(manifest);
+    std::string line;
+    std::getline(in, line);
+    if (line != "fingerprint " + fingerprint)
+        throw std::runtime_error("Checkpoint in " + dir + " was created for different data or arguments, "
+                                 "resume training with the same ones or train without --resume option");
+
+    while (std::getline(in, line)) {
+        Segment segment;
+        std::istringstream lineStream(line);
+        if (!(lineStream >> segment.start >> segment.stop >> segment.size >> segment.file)) continue; // Incomplete entry
+
+        // Check if segment file is complete
+        std::string path = joinPath(dir, segment.file);
+        if (!std::filesystem::exists(path) || std::filesystem::file_size(path) != segment.size) continue;
+        segments.push_back(segment);
+    }
+    in.close();
+
+    std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.start < b.start; });
+
+    if (!segments.empty()) {
+        int trained = 0;
+        for (const auto& s : segments) trained += s.stop - s.start;
+        Log(CERR) << "Loaded checkpoint with " << trained << " trained base estimators from " << dir << "\n";
+    }
+}
+
+void BasesCheckpoint::addToManifest(Segment& segment) {
+    std::ofstream out(joinPath(dir, "manifest.txt"), std::ios::out | std::ios::app);
+    out << segment.start << " " << segment.stop << " " << segment.size << " " << segment.file << "\n";
+    out.close();
+    segments.push_back(segment);
+}
+
+bool BasesCheckpoint::isTrained(int index) {
+    for (const auto& s : segments)
+        if (index >= s.start && index < s.stop) return true;
+    return false;
+}
+
+int BasesCheckpoint::countTrained(int start, int stop) {
+    int count = 0;
+    for (const auto& s : segments)
+        count += std::max(0, std::min(stop, s.stop) - std::max(start, s.start));
+    return count;
+}
+
+void BasesCheckpoint::save(int index, Base* base, bool saveGrads) {
+    if (segmentOut.is_open() && (index != current.stop || current.stop - current.start >= segmentSize)) closeSegment();
+    if (!segmentOut.is_open()) {
+        current = {index, index, 0, "segment_" + std::to_string(index) + ".bin"};
+        segmentOut.open(joinPath(dir, current.file), std::ios::out | std::ios::binary);
+    }
+
+    base->save(segmentOut, saveGrads);
+    current.stop = index + 1;
+}
+
+void BasesCheckpoint::closeSegment() {
+    if (!segmentOut.is_open()) return;
+    segmentOut.close();
+    current.size = std::filesystem::file_size(joinPath(dir, current.file));
+    addToManifest(current);
+}
+
+void BasesCheckpoint::copyTo(std::ofstream& out, int start, int stop) {
+    closeSegment();
+    std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.start < b.start; });
+
+    int next = start;
+    for (const auto& s : segments) {
+        if (s.stop <= start || s.start >= stop) continue;
+        if (s.start != next || s.stop > stop)
+            throw std::runtime_error("Checkpoint in " + dir + " does not match trained base estimators, train without --resume option");
+
+        std::ifstream in(joinPath(dir, s.file), std::ios::in | std::ios::binary);
+        out << in.rdbuf();
+        in.close();
+        next = s.stop;
+    }
+
+    if (next != stop)
+        throw std::runtime_error("Checkpoint in " + dir + " is missing base estimators [" + std::to_string(next) + ", " + std::to_string(stop) + ")");
+}
+
+void BasesCheckpoint::remove() {
+    closeSegment();
+    segments.clear();
+    ::remove(dir);
+}
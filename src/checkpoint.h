@@ -0,0 +1,67 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "base.h"
+
+
+// Keeps trained base estimators in segment files, allows to resume interrupted training.
+// Manifest starts with a fingerprint of the data and arguments, training can be resumed only with the same fingerprint.
+class BasesCheckpoint {
+public:
+    BasesCheckpoint(std::string dir, int segmentSize, bool resume, std::string fingerprint);
+    ~BasesCheckpoint();
+
+    bool isTrained(int index);
+    int countTrained(int start, int stop);
+
+    // Bases has to be saved in order of their indices
+    void save(int index, Base* base, bool saveGrads = false);
+    void closeSegment();
+
+    // Copies bases with indices in [start, stop) range to the output stream
+    void copyTo(std::ofstream& out, int start, int stop);
+    void remove();
+
+private:
+    struct Segment {
+        int start;
+        int stop;
+        unsigned long long size;
+        std::string file;
+    };
+
+    std::string dir;
+    int segmentSize;
+    std::vector<Segment> segments;
+
+    std::ofstream segmentOut;
+    Segment current;
+
+    void loadManifest(std::string& fingerprint);
+    void addToManifest(Segment& segment);
+};
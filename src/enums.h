@@ -67,6 +67,22 @@ enum TreeSearchType{
     beam
 };
 
+enum PredictionFormat {
+    textFormat,
+    binaryFormat
+};
+
+enum WeightsFormat {
+    legacyWeights,
+    compactWeights
+};
+
+enum WeightsPrecision {
+    fp32,
+    fp16,
+    bf16
+};
+
 enum OFOType {
     micro,
     macro,
@@ -0,0 +1,138 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include "basic_types.h"
+#include "vector.h"
+
+
+// Bounded LRU cache with values computed for feature vectors, split into independently locked shards.
+// Keys are hashes of features and additional parameters (salt), stored features are compared on hit.
+template <typename T> class FeaturesCache {
+public:
+    FeaturesCache(size_t size, int shardsCount = 16);
+
+    bool get(SparseVector& features, uint64_t salt, T& value);
+    void put(SparseVector& features, uint64_t salt, const T& value);
+    void clear();
+
+    inline unsigned long long hits() const { return hitsCount; }
+    inline unsigned long long misses() const { return missesCount; }
+
+private:
+    struct Entry {
+        uint64_t key;
+        std::vector<Feature> features;
+        T value;
+    };
+
+    struct Shard {
+        std::mutex mtx;
+        std::list<Entry> entries; // Most recently used first
+        UnorderedMap<uint64_t, typename std::list<Entry>::iterator> map;
+    };
+
+    size_t shardSize;
+    std::vector<Shard> shards;
+    std::atomic<unsigned long long> hitsCount;
+    std::atomic<unsigned long long> missesCount;
+
+    static uint64_t hashFeatures(SparseVector& features, uint64_t salt);
+    static bool equalFeatures(const std::vector<Feature>& stored, SparseVector& features);
+};
+
+template <typename T>
+FeaturesCache<T>::FeaturesCache(size_t size, int shardsCount): shards(shardsCount), hitsCount(0), missesCount(0) {
+    shardSize = std::max<size_t>(1, (size + shardsCount - 1) / shardsCount);
+}
+
+// 64-bit Fowler–Noll–Vo hash of features and salt
+template <typename T> uint64_t FeaturesCache<T>::hashFeatures(SparseVector& features, uint64_t salt) {
+    uint64_t h = 14695981039346656037ULL ^ salt;
+    for (auto& f : features) {
+        auto bytes = reinterpret_cast<uint8_t*>(&f);
+        for (size_t i = 0; i < sizeof(Feature); ++i) {
+            h ^= bytes[i];
+            h *= 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+template <typename T> bool FeaturesCache<T>::equalFeatures(const std::vector<Feature>& stored, SparseVector& features) {
+    if (stored.size() != features.nonZero()) return false;
+    auto f = features.begin();
+    for (auto& s : stored) {
+        if (s.index != f->index || s.value != f->value) return false;
+        ++f;
+    }
+    return true;
+}
+
+template <typename T> bool FeaturesCache<T>::get(SparseVector& features, uint64_t salt, T& value) {
+    uint64_t key = hashFeatures(features, salt);
+    auto& shard = shards[key % shards.size()];
+
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto fn = shard.map.find(key);
+    if (fn == shard.map.end() || !equalFeatures(fn->second->features, features)) {
+        ++missesCount;
+        return false;
+    }
+
+    shard.entries.splice(shard.entries.begin(), shard.entries, fn->second);
+    value = fn->second->value;
+    ++hitsCount;
+    return true;
+}
+
+template <typename T> void FeaturesCache<T>::put(SparseVector& features, uint64_t salt, const T& value) {
+    uint64_t key = hashFeatures(features, salt);
+    auto& shard = shards[key % shards.size()];
+
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto fn = shard.map.find(key);
+    if (fn != shard.map.end()) { // Replace entry with the same key, also in case of hash collision
+        shard.entries.erase(fn->second);
+        shard.map.erase(fn);
+    } else if (shard.entries.size() >= shardSize) {
+        shard.map.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+
+    shard.entries.push_front({key, std::vector<Feature>(features.begin(), features.end()), value});
+    shard.map[key] = shard.entries.begin();
+}
+
+template <typename T> void FeaturesCache<T>::clear() {
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.entries.clear();
+        shard.map.clear();
+    }
+}
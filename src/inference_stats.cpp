@@ -0,0 +1,254 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include "inference_stats.h"
+
+
+LatencyHistogram::LatencyHistogram(): total(0), sum(0), minValue(std::numeric_limits<uint64_t>::max()), maxValue(0) {
+    counts.fill(0);
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < subBuckets) return static_cast<int>(value);
+    int exp = 63 - __builtin_clzll(value); // Position of the highest bit, >= subBucketBits
+    int sub = static_cast<int>(value >> (exp - subBucketBits)) & (subBuckets - 1);
+    return (exp - subBucketBits + 1) * subBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(int index) {
+    if (index < subBuckets) return index;
+    int exp = index / subBuckets + subBucketBits - 1;
+    uint64_t sub = index % subBuckets;
+    return (subBuckets + sub) << (exp - subBucketBits);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index + 1 >= bucketsCount) return std::numeric_limits<uint64_t>::max();
+    return bucketLowerBound(index + 1) - 1;
+}
+
+void LatencyHistogram::add(int index, uint64_t count) {
+    counts[index] += count;
+    total += count;
+}
+
+void LatencyHistogram::addRange(uint64_t valuesSum, uint64_t valuesMin, uint64_t valuesMax) {
+    sum += valuesSum;
+    minValue = std::min(minValue, valuesMin);
+    maxValue = std::max(maxValue, valuesMax);
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    add(bucketIndex(value), 1);
+    addRange(value, value, value);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (int i = 0; i < bucketsCount; ++i) counts[i] += other.counts[i];
+    total += other.total;
+    sum += other.sum;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (!total) return 0;
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p / 100 * total + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < bucketsCount; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return std::min(bucketUpperBound(i), maxValue);
+    }
+    return maxValue;
+}
+
+template<typename T> void mergeCounts(std::vector<T>& to, const std::vector<T>& from){
+    if (to.size() < from.size()) to.resize(from.size(), 0);
+    for (size_t i = 0; i < from.size(); ++i) to[i] += from[i];
+}
+
+void StatsSummary::merge(const StatsSummary& other) {
+    dataPoints += other.dataPoints;
+    nodeEvaluations += other.nodeEvaluations;
+    nodeUpdates += other.nodeUpdates;
+    mergeCounts(depthEvaluations, other.depthEvaluations);
+    mergeCounts(nodesEvaluations, other.nodesEvaluations);
+    latency.merge(other.latency);
+}
+
+template<typename T> void writeJsonArray(std::ostream& out, const std::vector<T>& values){
+    out << "[";
+    for (size_t i = 0; i < values.size(); ++i) out << (i ? ", " : "") << values[i];
+    out << "]";
+}
+
+std::string StatsSummary::toJson() const {
+    std::ostringstream out;
+    out << "{\n  \"data_points\": " << dataPoints
+        << ",\n  \"node_evaluations\": " << nodeEvaluations
+        << ",\n  \"node_updates\": " << nodeUpdates
+        << ",\n  \"evaluations_per_data_point\": " << (dataPoints ? static_cast<double>(nodeEvaluations) / dataPoints : 0)
+        << ",\n  \"depth_evaluations\": ";
+    writeJsonArray(out, depthEvaluations);
+    if (!nodesEvaluations.empty()) {
+        out << ",\n  \"nodes_evaluations\": ";
+        writeJsonArray(out, nodesEvaluations);
+    }
+
+    out << ",\n  \"latency_ns\": {\n    \"count\": " << latency.count()
+        << ",\n    \"min\": " << latency.min()
+        << ",\n    \"mean\": " << latency.mean()
+        << ",\n    \"p50\": " << latency.percentile(50)
+        << ",\n    \"p90\": " << latency.percentile(90)
+        << ",\n    \"p99\": " << latency.percentile(99)
+        << ",\n    \"p999\": " << latency.percentile(99.9)
+        << ",\n    \"max\": " << latency.max()
+        << ",\n    \"buckets\": [";
+    bool first = true;
+    for (int i = 0; i < LatencyHistogram::bucketsCount; ++i) {
+        if (!latency.bucket(i)) continue;
+        out << (first ? "" : ", ") << "[" << LatencyHistogram::bucketLowerBound(i) << ", " << latency.bucket(i) << "]";
+        first = false;
+    }
+    out << "]\n  }\n}\n";
+
+    return out.str();
+}
+
+void StatsSummary::saveToJson(std::string outfile) const {
+    std::ofstream out(outfile);
+    if (!out.is_open()) throw std::invalid_argument("Cannot open stats output file: " + outfile);
+    out << toJson();
+    out.close();
+}
+
+ThreadStats::ThreadStats(const std::vector<int>& nodesDepth, int treeDepth, bool perNode)
+    : nodesDepth(nodesDepth), dataPoints(0), nodeEvaluations(0), nodeUpdates(0),
+      depthEvaluations(nodesDepth.empty() ? 0 : treeDepth), nodesEvaluations(perNode ? nodesDepth.size() : 0),
+      latencySum(0), latencyMin(std::numeric_limits<uint64_t>::max()), latencyMax(0) {
+    for (auto& c : depthEvaluations) c = 0;
+    for (auto& c : nodesEvaluations) c = 0;
+    for (auto& c : latency) c = 0;
+}
+
+template<typename T> void loadCounts(std::vector<unsigned long long>& to, const std::vector<std::atomic<T>>& from){
+    if (to.size() < from.size()) to.resize(from.size(), 0);
+    for (size_t i = 0; i < from.size(); ++i) to[i] += from[i].load(std::memory_order_relaxed);
+}
+
+void ThreadStats::mergeInto(StatsSummary& summary) const {
+    summary.dataPoints += dataPoints.load(std::memory_order_relaxed);
+    summary.nodeEvaluations += nodeEvaluations.load(std::memory_order_relaxed);
+    summary.nodeUpdates += nodeUpdates.load(std::memory_order_relaxed);
+    loadCounts(summary.depthEvaluations, depthEvaluations);
+    loadCounts(summary.nodesEvaluations, nodesEvaluations);
+
+    LatencyHistogram threadLatency;
+    for (int i = 0; i < LatencyHistogram::bucketsCount; ++i) {
+        uint64_t count = latency[i].load(std::memory_order_relaxed);
+        if (count) threadLatency.add(i, count);
+    }
+    threadLatency.addRange(latencySum.load(std::memory_order_relaxed), latencyMin.load(std::memory_order_relaxed),
+                           latencyMax.load(std::memory_order_relaxed));
+    summary.latency.merge(threadLatency);
+}
+
+// Per-thread cache of slots of recently used registries, returns slots to the registry when the thread finishes
+struct ThreadStatsCache {
+    struct Entry {
+        InferenceStats::Registry* registry;
+        std::weak_ptr<InferenceStats::Registry> owner;
+        ThreadStats* slot;
+    };
+    std::vector<Entry> entries;
+
+    ~ThreadStatsCache() {
+        for (auto& e : entries)
+            if (auto registry = e.owner.lock()) registry->release(e.slot);
+    }
+};
+
+ThreadStats* InferenceStats::Registry::acquire() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!freeSlots.empty()) {
+        auto slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    slots.emplace_back(new ThreadStats(nodesDepth, treeDepth, perNode));
+    return slots.back().get();
+}
+
+void InferenceStats::Registry::release(ThreadStats* slot) {
+    std::lock_guard<std::mutex> lock(mtx);
+    freeSlots.push_back(slot);
+}
+
+InferenceStats::InferenceStats() {
+    clear();
+}
+
+void InferenceStats::setNodes(std::vector<int> nodesDepth, bool perNode) {
+    auto newRegistry = std::make_shared<Registry>();
+    newRegistry->treeDepth = nodesDepth.empty() ? 0 : *std::max_element(nodesDepth.begin(), nodesDepth.end()) + 1;
+    newRegistry->nodesDepth = std::move(nodesDepth);
+    newRegistry->perNode = perNode;
+    registry = newRegistry;
+}
+
+void InferenceStats::clear() {
+    auto newRegistry = std::make_shared<Registry>();
+    if (registry != nullptr) {
+        newRegistry->nodesDepth = registry->nodesDepth;
+        newRegistry->treeDepth = registry->treeDepth;
+        newRegistry->perNode = registry->perNode;
+    }
+    registry = newRegistry;
+}
+
+ThreadStats& InferenceStats::local() {
+    thread_local ThreadStatsCache cache;
+
+    Registry* current = registry.get();
+    for (auto it = cache.entries.begin(); it != cache.entries.end();) {
+        if (it->owner.expired()) it = cache.entries.erase(it); // Registry replaced or stats destroyed
+        else if (it->registry == current) return *it->slot;
+        else ++it;
+    }
+
+    ThreadStats* slot = current->acquire();
+    cache.entries.push_back({current, registry, slot});
+    return *slot;
+}
+
+StatsSummary InferenceStats::summary() const {
+    StatsSummary summary;
+    std::lock_guard<std::mutex> lock(registry->mtx);
+    summary.depthEvaluations.resize(registry->nodesDepth.empty() ? 0 : registry->treeDepth, 0);
+    for (auto& s : registry->slots) s->mergeInto(summary);
+    return summary;
+}
@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Log-linear (HDR-style) histogram of latencies in nanoseconds, with relative precision of 1/16
+class LatencyHistogram {
+public:
+    static const int subBucketBits = 4;
+    static const int subBuckets = 1 << subBucketBits;
+    static const int bucketsCount = (64 - subBucketBits + 1) * subBuckets;
+
+    LatencyHistogram();
+
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketLowerBound(int index);
+    static uint64_t bucketUpperBound(int index);
+
+    // Adds values to the bucket, their sum and range has to be added separately with addRange
+    void add(int index, uint64_t count);
+    void addRange(uint64_t valuesSum, uint64_t valuesMin, uint64_t valuesMax);
+    void record(uint64_t value);
+    void merge(const LatencyHistogram& other);
+
+    inline uint64_t count() const { return total; }
+    inline uint64_t min() const { return total ? minValue : 0; }
+    inline uint64_t max() const { return maxValue; }
+    inline double mean() const { return total ? static_cast<double>(sum) / total : 0; }
+
+    // Returns upper bound of the bucket containing given percentile (0-100)
+    uint64_t percentile(double p) const;
+    inline uint64_t bucket(int index) const { return counts[index]; }
+
+private:
+    std::array<uint64_t, bucketsCount> counts;
+    uint64_t total;
+    uint64_t sum;
+    uint64_t minValue;
+    uint64_t maxValue;
+};
+
+// Merged statistics of all threads
+struct StatsSummary {
+    unsigned long long dataPoints = 0;
+    unsigned long long nodeEvaluations = 0;
+    unsigned long long nodeUpdates = 0;
+    std::vector<unsigned long long> depthEvaluations;
+    std::vector<unsigned long long> nodesEvaluations; // Empty if per-node counters are disabled
+    LatencyHistogram latency;
+
+    void merge(const StatsSummary& other);
+    std::string toJson() const;
+    void saveToJson(std::string outfile) const;
+};
+
+// Counters of a single thread, only the owning thread writes them, so relaxed loads and stores are enough,
+// but they can be read at any time while merging.
+class ThreadStats {
+public:
+    ThreadStats(const std::vector<int>& nodesDepth, int treeDepth, bool perNode);
+
+    inline void addDataPoints(unsigned long long count = 1) { add(dataPoints, count); }
+    inline void addNodeUpdates(unsigned long long count) { add(nodeUpdates, count); }
+    inline void addLatency(uint64_t ns) {
+        add(latency[LatencyHistogram::bucketIndex(ns)], 1);
+        add(latencySum, ns);
+        if (ns < latencyMin.load(std::memory_order_relaxed)) latencyMin.store(ns, std::memory_order_relaxed);
+        if (ns > latencyMax.load(std::memory_order_relaxed)) latencyMax.store(ns, std::memory_order_relaxed);
+    }
+    inline void addNodeEvaluations(int node, unsigned long long count = 1) {
+        add(nodeEvaluations, count);
+        if (!nodesDepth.empty()) add(depthEvaluations[nodesDepth[node]], count);
+        if (!nodesEvaluations.empty()) add(nodesEvaluations[node], count);
+    }
+
+    void mergeInto(StatsSummary& summary) const;
+
+private:
+    const std::vector<int>& nodesDepth;
+    std::atomic<unsigned long long> dataPoints;
+    std::atomic<unsigned long long> nodeEvaluations;
+    std::atomic<unsigned long long> nodeUpdates;
+    std::vector<std::atomic<unsigned long long>> depthEvaluations;
+    std::vector<std::atomic<unsigned long long>> nodesEvaluations;
+    std::array<std::atomic<uint64_t>, LatencyHistogram::bucketsCount> latency;
+    std::atomic<uint64_t> latencySum;
+    std::atomic<uint64_t> latencyMin;
+    std::atomic<uint64_t> latencyMax;
+
+    template<typename T, typename U> static inline void add(std::atomic<T>& counter, U value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+};
+
+// Inference instrumentation: each thread updates its own counters, they are merged on demand
+class InferenceStats {
+public:
+    InferenceStats();
+
+    // Sets depth of each node for per-depth counters and enables per-node counters, resets all counters.
+    // Must not be called while other threads are updating the counters, same as clear.
+    void setNodes(std::vector<int> nodesDepth, bool perNode);
+    void clear();
+
+    // Returns counters of the calling thread
+    ThreadStats& local();
+
+    StatsSummary summary() const;
+
+private:
+    struct Registry {
+        std::mutex mtx;
+        std::vector<int> nodesDepth;
+        int treeDepth = 0;
+        bool perNode = false;
+        std::vector<std::unique_ptr<ThreadStats>> slots;
+        std::vector<ThreadStats*> freeSlots; // Slots of finished threads, reused by new ones
+
+        ThreadStats* acquire();
+        void release(ThreadStats* slot);
+    };
+
+    std::shared_ptr<Registry> registry;
+
+    friend struct ThreadStatsCache;
+};
@@ -0,0 +1,82 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "labels_map.h"
+#include "log.h"
+
+void LabelsMap::build(SRMatrix& labels) {
+    Log(CERR) << "Building labels map ...\n";
+
+    std::vector<bool> seen(labels.cols(), false);
+    for (int r = 0; r < labels.rows(); ++r)
+        for (auto& l : labels[r]) seen[l.index] = true;
+
+    originalLabels.clear();
+    for (int i = 0; i < seen.size(); ++i)
+        if (seen[i]) originalLabels.push_back(i);
+
+    Log(CERR) << "  Labels: " << originalLabels.size() << ", original labels space: " << originalSize() << "\n";
+}
+
+void LabelsMap::relabel(SRMatrix& labels) const {
+    // Mapping is monotonic, so rows stay sorted
+    SRMatrix dense;
+    std::vector<IRVPair> rLabels;
+    for (int r = 0; r < labels.rows(); ++r) {
+        rLabels.clear();
+        for (auto& l : labels[r]) {
+            int label = toDense(l.index);
+            if (label >= 0) rLabels.emplace_back(label, l.value);
+        }
+        dense.appendRow(rLabels);
+    }
+    labels = std::move(dense);
+}
+
+void LabelsMap::restore(std::vector<Prediction>& prediction) const {
+    for (auto& p : prediction) p.label = originalLabels[p.label];
+}
+
+void LabelsMap::restore(std::vector<std::vector<Prediction>>& predictions) const {
+    for (auto& p : predictions) restore(p);
+}
+
+int LabelsMap::toDense(int label) const {
+    auto l = std::lower_bound(originalLabels.begin(), originalLabels.end(), label);
+    if (l == originalLabels.end() || *l != label) return -1;
+    return l - originalLabels.begin();
+}
+
+void LabelsMap::save(std::ofstream& out) {
+    int size = originalLabels.size();
+    saveVar(out, size);
+    out.write((char*)originalLabels.data(), size * sizeof(int));
+}
+
+void LabelsMap::load(std::ifstream& in) {
+    int size;
+    loadVar(in, size);
+    originalLabels.resize(size);
+    in.read((char*)originalLabels.data(), size * sizeof(int));
+}
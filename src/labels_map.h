@@ -0,0 +1,62 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "basic_types.h"
+#include "matrix.h"
+#include "save_load.h"
+
+// Maps sparse label ids to dense ids 0..k-1, in the order of original ids, so the models are trained
+// on small label space. Dense ids are mapped back to original ones with a flat array,
+// original ids are mapped to dense ones with a binary search.
+class LabelsMap : public FileHelper {
+public:
+    void build(SRMatrix& labels);
+
+    // Replaces original ids with dense ones, labels not seen at training are dropped
+    void relabel(SRMatrix& labels) const;
+
+    // Replaces dense ids in predictions with original ones
+    void restore(std::vector<Prediction>& prediction) const;
+    void restore(std::vector<std::vector<Prediction>>& predictions) const;
+    inline void restore(int* labels, int size) const {
+        for (int i = 0; i < size; ++i)
+            if (labels[i] >= 0) labels[i] = originalLabels[labels[i]];
+    }
+
+    int toDense(int label) const;
+    inline int toOriginal(int label) const { return originalLabels[label]; }
+
+    inline bool empty() const { return originalLabels.empty(); }
+    inline int size() const { return originalLabels.size(); }
+    inline int originalSize() const { return originalLabels.empty() ? 0 : originalLabels.back() + 1; }
+
+    void save(std::ofstream& out) override;
+    void load(std::ifstream& in) override;
+
+private:
+    std::vector<int> originalLabels; // Dense to original id, sorted
+};
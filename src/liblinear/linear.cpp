@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <random>
 int liblinear_version = LIBLINEAR_VERSION;
 typedef signed char schar;
 template <class T> static inline void swap(T& x, T& y) { T t=x; x=y; y=t; }
@@ -32,6 +33,15 @@ static void print_null(const char *s) {}
 
 static void (*liblinear_print_string) (const char *) = &print_string_stdout;
 
+// Random number generator of the training thread, seeded before training each problem,
+// so the result does not depend on problems trained before or in other threads
+static thread_local std::minstd_rand liblinear_rng;
+
+static int liblinear_rand()
+{
+	return static_cast<int>(liblinear_rng());
+}
+
 #if 0
 static void info(const char *fmt,...)
 {
@@ -628,7 +638,7 @@ void Solver_MCSVM_CS::Solve(float *w)
 		float stopping = -INF;
 		for(i=0;i<active_size;i++)
 		{
-			int j = i+rand()%(active_size-i);
+			int j = i+liblinear_rand()%(active_size-i);
 			swap(index[i], index[j]);
 		}
 		for(s=0;s<active_size;s++)
@@ -896,7 +906,7 @@ static void solve_l2r_l1l2_svc(
 
 		for (i=0; i<active_size; i++)
 		{
-			int j = i+rand()%(active_size-i);
+			int j = i+liblinear_rand()%(active_size-i);
 			swap(index[i], index[j]);
 		}
 
@@ -1097,7 +1107,7 @@ static void solve_l2r_l1l2_svr(
 
 		for(i=0; i<active_size; i++)
 		{
-			int j = i+rand()%(active_size-i);
+			int j = i+liblinear_rand()%(active_size-i);
 			swap(index[i], index[j]);
 		}
 
@@ -1302,7 +1312,7 @@ void solve_l2r_lr_dual(const problem *prob, float *w, float eps, float Cp, float
 	{
 		for (i=0; i<l; i++)
 		{
-			int j = i+rand()%(l-i);
+			int j = i+liblinear_rand()%(l-i);
 			swap(index[i], index[j]);
 		}
 		int newton_iter = 0;
@@ -1479,7 +1489,7 @@ static void solve_l1r_l2_svc(
 
 		for(j=0; j<active_size; j++)
 		{
-			int i = j+rand()%(active_size-j);
+			int i = j+liblinear_rand()%(active_size-j);
 			swap(index[i], index[j]);
 		}
 
@@ -1852,7 +1862,7 @@ static void solve_l1r_lr(
 
 			for(j=0; j<QP_active_size; j++)
 			{
-				int i = j+rand()%(QP_active_size-j);
+				int i = j+liblinear_rand()%(QP_active_size-j);
 				swap(index[i], index[j]);
 			}
 
@@ -2694,7 +2704,7 @@ void cross_validation(const problem *prob, const parameter *param, int nr_fold,
 	for(i=0;i<l;i++) perm[i]=i;
 	for(i=0;i<l;i++)
 	{
-		int j = i+rand()%(l-i);
+		int j = i+liblinear_rand()%(l-i);
 		swap(perm[i],perm[j]);
 	}
 	for(i=0;i<=nr_fold;i++)
@@ -2761,7 +2771,7 @@ void find_parameters(const problem *prob, const parameter *param, int nr_fold, f
 	for(i=0;i<l;i++) perm[i]=i;
 	for(i=0;i<l;i++)
 	{
-		int j = i+rand()%(l-i);
+		int j = i+liblinear_rand()%(l-i);
 		swap(perm[i],perm[j]);
 	}
 	for(i=0;i<=nr_fold;i++)
@@ -3289,3 +3299,8 @@ void set_print_string_function(void (*print_func)(const char*))
 		liblinear_print_string = print_func;
 }
 
+void set_rand_seed(unsigned int seed)
+{
+	liblinear_rng.seed(seed);
+}
+
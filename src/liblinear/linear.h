@@ -76,6 +76,7 @@ const char *check_parameter(const struct problem *prob, const struct parameter *
 int check_probability_model(const struct model *model);
 int check_regression_model(const struct model *model);
 void set_print_string_function(void (*print_func) (const char*));
+void set_rand_seed(unsigned int seed);
 
 #ifdef __cplusplus
 }
@@ -26,18 +26,29 @@
  Only this file should use std:cout.
  */
 
+#include <filesystem>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 
 #include "args.h"
 #include "basic_types.h"
+#include "inference_stats.h"
+#include "labels_map.h"
 #include "log.h"
 #include "measure.h"
 #include "misc.h"
 #include "model.h"
+#include "prediction_stream.h"
+#include "prediction_writer.h"
 #include "read_data.h"
 #include "resources.h"
+#include "sharded_plt.h"
+#include "synthetic_data.h"
+#include "threads.h"
 #include "version.h"
+#include "weights_file.h"
 
 std::vector<Real> loadVec(std::string infile){
     std::vector<Real> vec;
@@ -66,11 +77,29 @@ void loadVecs(std::shared_ptr<Model> model, Args& args){
     }
 }
 
-void outputPrediction(std::vector<std::vector<Prediction>>& predictions, std::ofstream& output){
-    for (const auto &p : predictions) {
-        for (const auto &l : p) output << l.label << ":" << l.value << " ";
-        output << "\n";
+// Prints differences of performance counters between two points, if they are available
+void printPerfCounters(std::string title, Resources& start, Resources& stop, int rows, unsigned long long nodeEvaluations = 0){
+    double diffs[perfCountersCount];
+    bool any = false;
+    for (int i = 0; i < perfCountersCount; ++i) {
+        diffs[i] = (start.perfCounters[i] < 0 || stop.perfCounters[i] < 0) ? -1 : stop.perfCounters[i] - start.perfCounters[i];
+        any |= diffs[i] >= 0;
     }
+    if (!any) return;
+
+    Log(COUT) << title << ":";
+    for (int i = 0; i < perfCountersCount; ++i) {
+        if (diffs[i] < 0) continue;
+        Log(COUT) << "\n  " << perfCounterName(i) << ": " << diffs[i];
+        if (rows > 0) Log(COUT) << "\n  " << perfCounterName(i) << " / data point: " << diffs[i] / rows;
+    }
+    if (diffs[perfInstructions] >= 0 && diffs[perfCycles] > 0)
+        Log(COUT) << "\n  IPC: " << diffs[perfInstructions] / diffs[perfCycles];
+    if (nodeEvaluations > 0) {
+        for (int i : {perfLLCMisses, perfDTLBMisses, perfBranchMisses})
+            if (diffs[i] >= 0) Log(COUT) << "\n  " << perfCounterName(i) << " / evaluated node: " << diffs[i] / nodeEvaluations;
+    }
+    Log(COUT) << "\n";
 }
 
 void train(Args& args) {
@@ -91,6 +120,14 @@ void train(Args& args) {
               << "\n  Labels / data point: " << static_cast<double>(labels.cells()) / labels.rows()
               << "\n  Features / data point: " << static_cast<double>(features.cells()) / features.rows() << "\n";
 
+    // Map labels to dense ids, so the model is trained on the labels space without gaps
+    if (args.relabel) {
+        LabelsMap labelsMap;
+        labelsMap.build(labels);
+        labelsMap.relabel(labels);
+        labelsMap.saveToFile(joinPath(args.output, "labels_map.bin"));
+    }
+
     auto resAfterData = getResources();
 
     // Create and train model (train function also saves model)
@@ -113,23 +150,82 @@ void train(Args& args) {
               << "\n  Train CPU time / data point (ms): " << cpuTime * 1000 / labels.rows()
               << "\n  Train peak of real memory (MB): " << resAfterTraining.peakRealMem / 1024
               << "\n  Train peak of virtual memory (MB): " << resAfterTraining.peakVirtualMem / 1024 << "\n";
+
+    printPerfCounters("Train performance counters", resAfterData, resAfterTraining, labels.rows());
 }
 
-void test(Args& args) {
+void printMeasures(std::vector<std::shared_ptr<Measure>>& measures){
+    if(measures.empty()) return;
+
+    Log(COUT) << std::setprecision(5) << "Results:\n";
+    for (auto& m : measures){
+        Log(COUT) << "  " << m->getName() << ": " << m->value();
+        //if(m->isMeanMeasure()) Log(COUT) << " ± " << m->stdDev(); // Print std
+        Log(COUT) << "\n";
+    }
+}
+
+void printTestResources(int rows, Resources& resAfterData, Resources& resAfterModel, Resources& resAfterPrediction){
+    auto realTime = static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                            resAfterPrediction.timePoint - resAfterModel.timePoint)
+                                            .count()) / 1000;
+    auto cpuTime = resAfterPrediction.cpuTime - resAfterModel.cpuTime;
+    Log(COUT) << "Test resources:"
+              << "\n  Test real time (s): " << realTime
+              << "\n  Test CPU time (s): " << cpuTime
+              << "\n  Test real time / data point (ms): " << realTime * 1000 / rows
+              << "\n  Test CPU time / data point (ms): " << cpuTime * 1000 / rows
+              << "\n  Model real memory size (MB): "
+              << (resAfterModel.currentRealMem - resAfterData.currentRealMem) / 1024
+              << "\n  Model virtual memory size (MB): "
+              << (resAfterModel.currentVirtualMem - resAfterData.currentVirtualMem) / 1024
+              << "\n  Test peak of real memory (MB): " << resAfterPrediction.peakRealMem / 1024
+              << "\n  Test peak of virtual memory (MB): " << resAfterPrediction.peakVirtualMem / 1024 << "\n";
+}
+
+// Reads, predicts, evaluates and writes predictions chunk by chunk. Evaluation of the previous chunk,
+// writing of predictions in the writer thread and reading of the next chunk overlap with prediction for the current one.
+// Each chunk is evaluated with its own set of measures that is merged into the given ones,
+// so the whole predictions are never kept in memory.
+void predictInChunks(PredictionStream& stream, Args& args, std::vector<std::shared_ptr<Measure>>& measures,
+                     int outputSize, bool print = false){
+    std::unique_ptr<PredictionWriter> writer;
+    if (!args.prediction.empty() || print) writer = std::make_unique<PredictionWriter>(args, print);
+
+    struct Chunk {
+        SRMatrix labels;
+        std::vector<std::vector<Prediction>> predictions;
+    };
+
+    std::future<void> evaluating;
     SRMatrix labels;
-    SRMatrix features;
+    std::vector<std::vector<Prediction>> predictions;
+    while (stream.next(predictions, labels)) {
+        if (!measures.empty()) {
+            if (evaluating.valid()) evaluating.get();
+            auto chunk = std::make_shared<Chunk>();
+            chunk->labels = std::move(labels);
+            chunk->predictions = predictions;
+            labels = SRMatrix();
+            evaluating = std::async(std::launch::async, [&args, &measures, outputSize, chunk]() {
+                auto chunkMeasures = Measure::factory(args, outputSize);
+                for (auto& m : chunkMeasures) m->accumulate(chunk->labels, chunk->predictions);
+                Measure::merge(measures, chunkMeasures);
+            });
+        }
 
+        if (writer != nullptr) writer->write(std::move(predictions));
+        predictions.clear();
+    }
+    if (evaluating.valid()) evaluating.get();
+    if (writer != nullptr) writer->close();
+}
+
+void test(Args& args) {
     // Load model args
     args.loadFromFile(joinPath(args.output, "args.bin"));
     args.printArgs("test");
 
-    // Load test data
-    readData(labels, features, args);
-    Log(COUT) << "Test data statistics:"
-              << "\n  Test data points: " << features.rows()
-              << "\n  Labels / data point: " << static_cast<double>(labels.cells()) / labels.rows()
-              << "\n  Features / data point: " << static_cast<double>(features.cells()) / features.rows() << "\n";
-
     auto resAfterData = getResources();
 
     // Load model and test
@@ -138,51 +234,35 @@ void test(Args& args) {
 
     auto resAfterModel = getResources();
 
-    // Predict for test set
+    // Read, predict for and evaluate test set in chunks, without loading the whole data set into memory
     loadVecs(model, args);
-    std::vector<std::vector<Prediction>> predictions = model->predictBatch(features, args);
+    PredictionStream stream(model, args);
 
-    auto resAfterPrediction = getResources();
+    // Create measures
+    std::vector<std::shared_ptr<Measure>> measures;
+    if(!args.measures.empty()) measures = Measure::factory(args, stream.outputSize());
 
-    // Output predictions
-    if(!args.prediction.empty()){
-        std::ofstream out(args.prediction);
-        outputPrediction(predictions, out);
-        out.close();
-    }
+    predictInChunks(stream, args, measures, stream.outputSize());
+    int rows = stream.rowsCount();
+    Log(COUT) << "Test data statistics:"
+              << "\n  Test data points: " << rows
+              << "\n  Labels / data point: " << static_cast<double>(stream.labelsCells()) / rows
+              << "\n  Features / data point: " << static_cast<double>(stream.featuresCells()) / rows << "\n";
 
-    // Create measures, calculate and print scores
-    if(!args.measures.empty()){
-        auto measures = Measure::factory(args, model->outputSize());
-        for (auto& m : measures) m->accumulate(labels, predictions);
+    auto resAfterPrediction = getResources();
 
-        Log(COUT) << std::setprecision(5) << "Results:\n";
-        for (auto& m : measures){
-            Log(COUT) << "  " << m->getName() << ": " << m->value();
-            //if(m->isMeanMeasure()) Log(COUT) << " ± " << m->stdDev(); // Print std
-            Log(COUT) << "\n";
-        }
-    }
+    // Print scores
+    printMeasures(measures);
 
     // Print additional model statistics
     model->printInfo();
+    model->printCacheInfo();
+    if (!args.statsOutput.empty()) model->getStats().saveToJson(args.statsOutput);
 
     // Print resources
-    auto realTime = static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(
-                                            resAfterPrediction.timePoint - resAfterModel.timePoint)
-                                            .count()) / 1000;
-    auto cpuTime = resAfterPrediction.cpuTime - resAfterModel.cpuTime;
-    Log(COUT) << "Test resources:"
-              << "\n  Test real time (s): " << realTime
-              << "\n  Test CPU time (s): " << cpuTime
-              << "\n  Test real time / data point (ms): " << realTime * 1000 / labels.rows()
-              << "\n  Test CPU time / data point (ms): " << cpuTime * 1000 / labels.rows()
-              << "\n  Model real memory size (MB): "
-              << (resAfterModel.currentRealMem - resAfterData.currentRealMem) / 1024
-              << "\n  Model virtual memory size (MB): "
-              << (resAfterModel.currentVirtualMem - resAfterData.currentVirtualMem) / 1024
-              << "\n  Test peak of real memory (MB): " << resAfterPrediction.peakRealMem / 1024
-              << "\n  Test peak of virtual memory (MB): " << resAfterPrediction.peakVirtualMem / 1024 << "\n";
+    printTestResources(rows, resAfterData, resAfterModel, resAfterPrediction);
+    printPerfCounters("Model loading performance counters", resAfterData, resAfterModel, 0);
+    printPerfCounters("Test performance counters", resAfterModel, resAfterPrediction, rows, model->getStats().nodeEvaluations);
 }
 
 void predict(Args& args) {
@@ -193,26 +273,12 @@ void predict(Args& args) {
     // Load model
     std::shared_ptr<Model> model = Model::factory(args);
     model->load(args, args.output);
-
-    SRMatrix labels;
-    SRMatrix features;
-    readData(labels, features, args);
-
     loadVecs(model, args);
-    std::vector<std::vector<Prediction>> predictions = model->predictBatch(features, args);
-
-    // Output predictions
-    if(!args.prediction.empty()){
-        std::ofstream out(args.prediction);
-        outputPrediction(predictions, out);
-        out.close();
-    }
 
-    Log(COUT) << std::setprecision(5);
-    for (const auto &p : predictions) {
-        for (const auto &l : p) Log(COUT) << l.label << ":" << l.value << " ";
-        Log(COUT) << "\n";
-    }
+    // Predict in chunks, print predictions and write them to the prediction file if given
+    std::vector<std::shared_ptr<Measure>> measures;
+    PredictionStream stream(model, args);
+    predictInChunks(stream, args, measures, stream.outputSize(), true);
 }
 
 void ofo(Args& args) {
@@ -228,6 +294,13 @@ void ofo(Args& args) {
     SRMatrix features;
     readData(labels, features, args);
 
+    // Thresholds are optimized for dense label ids of the model
+    if (args.relabel) {
+        LabelsMap labelsMap;
+        labelsMap.loadFromFile(joinPath(args.output, "labels_map.bin"));
+        labelsMap.relabel(labels);
+    }
+
     auto resAfterData = getResources();
 
     std::vector<Real> thresholds = model->ofo(features, labels, args);
@@ -246,12 +319,79 @@ void ofo(Args& args) {
               << "\n  Optimization CPU time (s): " << cpuTime << "\n";
 }
 
+// Client of the load test, sends batches of random rows one after another (closed loop)
+// or at given average rate with exponentially distributed intervals (open loop).
+// Latency is measured from the scheduled arrival of the batch, so it includes time spent waiting for the client.
+void loadTestClient(int clientId, Model* model, SRMatrix& features, Args& args, int batchSize, int batches,
+                    std::chrono::steady_clock::time_point start, LatencyHistogram& latency,
+                    std::chrono::steady_clock::time_point& stop) {
+    std::default_random_engine rng(args.seed + clientId);
+    std::uniform_int_distribution<int> rowDist(0, features.rows() - 1);
+    std::vector<Prediction> prediction;
+
+    // Intervals between batches are only drawn in the open loop mode, the distribution requires a positive rate
+    std::unique_ptr<std::exponential_distribution<double>> intervalDist;
+    if (args.requestRate > 0) intervalDist = std::make_unique<std::exponential_distribution<double>>(args.requestRate / args.clients);
+
+    auto arrival = start;
+    for (int i = 0; i < args.warmup + batches; ++i) {
+        if (intervalDist) {
+            arrival += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>((*intervalDist)(rng)));
+            std::this_thread::sleep_until(arrival);
+        } else arrival = std::chrono::steady_clock::now();
+
+        for (int j = 0; j < batchSize; ++j) {
+            prediction.clear();
+            model->predict(prediction, features[rowDist(rng)], args);
+        }
+
+        auto done = std::chrono::steady_clock::now();
+        if (i >= args.warmup)
+            latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(done - arrival).count());
+        stop = done;
+    }
+}
+
+void loadTest(std::shared_ptr<Model> model, SRMatrix& features, Args& args, std::vector<int>& batchSizes) {
+    Log(COUT) << "Results:";
+    for (const auto& batchSize : batchSizes) {
+        std::vector<LatencyHistogram> latencies(args.clients);
+        std::vector<std::chrono::steady_clock::time_point> stops(args.clients);
+
+        auto start = std::chrono::steady_clock::now();
+        ThreadSet tSet;
+        for (int c = 0; c < args.clients; ++c)
+            tSet.add(loadTestClient, c, model.get(), std::ref(features), std::ref(args), batchSize, args.batches,
+                     start, std::ref(latencies[c]), std::ref(stops[c]));
+        tSet.joinAll();
+
+        LatencyHistogram latency;
+        for (auto& l : latencies) latency.merge(l);
+        auto stop = *std::max_element(stops.begin(), stops.end());
+
+        // Throughput includes warmup batches, since they are sent concurrently with measured ones
+        double realTime = std::chrono::duration<double>(stop - start).count();
+        double batches = static_cast<double>(args.clients) * (args.warmup + args.batches);
+        auto ms = [](double ns) { return ns / 1e6; };
+
+        Log(COUT) << "\n  Batch " << batchSize << " latency mean (ms): " << ms(latency.mean())
+                  << "\n  Batch " << batchSize << " latency p50 / p90 / p99 / p99.9 (ms): " << ms(latency.percentile(50))
+                  << " / " << ms(latency.percentile(90)) << " / " << ms(latency.percentile(99))
+                  << " / " << ms(latency.percentile(99.9))
+                  << "\n  Batch " << batchSize << " latency max (ms): " << ms(latency.max())
+                  << "\n  Batch " << batchSize << " throughput (batches / s): " << batches / realTime
+                  << "\n  Batch " << batchSize << " throughput (data points / s): " << batches * batchSize / realTime;
+    }
+    Log(COUT) << "\n";
+}
+
 void testPredictionTime(Args& args) {
     // Method for testing performance on different batch (test dataset) sizes
 
     // Load model args
     args.loadFromFile(joinPath(args.output, "args.bin"));
-    args.printArgs();
+    args.printArgs("testPredictionTime");
 
     // Load model
     std::shared_ptr<Model> model = Model::factory(args);
@@ -266,6 +406,12 @@ void testPredictionTime(Args& args) {
     for(const auto& s : split(args.batchSizes))
         batchSizes.push_back(std::stoi(s));
 
+    // Measure wall-clock latency of batches sent by concurrent clients
+    if (args.clients > 0) {
+        loadTest(model, features, args, batchSizes);
+        return;
+    }
+
     // Prepare rng for selecting batches
     std::default_random_engine rng(args.seed);
     std::uniform_int_distribution<int> dist(0, features.rows() - 1);
@@ -315,6 +461,43 @@ void testPredictionTime(Args& args) {
     Log(COUT) << "\n";
 }
 
+void shard(Args& args) {
+    // Load model args
+    args.loadFromFile(joinPath(args.output, "args.bin"));
+    args.printArgs("shard");
+
+    ShardedPLT::createShards(args, args.output);
+}
+
+void generate(Args& args) {
+    args.printArgs("generate");
+
+    SyntheticDataGenerator generator(args);
+    generator.save(args.output);
+}
+
+void convert(Args& args) {
+    // Load model args
+    args.loadFromFile(joinPath(args.output, "args.bin"));
+    args.printArgs("convert");
+    if (args.modelType == extremeText) throw std::invalid_argument("Weights of extremeText model cannot be converted");
+
+    std::vector<std::string> files = findWeightsFiles(args.output);
+
+    unsigned long long sizeBefore = 0;
+    unsigned long long sizeAfter = 0;
+    for (auto& file : files) {
+        Log(CERR) << "Converting " << file << " ...\n";
+        sizeBefore += std::filesystem::file_size(file);
+        convertWeights(file, file, args.weightsFormat, args.weightsPrecision);
+        sizeAfter += std::filesystem::file_size(file);
+    }
+
+    Log(COUT) << "Converted weights files: " << files.size()
+              << "\n  Size before: " << formatMem(sizeBefore)
+              << "\n  Size after: " << formatMem(sizeAfter) << "\n";
+}
+
 void printHelp() {
     std::cout << R"HELP(Usage: nxc [command] [arg...]
 
@@ -323,6 +506,10 @@ Commands:
     test                    Test model on given input data
     predict                 Predict for given data
     ofo                     Use online f-measure optimization
+    shard                   Split trained PLT model into shards
+    testPredictionTime      Measure prediction time for batches of different sizes
+    generate                Generate synthetic dataset to the output file
+    convert                 Convert weights of the model to a different format
     version                 Print napkinXC version
     help                    Print help
 
@@ -332,17 +519,34 @@ Args:
     -o, --output            Output (model) dir, required
     -m, --model             Model type (default = plt)
                             Models: plt, hsm, br, ovr, oplt
-    -p, --prediction
+    -p, --prediction        Output file for predictions
+    --predictionFormat      Format of the prediction file (default = text)
+                            Formats: text ("label:value" pairs, one line per data point),
+                                     binary (header: "NXCP", uint32 version, uint32 k, uint64 rows,
+                                             then k int32 labels and k float32 values per row,
+                                             padded with -1 and 0, requires --topK > 0)
     --ensemble              Number of models in ensemble (default = 1)
     -t, --threads           Number of threads to use (default = 0)
                             Note: set to -1 to use a number of available CPUs - 1, 0 to use a number of available CPUs
     --memLimit              Maximum amount of memory (in G) available for training (default = 0)
                             Note: set to 0 to set limit to amount of available memory
+    --checkpoint            Save trained base estimators in segments of given size, so interrupted training
+                            of batch models can be resumed with --resume 1 on the same data and with the same
+                            arguments, including --seed (default = 0)
+                            Note: set to 0 to disable
     --hash                  Size of features space (default = 0)
                             Note: set to 0 to disable hashing
+    --hashSign              Multiply hashed features by a sign given by a second hash, so collisions cancel out
+                            in expectation instead of adding up (default = 0)
     --featuresThreshold     Prune features below given threshold (default = 0.0)
+    --relabel               Map labels to dense ids before training and back to original ids in predictions,
+                            use it for labels with sparse ids (default = 0)
+                            Note: thresholds and labels weights of such models are indexed by dense ids
     --seed                  Seed (default = system time)
     --verbose               Verbose level (default = 2)
+    --perfCounters          Report hardware performance counters (instructions, cycles, LLC, dTLB
+                            and branch misses) for train and test commands (default = 0)
+                            Note: requires perf events, that may be unavailable in containers
 
     OVR and HSM:
     --pickOneLabelWeighting Allows to use multi-label data by transforming it into multi-class (default = 0)
@@ -377,22 +581,91 @@ Args:
     --treeType              Type of a tree to build if file with structure is not provided
                             tree types: hierarchicalKmeans, huffman, completeKaryInOrder, completeKaryRandom,
                                         balancedInOrder, balancedRandom, onlineComplete
+    --negSamplingRatio      Subsample negative examples of each node to at most given number of negatives
+                            per positive example, kept negatives are reweighted (default = 0)
+                            Note: set to 0 to disable
+    --negSamplingMax        Subsample negative examples of each node to at most given number,
+                            kept negatives are reweighted (default = 0)
+                            Note: set to 0 to disable
 
     K-Means tree:
     --kmeansEps             Tolerance of termination criterion of the k-means clustering
                             used in hierarchical k-means tree building procedure (default = 0.001)
     --kmeansBalanced        Use balanced K-Means clustering (default = 1)
 
+    Sharding (PLT):
+    --shards                Number of shards to split the model into with shard command,
+                            and to load for test and predict (default = 0)
+                            Note: set to 0 to use not sharded model, sharded model supports only exact tree search
+    --shardLevel            Tree level at which subtrees are assigned to shards, nodes above it
+                            are evaluated by the coordinator (default = 1)
+
     Prediction:
     --topK                  Predict top-k labels (default = 5)
     --threshold             Predict labels with probability above the threshold (default = 0)
     --thresholds            Path to a file with threshold for each label, one threshold per line
     --labelsWeights         Path to a file with weight for each label, one weight per line
+    --predictionCache       Size of LRU cache of predictions for repeated feature vectors (default = 0)
+                            Note: set to 0 to disable
+    --nodeCache             Size of LRU cache of values of PLT nodes of top levels of the tree (default = 0)
+                            Note: set to 0 to disable
+    --nodeCacheDepth        Number of top levels of the tree cached by node cache (default = 2)
+    --lazyLoading           Load base estimators of PLT on their first use instead of loading all of them
+                            at start, not used with --resume (default = 0)
+    --basesCacheMem         Maximum amount of memory (in G) for base estimators loaded on first use,
+                            the least recently used ones are evicted above it (default = 1)
+    --pinLevels             Number of top levels of the tree loaded at start and never evicted
+                            with lazy loading (default = 2)
+    --siblingBlocks         Pack weights of all children of a PLT node into one block, so they are
+                            evaluated with one pass over the features, not used with --lazyLoading (default = 0)
+    --siblingBlocksMinFill  Minimal fraction of non-zero weights in a block, children of nodes
+                            with sparser blocks keep separate weights (default = 0.25)
+    --chunkSize             Number of rows read, predicted and evaluated at once by test
+                            and predict commands (default = 10000)
 
     Test:
     --measures              Evaluate test using set of measures (default = "p@1,p@3,p@5")
                             Measures: acc (accuracy), p (precision), r (recall), c (coverage), hl (hamming loos)
                                       p@k (precision at k), r@k (recall at k), c@k (coverage at k), s (prediction size)
+    --statsOutput           Save inference statistics (evaluated estimators per tree depth,
+                            latency histogram) to the given JSON file
+    --nodeStats             Count evaluations of each tree node in the statistics (default = 0)
+
+    OFO:
+    --ofoType               Type of optimized F-measure (default = micro)
+                            Types: micro, macro, mixed (macro for --ofoTopLabels most frequent labels, micro for others)
+    --ofoTopLabels          Number of labels with macro thresholds for mixed type (default = 1000)
+    --ofoA, --ofoB          Initial values of F-measure numerator and denominator counters (default = 10, 20)
+    --ofoBatchSize          Number of data points predicted in parallel with the same thresholds,
+                            before counters and thresholds are updated (default = 1000)
+
+    Test prediction time:
+    --batchSizes            Comma-separated sizes of batches of random data points (default = "100,1000,10000")
+    --batches               Number of batches of each size, per client in load test (default = 10)
+    --clients               Number of concurrent clients sending batches, if set, wall-clock latency
+                            percentiles and throughput are reported instead of CPU time (default = 0)
+    --warmup                Number of not measured batches sent first by each client (default = 10)
+    --requestRate           Average total number of batches per second sent at exponentially distributed intervals
+                            (open loop), independently of finished batches (default = 0)
+                            Note: set to 0 to send next batch right after the previous one is finished (closed loop)
+
+    Generate:
+    --rows                  Number of rows to generate (default = 10000)
+    --features              Number of features (default = 100000)
+    --labels                Number of labels (default = 10000)
+    --labelsPerRow          Average number of labels per row (default = 5)
+    --featuresPerRow        Average number of features per row (default = 50)
+    --labelsPower           Exponent of power-law distribution of labels frequencies (default = 1.0)
+    --featuresPower         Exponent of power-law distribution of features frequencies (default = 1.0)
+    --cooccurrence          Probability of sampling next label of a row from the cluster
+                            of its first label (default = 0.5)
+
+    Convert:
+    --weightsFormat         Format of weights files (default = compact)
+                            Formats: legacy, compact (delta and varint coded indices, per base blocks)
+                            Note: compact format does not store gradients saved with --saveGrads
+    --weightsPrecision      Precision of weights in compact format (default = fp32)
+                            Precisions: fp32, fp16, bf16
     )HELP";
 }
 
@@ -418,6 +691,10 @@ int main(int argc, char** argv) {
         exit(EXIT_FAILURE);
     }
 
+    // Counters have to be opened before any threads are started to count them
+    if (args.perfCounters && enablePerfCounters() == 0)
+        Log(CERR) << "Warning: Performance counters are not available: " << perfCountersError() << "\n";
+
     if (command == "-h" || command == "--help" || command == "help")
         printHelp();
     else if (command == "-v" || command == "--version" || command == "version")
@@ -430,6 +707,12 @@ int main(int argc, char** argv) {
         predict(args);
     else if (command == "ofo")
         ofo(args);
+    else if (command == "shard")
+        shard(args);
+    else if (command == "generate")
+        generate(args);
+    else if (command == "convert")
+        convert(args);
     else if (command == "testPredictionTime")
         testPredictionTime(args);
     else {
@@ -99,6 +99,17 @@ void Measure::accumulate(SRMatrix& labels, std::vector<std::vector<Prediction>>&
 
 double Measure::value() { return sum / count; }
 
+void Measure::merge(const Measure& other) {
+    sum += other.sum;
+    sumSq += other.sumSq;
+    count += other.count;
+}
+
+void Measure::merge(std::vector<std::shared_ptr<Measure>>& measures, const std::vector<std::shared_ptr<Measure>>& other) {
+    assert(measures.size() == other.size());
+    for (int i = 0; i < measures.size(); ++i) measures[i]->merge(*other[i]);
+}
+
 double Measure::stdDev() {
     double m = mean();
     return sumSq / count - m * m;
@@ -301,6 +312,11 @@ void Coverage::accumulate(SparseVector& labels, const std::vector<Prediction>& p
 
 double Coverage::value() { return static_cast<double>(seen.size()) / m; }
 
+void Coverage::merge(const Measure& other) {
+    auto& o = dynamic_cast<const Coverage&>(other);
+    seen.insert(o.seen.begin(), o.seen.end());
+}
+
 CoverageAtK::CoverageAtK(int outputSize, int k) : MeasureAtK(k), m(outputSize) {
     name = "C@" + std::to_string(k);
     meanMeasure = false;
@@ -318,6 +334,11 @@ void CoverageAtK::accumulate(SparseVector& labels, const std::vector<Prediction>
 
 double CoverageAtK::value() { return static_cast<double>(seen.size()) / m; }
 
+void CoverageAtK::merge(const Measure& other) {
+    auto& o = dynamic_cast<const CoverageAtK&>(other);
+    seen.insert(o.seen.begin(), o.seen.end());
+}
+
 Accuracy::Accuracy() {
     name = "Acc";
     meanMeasure = true;
@@ -414,3 +435,12 @@ double MacroF1::value(){
     }
     return sum / m;
 }
+
+void MacroF1::merge(const Measure& other) {
+    auto& o = dynamic_cast<const MacroF1&>(other);
+    for (int i = 0; i < m; ++i) {
+        labelsTP[i] += o.labelsTP[i];
+        labelsFP[i] += o.labelsFP[i];
+        labelsFN[i] += o.labelsFN[i];
+    }
+}
@@ -38,6 +38,10 @@ public:
     void accumulate(SRMatrix& labels, std::vector<std::vector<Prediction>>& predictions);
     virtual double value();
 
+    // Merges state of the same measure accumulated on another part of data (e.g. in another thread)
+    virtual void merge(const Measure& other);
+    static void merge(std::vector<std::shared_ptr<Measure>>& measures, const std::vector<std::shared_ptr<Measure>>& other);
+
     inline bool isMeanMeasure(){ return meanMeasure; };
     inline double mean(){ return value(); };
     double stdDev();
@@ -143,6 +147,7 @@ public:
 
     void accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) override;
     double value() override;
+    void merge(const Measure& other) override;
 
 protected:
     UnorderedSet<int> seen;
@@ -155,6 +160,7 @@ public:
 
     void accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) override;
     double value() override;
+    void merge(const Measure& other) override;
 
 protected:
     UnorderedSet<int> seen;
@@ -202,6 +208,7 @@ public:
 
     void accumulate(SparseVector& labels, const std::vector<Prediction>& prediction) override;
     double value() override;
+    void merge(const Measure& other) override;
 
 protected:
     std::vector<double> labelsTP;
@@ -22,6 +22,7 @@
 
 
 #include <array>
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -189,3 +190,31 @@ void checkDirName(const std::string& dirname) {
 void makeDir(const std::string& dirname) {
     if(!std::filesystem::exists(dirname)) std::filesystem::create_directories(dirname);
 }
+
+// Remove file or directory
+void remove(const std::string& path) {
+    if(std::filesystem::exists(path)) std::filesystem::remove_all(path);
+}
+
+static std::atomic<bool> processInterrupted(false);
+static thread_local std::atomic<bool>* interrupted = &processInterrupted;
+
+void setInterrupted(bool value) {
+    *interrupted = value;
+}
+
+bool isInterrupted() {
+    return *interrupted;
+}
+
+void checkInterrupted() {
+    if (*interrupted) throw std::runtime_error("Operation interrupted");
+}
+
+std::atomic<bool>* getInterruptFlag() {
+    return interrupted;
+}
+
+void setInterruptFlag(std::atomic<bool>* flag) {
+    interrupted = flag ? flag : &processInterrupted;
+}
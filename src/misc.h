@@ -23,6 +23,7 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <iostream>
@@ -62,6 +63,16 @@ template <typename T> inline uint32_t hash(T& v) {
     return h;
 }
 
+// Finalizer of MurmurHash3, gives a hash independent of the FNV hash above
+inline uint32_t mixHash(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
 // Prints progress
 inline void printProgress(int state, int max) {
     if (max < 100 || state % (max / 100) == 0)
@@ -94,3 +105,12 @@ void makeDir(const std::string& dirname);
 
 // Remove file or directory
 void remove(const std::string& path);
+
+// Interruption of long running operations (e.g. requested from Python), checked in training and prediction loops.
+// Each thread checks the flag of its operation, threads of ThreadSet and ThreadPool get the flag of the thread that adds them,
+// so operations running at the same time can be interrupted separately.
+void setInterrupted(bool value);
+bool isInterrupted();
+void checkInterrupted(); // Throws if operation was interrupted
+std::atomic<bool>* getInterruptFlag();
+void setInterruptFlag(std::atomic<bool>* flag); // nullptr sets the flag shared by the whole process
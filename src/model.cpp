@@ -20,21 +20,29 @@
  SOFTWARE.
  */
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iomanip>
 #include <mutex>
+#include <random>
+#include <sstream>
 #include <string>
 
+#include "checkpoint.h"
 #include "ensemble.h"
 #include "log.h"
 #include "measure.h"
 #include "model.h"
+#include "resources.h"
 #include "threads.h"
+#include "weights_file.h"
 
 #include "br.h"
 #include "hsm.h"
 #include "ovr.h"
 #include "plt.h"
+#include "sharded_plt.h"
 #include "online_plt.h"
 #include "extreme_text.h"
 #include "version.h"
@@ -49,6 +57,12 @@ std::shared_ptr<Model> Model::factory(Args& args) {
         case plt: model = std::static_pointer_cast<Model>(std::make_shared<Ensemble<BatchPLT>>()); break;
         default: throw std::invalid_argument("Ensemble is not supported for this model type");
         }
+    } else if (args.shards > 0) {
+        switch (args.modelType) {
+        case plt:
+        case oplt: model = std::static_pointer_cast<Model>(std::make_shared<ShardedPLT>()); break;
+        default: throw std::invalid_argument("Sharding is not supported for this model type");
+        }
     } else {
         switch (args.modelType) {
         case ovr: model = std::static_pointer_cast<Model>(std::make_shared<OVR>()); break;
@@ -73,14 +87,15 @@ Model::~Model() {
 void Model::predictBatchThread(int threadId, Model* model, std::vector<std::vector<Prediction>>& predictions,
                                SRMatrix& features, Args& args, const int startRow, const int stopRow) {
     const int batchSize = stopRow - startRow;
-    for (int r = startRow; r < stopRow; ++r) {
+    for (int r = startRow; r < stopRow && !isInterrupted(); ++r) {
         int i = r - startRow;
-        model->predict(predictions[r], features[r], args);
+        model->predictWithCache(predictions[r], features[r], args);
         if (!threadId) printProgress(i, batchSize);
     }
 }
 
 std::vector<std::vector<Prediction>> Model::predictBatch(SRMatrix& features, Args& args) {
+    initCaches(args);
     Log(CERR) << "Starting prediction in " << args.threads << " threads ...\n";
 
     int rows = features.rows();
@@ -93,124 +108,225 @@ std::vector<std::vector<Prediction>> Model::predictBatch(SRMatrix& features, Arg
         tSet.add(predictBatchThread, t, this, std::ref(predictions), std::ref(features), std::ref(args), t * tRows,
                  std::min((t + 1) * tRows, rows));
     tSet.joinAll();
+    checkInterrupted();
 
     return predictions;
 }
 
+uint64_t Model::predictionSalt(Args& args){
+    return (static_cast<uint64_t>(hash(args.threshold)) << 32) | static_cast<uint32_t>(args.topK);
+}
+
+void Model::initCaches(Args& args){
+    if (args.predictionCache > 0 && predictionCache == nullptr)
+        predictionCache = std::make_shared<FeaturesCache<std::vector<Prediction>>>(args.predictionCache);
+}
+
+void Model::predictWithCache(std::vector<Prediction>& prediction, SparseVector& features, Args& args){
+    auto start = std::chrono::steady_clock::now();
+
+    if (predictionCache == nullptr) predict(prediction, features, args);
+    else {
+        uint64_t salt = predictionSalt(args);
+        if (!predictionCache->get(features, salt, prediction)) {
+            predict(prediction, features, args);
+            predictionCache->put(features, salt, prediction);
+        }
+    }
+
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    stats.local().addLatency(time.count());
+}
+
+std::vector<std::pair<std::string, unsigned long long>> Model::getCacheStats(){
+    std::vector<std::pair<std::string, unsigned long long>> stats;
+    if (predictionCache != nullptr) {
+        stats.emplace_back("prediction_cache_hits", predictionCache->hits());
+        stats.emplace_back("prediction_cache_misses", predictionCache->misses());
+    }
+    return stats;
+}
+
+void Model::printCacheInfo(){
+    auto stats = getCacheStats();
+    if (stats.empty()) return;
+
+    Log(COUT) << "Cache stats:";
+    for (auto& s : stats) Log(COUT) << "\n  " << s.first << ": " << s.second;
+    Log(COUT) << "\n";
+}
+
 void Model::setThresholds(std::vector<Real> th){
 //    if(th.size() != m)
 //        throw std::invalid_argument("Size of thresholds vector dose not match number of model outputs");
     thresholds = th;
+    if (predictionCache != nullptr) predictionCache->clear();
 }
 
-void Model::updateThresholds(UnorderedMap<int, Real> thToUpdate){
+void Model::updateThresholds(const UnorderedMap<int, Real>& thToUpdate){
     for(auto& th : thToUpdate)
         thresholds[th.first] = th.second;
+    if (predictionCache != nullptr) predictionCache->clear();
 }
 
 void Model::setLabelsWeights(std::vector<Real> lw){
 //    if(lw.size() != m)
 //        throw std::invalid_argument("Size of labels' weights vector dose not match number of model outputs");
     labelsWeights = lw;
+    if (predictionCache != nullptr) predictionCache->clear();
 }
 
 Real Model::microOfo(SRMatrix& features, SRMatrix& labels, Args& args){
+    if (args.ofoBatchSize < 1) throw std::invalid_argument("OFO batch size must be greater than 0");
+
     Real a = args.ofoA;
     Real b = args.ofoB;
 
-    Log(CERR) << "Optimizing Micro F measure for " << args.epochs << " epochs using " << args.threads << " threads ...\n";
+    Log(CERR) << "Optimizing Micro F measure for " << args.epochs << " epochs in mini-batches of " << args.ofoBatchSize
+              << " using " << args.threads << " threads ...\n";
+
+    // Data points of each mini-batch are predicted in parallel with the threshold from the previous mini-batches,
+    // set in a copy of args, then counters are updated with sums from all threads
+    Args batchArgs = args;
+    const long long examples = static_cast<long long>(features.rows()) * args.epochs;
+    const int batches = (examples + args.ofoBatchSize - 1) / args.ofoBatchSize;
+    std::vector<OFOUpdates> updates(args.threads);
+    for (int i = 0; i < batches && !isInterrupted(); ++i) {
+        printProgress(i, batches);
+        long long batchStart = static_cast<long long>(i) * args.ofoBatchSize;
+        long long batchStop = std::min(batchStart + args.ofoBatchSize, examples);
+        batchArgs.threshold = a / b;
+
+        long long tExamples = (batchStop - batchStart + args.threads - 1) / args.threads;
+        if (args.threads == 1) microOfoThread(this, updates[0], features, labels, batchArgs, batchStart, batchStop);
+        else {
+            ThreadSet tSet;
+            for (int t = 0; t < args.threads; ++t)
+                tSet.add(microOfoThread, this, std::ref(updates[t]), std::ref(features), std::ref(labels),
+                         std::ref(batchArgs), std::min(batchStart + t * tExamples, batchStop),
+                         std::min(batchStart + (t + 1) * tExamples, batchStop));
+            tSet.joinAll();
+        }
+
+        for (auto& u : updates) {
+            a += u.a;
+            b += u.b;
+            u.a = 0;
+            u.b = 0;
+        }
+    }
+    checkInterrupted();
 
-    const int examples = features.rows() * args.epochs;
-    for (int i = 0; i < examples; ++i) {
-        printProgress(i, examples);
-        int r = i % features.rows();
+    return a / b;
+}
 
-        // Predict with current thresholds
-        std::vector<Prediction> prediction;
-        args.threshold = a / b;
-        predict(prediction, features[r], args);
-
-        // Update a and b counters
-        for (const auto &p : prediction) {
-            for (int l = -1; labels[r][l] > -1; ++l)
-                if (p.label == labels[r][l]) {
-                    a++;
+void Model::microOfoThread(Model* model, OFOUpdates& updates, SRMatrix& features, SRMatrix& labels, Args& args,
+                           const long long start, const long long stop) {
+    const int rows = features.rows();
+    for (long long i = start; i < stop && !isInterrupted(); ++i) {
+        int r = i % rows;
+
+        // Predict with current threshold
+        updates.prediction.clear();
+        model->predict(updates.prediction, features[r], args);
+
+        // a = sum_{i = 1}^{t} y_i \hat y_i, b = sum_{i = 1}^{t} \hat y_i + y_i
+        for (const auto& p : updates.prediction) {
+            for (const auto& l : labels[r])
+                if (p.label == l.index) {
+                    updates.a++;
                     break;
                 }
         }
-
-        b += prediction.size() + labels.size(r);
+        updates.b += updates.prediction.size() + labels.size(r);
     }
-
-    return a / b;
 }
 
 std::vector<Real> Model::macroOfo(SRMatrix& features, SRMatrix& labels, Args& args){
+    if (args.ofoBatchSize < 1) throw std::invalid_argument("OFO batch size must be greater than 0");
+
     // Variables required for OFO
     std::vector<Real> as(m, args.ofoA);
     std::vector<Real> bs(m, args.ofoB);
     thresholds = std::vector<Real>(m, args.ofoA / args.ofoB);
 
-    Log(CERR) << "Optimizing Macro F measure for " << args.epochs << " epochs using " << args.threads
-              << " threads ...\n";
+    Log(CERR) << "Optimizing Macro F measure for " << args.epochs << " epochs in mini-batches of " << args.ofoBatchSize
+              << " using " << args.threads << " threads ...\n";
 
     // Set initial thresholds
     setThresholds(thresholds);
 
-    ThreadSet tSet;
-    int tRows = ceil(static_cast<Real>(features.rows()) / args.threads);
-    for (int t = 0; t < args.threads; ++t)
-        tSet.add(macroOfoThread, t, this, std::ref(as), std::ref(bs), std::ref(features), std::ref(labels),
-                 std::ref(args),
-                 t * tRows, std::min((t + 1) * tRows, features.rows()));
-    tSet.joinAll();
-
-    return thresholds;
-}
+    // Data points of each mini-batch are predicted in parallel with thresholds from the previous mini-batches,
+    // then updates of counters are merged in order, so the result does not depend on the number of threads
+    const long long examples = static_cast<long long>(features.rows()) * args.epochs;
+    const int batches = (examples + args.ofoBatchSize - 1) / args.ofoBatchSize;
+    std::vector<OFOUpdates> updates(args.threads);
+    UnorderedMap<int, Real> thresholdsToUpdate;
+    for (int b = 0; b < batches && !isInterrupted(); ++b) {
+        printProgress(b, batches);
+        long long batchStart = static_cast<long long>(b) * args.ofoBatchSize;
+        long long batchStop = std::min(batchStart + args.ofoBatchSize, examples);
+
+        long long tExamples = (batchStop - batchStart + args.threads - 1) / args.threads;
+        if (args.threads == 1) macroOfoThread(this, updates[0], features, labels, args, batchStart, batchStop);
+        else {
+            ThreadSet tSet;
+            for (int t = 0; t < args.threads; ++t)
+                tSet.add(macroOfoThread, this, std::ref(updates[t]), std::ref(features), std::ref(labels),
+                         std::ref(args), std::min(batchStart + t * tExamples, batchStop),
+                         std::min(batchStart + (t + 1) * tExamples, batchStop));
+            tSet.joinAll();
+        }
 
-void Model::macroOfoThread(int threadId, Model* model, std::vector<Real>& as, std::vector<Real>& bs,
-                      SRMatrix& features, SRMatrix& labels, Args& args, const int startRow, const int stopRow) {
+        // Update a and b counters and thresholds of labels that may have changed
+        thresholdsToUpdate.clear();
+        for (auto& u : updates) {
+            // b[j] =  sum_{i = 1}^{t} \hat y_j + sum_{i = 1}^{t} y_j
+            for (const auto& l : u.predicted) {
+                bs[l]++;
+                thresholdsToUpdate[l] = 0;
+            }
+            for (const auto& l : u.positives) {
+                bs[l]++;
+                thresholdsToUpdate[l] = 0;
+            }
 
-    const int rowsRange = stopRow - startRow;
-    const int examples = rowsRange * args.epochs;
+            // a[j] = sum_{i = 1}^{t} y_j \hat y_j
+            for (const auto& l : u.correct) as[l]++;
 
-    for (int i = 0; i < examples; ++i) {
-        if (!threadId) printProgress(i, examples);
-        int r = startRow + i % rowsRange;
+            u.predicted.clear();
+            u.correct.clear();
+            u.positives.clear();
+        }
+        for (auto& th : thresholdsToUpdate) th.second = as[th.first] / bs[th.first];
+        updateThresholds(thresholdsToUpdate);
+    }
+    checkInterrupted();
 
-        // Predict with current thresholds
-        std::vector<Prediction> prediction;
-        model->predict(prediction, features[r], args);
+    return thresholds;
+}
 
-        // Update a and b counters
-        for (const auto& p : prediction) {
-            // b[j] =  sum_{i = 1}^{t} \hat y_j + ..
-            bs[p.label]++;
+void Model::macroOfoThread(Model* model, OFOUpdates& updates, SRMatrix& features, SRMatrix& labels, Args& args,
+                           const long long start, const long long stop) {
+    const int rows = features.rows();
+    for (long long i = start; i < stop && !isInterrupted(); ++i) {
+        int r = i % rows;
 
-            // a[j] = sum_{i = 1}^{t} y_j \hat y_j
-            int l = -1;
-            while (labels[r][++l] > -1)
-                if (p.label == labels[r][l]) {
-                    as[p.label]++;
+        // Predict with current thresholds
+        updates.prediction.clear();
+        model->predict(updates.prediction, features[r], args);
+
+        for (const auto& p : updates.prediction) {
+            updates.predicted.push_back(p.label);
+            for (const auto& l : labels[r])
+                if (p.label == l.index) {
+                    updates.correct.push_back(p.label);
                     break;
                 }
         }
 
-        // b[j] =  .. + sum_{i = 1}^{t} y_j
-        int l = -1;
-        while (labels[r][++l] > -1)
-            if(labels[r][l] < bs.size()) bs[labels[r][l]]++;
-
-        // Update thresholds, only those that may have changed due to update of as or bs,
-        // For simplicity I compute some of them twice because it does not really matter
-        UnorderedMap<int, Real> thresholdsToUpdate;
-        for (const auto& p : prediction)
-            thresholdsToUpdate[p.label] = as[p.label] / bs[p.label];
-        l = -1;
-        while (labels[r][++l] > -1)
-            if(labels[r][l] < bs.size()) thresholdsToUpdate[labels[r][l]] = as[labels[r][l]] / bs[labels[r][l]];
-
-        model->updateThresholds(thresholdsToUpdate);
+        for (const auto& l : labels[r])
+            if (l.index < model->m) updates.positives.push_back(l.index);
     }
 }
 
@@ -226,9 +342,11 @@ std::vector<Real> Model::ofo(SRMatrix& features, SRMatrix& labels, Args& args) {
     else if(args.ofoType == OFOType::micro)
         thresholds = std::vector<Real>(m, microOfo(features, labels, args));
     else {
+        // Micro OFO has to run first, without thresholds of labels, in one epoch
+        Args microArgs = args;
+        microArgs.epochs = 1;
+        Real microThr = microOfo(features, labels, microArgs);
         std::vector<Real> macroThr = macroOfo(features, labels, args);
-        args.epochs = 1;
-        Real microThr = microOfo(features, labels, args);
 
         Log(CERR) << "Mixing thresholds for top " << args.ofoTopLabels << " labels ...\n";
         std::vector<Prediction> priors = computeLabelsPriors(labels);
@@ -248,18 +366,30 @@ Base* Model::trainBase(ProblemData& problemsData, Args& args) {
     return base;
 }
 
-void Model::trainBatchThread(std::vector<std::promise<Base *>>& results, std::vector<ProblemData>& problemsData, Args& args, int threadId, int threads) {
+void Model::trainBatchThread(std::vector<std::promise<Base *>>& results, std::vector<ProblemData>& problemsData, std::vector<bool>& skip,
+                             SlidingWindow& window, Args& args, int threadId, int threads) {
     size_t size = problemsData.size();
-    for (int i = threadId; i < size; i += threads)
+    for (int i = threadId; i < size; i += threads) {
+        if (skip[i] || isInterrupted()) { // After interruption remaining estimators are only marked as done
+            results[i].set_value(nullptr);
+            continue;
+        }
+        window.waitFor(i);
         results[i].set_value(trainBase(problemsData[i], args));
+    }
 }
 
-void Model::saveResults(std::ofstream& out, std::vector<std::future<Base*>>& results, bool saveGrads) {
+void Model::saveResults(std::ofstream& out, std::vector<std::future<Base*>>& results, SlidingWindow& window,
+                        BasesCheckpoint* checkpoint, int offset, bool saveGrads) {
     for (int i = 0; i < results.size(); ++i) {
         printProgress(i, results.size());
         Base* base = results[i].get();
-        base->save(out, saveGrads);
-        delete base;
+        if (base != nullptr) {
+            if (checkpoint) checkpoint->save(offset + i, base, saveGrads);
+            else base->save(out, saveGrads);
+            delete base;
+        }
+        window.advance();
     }
 }
 
@@ -267,25 +397,64 @@ void Model::trainBases(std::string outfile, std::vector<ProblemData>& problemsDa
     std::ofstream out(outfile, std::ios::out | std::ios::binary);
     int size = problemsData.size();
     out.write((char*)&size, sizeof(size));
-    trainBases(out, problemsData, args);
+    // Sums over all problems, e.g. rows x labels for BR, so they do not fit into int
+    long long rows = 0, positives = 0;
+    for (const auto& p : problemsData) {
+        rows += p.binLabels.size();
+        positives += std::count(p.binLabels.begin(), p.binLabels.end(), 1.0);
+    }
+    int features = problemsData.empty() ? 0 : problemsData[0].n;
+    std::string fingerprint = checkpointFingerprint(rows, size, positives, features, 0, args);
+    std::shared_ptr<BasesCheckpoint> checkpoint = createCheckpoint(outfile, fingerprint, args);
+    trainBases(out, problemsData, args, checkpoint.get());
     out.close();
+    if (checkpoint) checkpoint->remove();
 }
 
-void Model::trainBases(std::ofstream& out, std::vector<ProblemData>& problemsData, Args& args) {
+void Model::trainBases(std::ofstream& out, std::vector<ProblemData>& problemsData, Args& args, BasesCheckpoint* checkpoint, int offset) {
 
     size_t size = problemsData.size(); // This "batch" size
-    Log(CERR) << "Starting training " << size << " base estimators in " << args.threads << " threads ...\n";
+
+    // Skip base estimators already saved in the checkpoint
+    std::vector<bool> skip(size, false);
+    int toTrain = size;
+    if (checkpoint) {
+        for (int i = 0; i < size; ++i) skip[i] = checkpoint->isTrained(offset + i);
+        toTrain -= std::count(skip.begin(), skip.end(), true);
+    }
+
+    // Each base estimator has its own seed, so it does not depend on other estimators trained before,
+    // in other threads or in the interrupted run resumed from the checkpoint
+    for (int i = 0; i < size; ++i) {
+        std::seed_seq seed{args.seed, static_cast<int>(offset + i)};
+        seed.generate(&problemsData[i].seed, &problemsData[i].seed + 1);
+    }
+
+    if (toTrain < size)
+        Log(CERR) << "Skipping " << size - toTrain << " base estimators already trained in the checkpoint\n";
+    Log(CERR) << "Starting training " << toTrain << " base estimators in " << args.threads << " threads ...\n";
     //Log(CERR) << "  Required memory: " << formatMem(args.threads * args.threads * n * sizeof(Real)) << "\n";
 
     // Run learning in parallel
     if(args.threads > 1) {
+        // Limit the number of trained, but not yet saved estimators, to fit into the memory limit
+        int n = problemsData.empty() ? 0 : problemsData[0].n;
+        unsigned long long trainingMem = args.threads * baseTrainingMem(n, args);
+        unsigned long long availableMem = freeMem(args);
+        size_t maxInFlight = size;
+        if(n > 0 && availableMem < trainingMem + size * n * sizeof(Real))
+            maxInFlight = std::max<size_t>(args.threads, (availableMem > trainingMem ? availableMem - trainingMem : 0) / (n * sizeof(Real)));
+        if(maxInFlight < size)
+            Log(CERR) << "  Limiting number of not saved base estimators to " << maxInFlight << " to fit into memory limit\n";
+
         // Thread set solution
         ThreadSet tSet;
+        SlidingWindow window(maxInFlight);
         std::vector<std::promise<Base *>> resultsPromise(size);
         std::vector<std::future<Base *>> results(size);
         for(int i = 0; i < size; ++i) results[i] = resultsPromise[i].get_future();
         for (int t = 0; t < args.threads; ++t)
-            tSet.add(trainBatchThread, std::ref(resultsPromise), std::ref(problemsData), args, t, args.threads);
+            tSet.add(trainBatchThread, std::ref(resultsPromise), std::ref(problemsData), std::ref(skip), std::ref(window), args, t, args.threads);
 
         // Thread pool solution is slower
         /*
@@ -298,17 +467,24 @@ void Model::trainBases(std::ofstream& out, std::vector<ProblemData>& problemsDat
         */
 
         // Saving in the main thread
-        saveResults(out, results, args.saveGrads);
+        saveResults(out, results, window, checkpoint, offset, args.saveGrads);
         tSet.joinAll();
+        checkInterrupted();
     } else {
         for (int i = 0; i < size; ++i){
+            checkInterrupted();
+            if (skip[i]) continue;
             Base* base = new Base();
             base->train(problemsData[i], args);
-            base->save(out, args.saveGrads);
+            if (checkpoint) checkpoint->save(offset + i, base, args.saveGrads);
+            else base->save(out, args.saveGrads);
             delete base;
         }
     }
 
+    // Compact checkpoint segments into the output
+    if (checkpoint) checkpoint->copyTo(out, offset, offset + size);
+
     if(args.reportLoss){
         Real meanLoss = 0;
         Real weightLoss = 0;
@@ -324,29 +500,88 @@ void Model::trainBases(std::ofstream& out, std::vector<ProblemData>& problemsDat
     }
 }
 
-std::vector<Base*> Model::loadBases(std::string infile, bool resume, RepresentationType loadAs) {
+std::shared_ptr<BasesCheckpoint> Model::createCheckpoint(std::string outfile, std::string fingerprint, Args& args) {
+    if (args.checkpoint <= 0) return nullptr;
+    return std::make_shared<BasesCheckpoint>(outfile + ".checkpoint", args.checkpoint, args.resume, fingerprint);
+}
+
+std::string Model::checkpointFingerprint(long long rows, int labels, long long labelsCells, int features, long long featuresCells, Args& args) {
+    std::ostringstream fingerprint;
+    fingerprint << "model: " << args.modelType << ", rows: " << rows << ", labels: " << labels << " (" << labelsCells
+                << "), features: " << features << " (" << featuresCells << "), seed: " << args.seed
+                << ", optimizer: " << args.optimizerType << ", loss: " << args.lossType << ", solver: " << args.solverType
+                << ", cost: " << args.cost << ", eps: " << args.eps << ", eta: " << args.eta << ", epochs: " << args.epochs
+                << ", bias: " << args.bias << ", norm: " << args.norm << ", hash: " << args.hash << (args.hashSign ? " signed" : "")
+                << ", neg sampling: " << args.negSamplingRatio << " " << args.negSamplingMax;
+    return fingerprint.str();
+}
+
+std::string Model::checkpointFingerprint(SRMatrix& labels, SRMatrix& features, Args& args) {
+    return checkpointFingerprint(features.rows(), labels.cols(), labels.cells(), features.cols(), features.cells(), args);
+}
+
+unsigned long long Model::baseTrainingMem(int n, Args& args) {
+    // Dense weights and gradients/solver's temporary vectors
+    return 4ULL * n * sizeof(Real);
+}
+
+unsigned long long Model::freeMem(Args& args) {
+    unsigned long long usedMem = static_cast<unsigned long long>(getResources().currentRealMem) * 1024;
+    return (args.memLimit > usedMem) ? args.memLimit - usedMem : 0;
+}
+
+void Model::loadBasesThread(int threadId, std::string infile, unsigned long long offset, std::vector<Base*>& bases,
+                            int start, int stop, bool resume, RepresentationType loadAs) {
+    WeightsReader reader(infile);
+    reader.seek(offset);
+    for (int i = start; i < stop; ++i) {
+        if (!threadId) printProgress(i - start, stop - start);
+        bases[i] = new Base();
+        reader.read(*bases[i], resume, loadAs);
+    }
+    reader.close();
+}
+
+std::vector<Base*> Model::loadBases(std::string infile, bool resume, RepresentationType loadAs, int threads) {
     Log(CERR) << "Loading base estimators ...\n";
 
+    WeightsReader reader(infile);
+    int size = reader.size();
+    std::vector<Base*> bases(size);
+    threads = std::max(1, std::min(threads, size));
+    if (threads > 1) {
+        // Index offsets of bases, so each thread can decode its own range with a separate file handle.
+        // Ranges have similar sizes in bytes, not in number of bases.
+        std::vector<unsigned long long> offsets = reader.buildIndex();
+        reader.close();
+
+        ThreadSet tSet;
+        unsigned long long bytes = offsets.back() - offsets.front();
+        int start = 0;
+        for (int t = 0; t < threads; ++t) {
+            unsigned long long stopOffset = offsets.front() + bytes * (t + 1) / threads;
+            int stop = (t == threads - 1) ? size : std::lower_bound(offsets.begin() + start, offsets.end() - 1, stopOffset) - offsets.begin();
+            tSet.add(loadBasesThread, t, infile, offsets[start], std::ref(bases), start, stop, resume, loadAs);
+            start = stop;
+        }
+        tSet.joinAll();
+    } else {
+        for (int i = 0; i < size; ++i) {
+            printProgress(i, size);
+            bases[i] = new Base();
+            reader.read(*bases[i], resume, loadAs);
+        }
+        reader.close();
+    }
+
     Real nonZeroSum = 0;
     unsigned long long memSize = 0;
     int sparse = 0;
-
-    std::vector<Base*> bases;
-    std::ifstream in(infile, std::ios::in | std::ios::binary);
-    int size;
-    in.read((char*)&size, sizeof(size));
-    bases.reserve(size);
-    for (int i = 0; i < size; ++i) {
-        printProgress(i, size);
-        auto b = new Base();
-        b->load(in, resume, loadAs);
-
+    for (auto b : bases) {
         if(b->getW() != nullptr) nonZeroSum += b->getW()->nonZero();
         memSize += b->mem();
         if(b->getType() != dense) ++sparse;
-        bases.push_back(b);
     }
-    in.close();
 
     Log(CERR) << "  Loaded bases: " << size
               << "\n  Bases size: " << formatMem(memSize) << "\n  Non zero weights / bases: " << nonZeroSum / size
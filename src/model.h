@@ -30,8 +30,13 @@
 #include "args.h"
 #include "base.h"
 #include "basic_types.h"
+#include "features_cache.h"
+#include "inference_stats.h"
 #include "misc.h"
 
+class BasesCheckpoint;
+class SlidingWindow;
+
 class Model {
 public:
     static std::shared_ptr<Model> factory(Args& args);
@@ -43,10 +48,12 @@ public:
     virtual void predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) = 0;
     virtual Real predictForLabel(Label label, SparseVector& features, Args& args) = 0;
     virtual std::vector<std::vector<Prediction>> predictBatch(SRMatrix& features, Args& args);
+    void predictWithCache(std::vector<Prediction>& prediction, SparseVector& features, Args& args);
+    virtual void initCaches(Args& args);
 
     // Prediction with thresholds and ofo
     virtual void setThresholds(std::vector<Real> th);
-    virtual void updateThresholds(UnorderedMap<int, Real> thToUpdate);
+    virtual void updateThresholds(const UnorderedMap<int, Real>& thToUpdate);
     std::vector<Real> getThresholds(){ return thresholds; };
 
     virtual void setLabelsWeights(std::vector<Real> lw);
@@ -58,11 +65,14 @@ public:
 
     virtual void load(Args& args, std::string infile) = 0;
     virtual void preload(Args& args, std::string infile) { preloaded = true; };
-    virtual void unload() { preloaded = false; loaded = false; };
+    virtual void unload() { preloaded = false; loaded = false; predictionCache = nullptr; };
     bool isPreloaded() { return preloaded; };
     bool isLoaded() { return loaded; };
 
     virtual void printInfo() {}
+    virtual std::vector<std::pair<std::string, unsigned long long>> getCacheStats();
+    void printCacheInfo();
+    virtual StatsSummary getStats() { return stats.summary(); };
     inline int outputSize() { return m; };
 
 protected:
@@ -74,21 +84,49 @@ protected:
     bool loaded;
     std::vector<Real> thresholds; // For prediction with thresholds
     std::vector<Real> labelsWeights; // For prediction with label weights
+    std::shared_ptr<FeaturesCache<std::vector<Prediction>>> predictionCache;
+    InferenceStats stats;
+
+    static uint64_t predictionSalt(Args& args);
 
     // Base utils
     static Base* trainBase(ProblemData& problemsData, Args& args);
-    static void trainBatchThread(std::vector<std::promise<Base *>>& results, std::vector<ProblemData>& problemsData, Args& args, int threadId, int threads);
+    static void trainBatchThread(std::vector<std::promise<Base *>>& results, std::vector<ProblemData>& problemsData, std::vector<bool>& skip,
+                                 SlidingWindow& window, Args& args, int threadId, int threads);
     static void trainBases(std::string outfile, std::vector<ProblemData>& problemsData, Args& args);
-    static void trainBases(std::ofstream& out, std::vector<ProblemData>& problemsData, Args& args);
-
-    static void saveResults(std::ofstream& out, std::vector<std::future<Base*>>& results, bool saveGrads=false);
-    static std::vector<Base*> loadBases(std::string infile, bool resume=false, RepresentationType loadAs=map);
+    static void trainBases(std::ofstream& out, std::vector<ProblemData>& problemsData, Args& args,
+                           BasesCheckpoint* checkpoint = nullptr, int offset = 0);
+    static std::shared_ptr<BasesCheckpoint> createCheckpoint(std::string outfile, std::string fingerprint, Args& args);
+    // Describes data and arguments that base estimators depend on, checkpoint can be resumed only with the same ones
+    static std::string checkpointFingerprint(long long rows, int labels, long long labelsCells, int features, long long featuresCells, Args& args);
+    static std::string checkpointFingerprint(SRMatrix& labels, SRMatrix& features, Args& args);
+
+    static void saveResults(std::ofstream& out, std::vector<std::future<Base*>>& results, SlidingWindow& window,
+                            BasesCheckpoint* checkpoint = nullptr, int offset = 0, bool saveGrads = false);
+    static std::vector<Base*> loadBases(std::string infile, bool resume=false, RepresentationType loadAs=map, int threads=1);
+    static void loadBasesThread(int threadId, std::string infile, unsigned long long offset, std::vector<Base*>& bases,
+                                int start, int stop, bool resume, RepresentationType loadAs);
+
+    // Memory budget utils
+    static unsigned long long baseTrainingMem(int n, Args& args);
+    static unsigned long long freeMem(Args& args);
 
 private:
     static void predictBatchThread(int threadId, Model* model, std::vector<std::vector<Prediction>>& predictions,
                                    SRMatrix& features, Args& args, const int startRow, const int stopRow);
 
-    static void macroOfoThread(int threadId, Model* model, std::vector<Real>& as, std::vector<Real>& bs,
-                               SRMatrix& features, SRMatrix& labels, Args& args,
-                               const int startRow, const int stopRow);
+    // Updates of OFO counters collected by one thread during a mini-batch, reused between mini-batches
+    struct OFOUpdates {
+        std::vector<Prediction> prediction;
+        std::vector<int> predicted; // Predicted labels, increase macro b
+        std::vector<int> correct; // Correctly predicted labels, increase macro a
+        std::vector<int> positives; // True labels, increase macro b
+        Real a = 0; // Increase of micro a
+        Real b = 0; // Increase of micro b
+    };
+
+    static void microOfoThread(Model* model, OFOUpdates& updates, SRMatrix& features, SRMatrix& labels, Args& args,
+                               const long long start, const long long stop);
+    static void macroOfoThread(Model* model, OFOUpdates& updates, SRMatrix& features, SRMatrix& labels, Args& args,
+                               const long long start, const long long stop);
 };
@@ -28,6 +28,7 @@
 #include <vector>
 
 #include "br.h"
+#include "checkpoint.h"
 #include "threads.h"
 
 
@@ -70,13 +71,22 @@ void BR::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string out
     std::vector<ProblemData> binProblemData;
     binWeights.reserve(range);
 
-    std::ofstream out(joinPath(output, "weights.bin"), std::ios::out | std::ios::binary);
+    std::string weightsFile = joinPath(output, "weights.bin");
+    std::ofstream out(weightsFile, std::ios::out | std::ios::binary);
     saveVar(out, lCols);
+    std::shared_ptr<BasesCheckpoint> checkpoint = createCheckpoint(weightsFile, checkpointFingerprint(labels, features, args), args);
 
     for (int p = 0; p < parts; ++p) {
         int rStart = p * range;
         int rStop = (p + 1) * range;
 
+        // Skip the whole part if it is already in the checkpoint
+        if (checkpoint && checkpoint->countTrained(rStart, rStop) == range) {
+            Log(CERR) << "Base estimators [" << rStart << ", " << rStop << ") already trained in the checkpoint\n";
+            checkpoint->copyTo(out, rStart, rStop);
+            continue;
+        }
+
         if (parts > 1)
             Log(CERR) << "Assigning labels for base estimators [" << rStart << ", " << rStop << ") (" << p + 1 << "/" << parts << ") ...\n";
         else
@@ -97,7 +107,7 @@ void BR::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string out
             for (int i = 0; i < range; ++i) binProblemData[i].invPs = labelsWeights[i + rStart];
         }
 
-        trainBases(out, binProblemData, args);
+        trainBases(out, binProblemData, args, checkpoint.get(), rStart);
 
         for (auto& l : binLabels) l.clear();
         binFeatures.clear();
@@ -106,6 +116,7 @@ void BR::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string out
     }
 
     out.close();
+    if (checkpoint) checkpoint->remove();
 }
 
 void BR::predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) {
@@ -148,7 +159,7 @@ Real BR::predictForLabel(Label label, SparseVector& features, Args& args) {
 
 void BR::load(Args& args, std::string infile) {
     Log(CERR) << "Loading weights ...\n";
-    bases = loadBases(joinPath(infile, "weights.bin"), args.resume, args.loadAs);
+    bases = loadBases(joinPath(infile, "weights.bin"), args.resume, args.loadAs, args.threads);
     m = bases.size();
 
     loaded = true;
@@ -171,7 +182,7 @@ size_t BR::calculateNumberOfParts(SRMatrix& labels, SRMatrix& features, Args& ar
     if(args.modelType == ovr && args.pickOneLabelWeighting)
         tmpDataMem = lCells * ((lCols + 1) * sizeof(Real) + sizeof(void*));
     else tmpDataMem = rows * ((lCols + 1) * sizeof(Real) + sizeof(void*));
-    unsigned long long baseMem = 4 * args.threads * features.cols() * sizeof(Real);
+    unsigned long long baseMem = args.threads * baseTrainingMem(features.cols(), args);
     unsigned long long reqMem = tmpDataMem + dataMem + baseMem;
     //Log(CERR) << "Required memory to train: " << formatMem(reqMem) << ", available memory: " << formatMem(args.memLimit) << "\n";
     Log(CERR) << "Required memory to train: " << formatMem(reqMem) << " (data: " << formatMem(dataMem)
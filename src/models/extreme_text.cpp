@@ -33,64 +33,97 @@ void ExtremeText::trainThread(int threadId, ExtremeText* model, SRMatrix& labels
                                     SRMatrix& features, Args& args, const int startRow, const int stopRow) {
     const int rowsRange = stopRow - startRow;
     const int examples = rowsRange * args.epochs;
+
+    UpdateBuffers buffers;
+    buffers.hidden.resize(model->dims);
+    buffers.gradient.resize(model->dims);
+    buffers.nodesMarks.resize(model->tree->size(), 0);
+    buffers.mark = 0;
+
     Real loss = 0;
     for (int i = 0; i < examples; ++i) {
         Real lr = args.eta * (1.0 - (static_cast<Real>(i) / examples));
         if (!threadId) printProgress(i, examples, lr, loss / i);
 
         int r = startRow + i % rowsRange;
-        loss += model->update(lr, features[r], labels[r], args);
+        loss += model->update(lr, features[r], labels[r], buffers, args);
     }
 }
 
-Real ExtremeText::updateNode(TreeNode* node, Real label, Vector& hidden, Vector& gradient, Real lr, Real l2){
-    size_t i = node->index;
+Real ExtremeText::updateNode(TreeNode* node, Real label, const Real* __restrict hidden, Real* __restrict gradient, Real lr, Real l2){
+    Real* __restrict W = outputW[node->index].data();
 
-    //Real pred = 1.0 / (1.0 + std::exp(-dotVectors(outputW[i], hidden)));
-    Real val = outputW[i].dot(hidden);
+    Real val = dotVectors(W, hidden, dims);
     Real pred = sigmoid(val);
     Real grad = label - pred;
-    //Log(COUT) << val << " " << pred << " " << grad << "\n";
 
+    // Gradient of hidden uses weights from before their update
     for(int j = 0; j < dims; ++j){
-        gradient[j] += lr * (grad * outputW[i][j] - l2 * gradient[j]);
-        outputW[i][j] += lr * (grad * hidden[j] - l2 * outputW[i][j]);
+        Real w = W[j];
+        gradient[j] += lr * (grad * w - l2 * gradient[j]);
+        W[j] += lr * (grad * hidden[j] - l2 * w);
     }
 
     return label ? -log(pred) : -log(1.0 - pred);
 }
 
-Real ExtremeText::update(Real lr, const SparseVector& features, const SparseVector& labels, const Args& args){
+void ExtremeText::getNodesToUpdate(UpdateBuffers& buffers, const SparseVector& labels){
+    auto& nPositive = buffers.nPositive;
+    auto& nNegative = buffers.nNegative;
+    auto& nodesMarks = buffers.nodesMarks;
+    nPositive.clear();
+    nNegative.clear();
+    if (++buffers.mark == 0) { // Marks wrapped around
+        std::fill(nodesMarks.begin(), nodesMarks.end(), 0);
+        buffers.mark = 1;
+    }
+    unsigned int mark = buffers.mark;
+
+    for (auto &l : labels) {
+        TreeNode* n = tree->getLeaf(l.index);
+        if (n == nullptr) {
+            Log(CERR) << "Encountered example with label " << l.index << " that does not exists in the tree\n";
+            continue;
+        }
+
+        // Rest of the path is already marked if it joins the path of a previous label
+        for (; n != nullptr && nodesMarks[n->index] != mark; n = n->parent) {
+            nodesMarks[n->index] = mark;
+            nPositive.push_back(n);
+        }
+    }
 
-    // Compute hidden
-    Real valuesSum = 0;
-    Vector hidden(dims);
-    for(auto &f : features){
-        valuesSum += f.value;
-        hidden.add(inputW[f.index], f.value);
+    if (nPositive.empty()) {
+        nNegative.push_back(tree->root);
+        return;
+    }
+
+    for (auto& n : nPositive) {
+        for (const auto& child : n->children) {
+            if (nodesMarks[child->index] != mark) nNegative.push_back(child);
+        }
     }
-    hidden.div(valuesSum);
+}
 
-    // Gather nodes to update
-    UnorderedSet<TreeNode*> nPositive;
-    UnorderedSet<TreeNode*> nNegative;
+Real ExtremeText::update(Real lr, const SparseVector& features, const SparseVector& labels, UpdateBuffers& buffers, const Args& args){
+    Real* hidden = buffers.hidden.data();
+    Real* gradient = buffers.gradient.data();
+    Real valuesSum = computeHidden(features, hidden);
 
-    getNodesToUpdate(nPositive, nNegative, labels);
+    getNodesToUpdate(buffers, labels);
 
     // Compute gradient
-    Vector gradient(dims);
-    //Real lr = 0.5 * args.eta * std::sqrt(1.0 / ++t);
+    std::fill(gradient, gradient + dims, 0);
     Real loss = 0.0;
-    for (auto &n : nPositive)
+    for (auto &n : buffers.nPositive)
         loss += updateNode(n, 1.0, hidden, gradient, lr, args.l2Penalty);
 
-    for (auto &n : nNegative)
+    for (auto &n : buffers.nNegative)
         loss += updateNode(n, 0.0, hidden, gradient, lr, args.l2Penalty);
 
     // Update input weights
-    gradient.div(valuesSum);
     for(auto &f : features)
-        inputW[f.index].add(gradient, f.value);
+        addVector(gradient, f.value / valuesSum, inputW[f.index].data(), dims);
 
     return loss;
 }
@@ -156,27 +189,161 @@ void ExtremeText::load(Args& args, std::string infile) {
 }
 
 void ExtremeText::predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args){
-    auto hidden = computeHidden(features);
-    PLT::predict(prediction, hidden, args);
+    thread_local std::vector<Real> hidden;
+    hidden.resize(dims);
+    computeHidden(features, hidden.data());
+    predictForHidden(prediction, hidden.data(), args);
+    stats.local().addDataPoints();
 }
 
 Real ExtremeText::predictForLabel(Label label, SparseVector& features, Args& args){
-    auto hidden = computeHidden(features);
-    Real value = PLT::predictForLabel(label, hidden, args);
+    TreeNode* n = tree->getLeaf(label);
+    if(n == nullptr) return 0;
+
+    thread_local std::vector<Real> hidden;
+    hidden.resize(dims);
+    computeHidden(features, hidden.data());
+
+    Real value = 1;
+    ThreadStats& stats = this->stats.local();
+    for(; n != nullptr; n = n->parent){
+        value *= predictForNode(n, hidden.data());
+        stats.addNodeEvaluations(n->index);
+    }
+
+    if(!labelsWeights.empty())
+        value *= labelsWeights[label];
+
     return value;
 }
 
-SparseVector ExtremeText::computeHidden(const SparseVector& features){
-    SparseVector hidden(dims, dims);
-    for(size_t i = 0; i < dims; ++i) hidden.insertD(i, 0);
+std::vector<std::vector<Prediction>> ExtremeText::predictBatch(SRMatrix& features, Args& args){
+    if (args.treeSearchType != exact && args.treeSearchType != beam) throw std::invalid_argument("Unknown tree search type");
+
+    int rows = features.rows();
+    int threads = args.threads;
+
+    // Hidden vectors are computed once for each block of rows into a buffer local to this call,
+    // size of the blocks bounds the memory used by the buffer
+    const size_t maxBlockMem = 256ULL * 1024 * 1024;
+    int blockRows = std::max<size_t>(threads, maxBlockMem / (static_cast<size_t>(dims) * sizeof(Real)));
+    std::vector<Real> hidden(static_cast<size_t>(std::min(rows, blockRows)) * dims);
+
+    if (args.treeSearchType == exact) Log(CERR) << "Starting prediction in " << threads << " threads ...\n";
+    std::vector<std::vector<Prediction>> prediction(rows);
+    ThreadSet tSet;
+    for (int blockStart = 0; blockStart < rows && !isInterrupted(); blockStart += blockRows) {
+        int blockStop = std::min(blockStart + blockRows, rows);
+        int tRows = ceil(static_cast<Real>(blockStop - blockStart) / threads);
+        for (int t = 0; t < threads; ++t)
+            tSet.add(computeHiddenThread, this, std::ref(features), hidden.data(), blockStart,
+                     std::min(blockStart + t * tRows, blockStop), std::min(blockStart + (t + 1) * tRows, blockStop));
+        tSet.joinAll();
+
+        if (args.treeSearchType == exact) {
+            for (int t = 0; t < threads; ++t)
+                tSet.add(predictForHiddenThread, t, this, std::ref(prediction), hidden.data(), blockStart, std::ref(args),
+                         std::min(blockStart + t * tRows, blockStop), std::min(blockStart + (t + 1) * tRows, blockStop));
+            tSet.joinAll();
+        }
+        else if (blockStart == 0 && blockStop == rows) prediction = predictWithBeamSearch(features, args, hidden.data());
+        else {
+            // Rows of the block are numbered from 0 in beam search, the same as rows of the hidden buffer
+            SRMatrix blockFeatures;
+            for (int r = blockStart; r < blockStop; ++r)
+                blockFeatures.appendRow(std::vector<Feature>(features[r].begin(), features[r].end()));
+            auto blockPrediction = predictWithBeamSearch(blockFeatures, args, hidden.data());
+            std::move(blockPrediction.begin(), blockPrediction.end(), prediction.begin() + blockStart);
+        }
+    }
+    checkInterrupted();
+
+    return prediction;
+}
+
+void ExtremeText::computeHiddenThread(ExtremeText* model, SRMatrix& features, Real* hidden, int blockStart, int startRow, int stopRow){
+    for (int r = startRow; r < stopRow; ++r)
+        model->computeHidden(features[r], hidden + static_cast<size_t>(r - blockStart) * model->dims);
+}
+
+void ExtremeText::predictForHiddenThread(int threadId, ExtremeText* model, std::vector<std::vector<Prediction>>& predictions,
+                                         const Real* hidden, int blockStart, Args& args, int startRow, int stopRow){
+    ThreadStats& stats = model->stats.local();
+    for (int r = startRow; r < stopRow && !isInterrupted(); ++r) {
+        auto start = std::chrono::steady_clock::now();
+        model->predictForHidden(predictions[r], hidden + static_cast<size_t>(r - blockStart) * model->dims, args);
+        auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        stats.addLatency(time.count());
+        stats.addDataPoints();
+        if (!threadId) ::printProgress(r - startRow, stopRow - startRow);
+    }
+}
+
+void ExtremeText::predictForHidden(std::vector<Prediction>& prediction, const Real* hidden, Args& args){
+    int topK = args.topK;
+    if(topK > 0) prediction.reserve(topK);
+    TopKQueue<TreeNodeValue> nQueue(topK);
+
+    std::function<bool(TreeNode*, Real)> ifAddToQueue;
+    std::function<Real(TreeNode*, Real)> calculateValue;
+    setPredictionFunctions(ifAddToQueue, calculateValue, args);
+
+    thread_local std::vector<const Real*> childrenW;
+    thread_local std::vector<Real> scores;
+    ThreadStats& stats = this->stats.local();
+
+    addToQueue(ifAddToQueue, calculateValue, nQueue, tree->root, predictForNode(tree->root, hidden));
+    stats.addNodeEvaluations(tree->root->index);
+    while (!nQueue.empty() && (prediction.size() < topK || topK == 0)) {
+        TreeNodeValue nVal = nQueue.top();
+        nQueue.pop();
+
+        auto& children = nVal.node->children;
+        if (!children.empty()) {
+            childrenW.clear();
+            for (auto& child : children) childrenW.push_back(outputW[child->index].data());
+            scores.resize(children.size());
+            dotRows(&hidden, 1, childrenW.data(), children.size(), dims, scores.data());
+
+            for (int c = 0; c < children.size(); ++c) {
+                Real prob = nVal.prob * (1.0 / (1.0 + std::exp(-scores[c])));
+                addToQueue(ifAddToQueue, calculateValue, nQueue, children[c], prob);
+                stats.addNodeEvaluations(children[c]->index);
+            }
+        }
+        if (nVal.node->label >= 0) prediction.emplace_back(nVal.node->label, nVal.value);
+    }
+}
+
+void ExtremeText::beamSearchScore(BeamSearchItem& item, std::vector<TreeNode*>& children, SRMatrix& features, const Real* hidden,
+                                  Real* scores, Vector*& tmpW, Args& args){
+    auto& entries = *item.entries;
+    int k = children.size();
+    int size = item.stop - item.start;
+
+    thread_local std::vector<const Real*> rowsHidden;
+    thread_local std::vector<const Real*> childrenW;
+    rowsHidden.clear();
+    for (int e = 0; e < size; ++e)
+        rowsHidden.push_back(hidden + static_cast<size_t>(entries[item.start + e].label) * dims);
+    childrenW.clear();
+    for (auto& child : children) childrenW.push_back(outputW[child->index].data());
+
+    dotRows(rowsHidden.data(), size, childrenW.data(), k, dims, scores);
+    for (int i = 0; i < size * k; ++i) scores[i] = 1.0 / (1.0 + std::exp(-scores[i]));
+
+    ThreadStats& stats = this->stats.local();
+    for (auto& child : children) stats.addNodeEvaluations(child->index, size);
+}
 
+Real ExtremeText::computeHidden(const SparseVector& features, Real* hidden){
+    std::fill(hidden, hidden + dims, 0);
     Real valuesSum = 0;
     for(auto &f : features){
         valuesSum += f.value;
-        hidden.add(inputW[f.index], f.value);
+        addVector(inputW[f.index].data(), f.value, hidden, dims);
     }
+    divVector(hidden, valuesSum, dims);
 
-    hidden.div(valuesSum);
-
-    return hidden;
-}
\ No newline at end of file
+    return valuesSum;
+}
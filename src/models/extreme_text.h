@@ -34,6 +34,7 @@ public:
 
     void predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) override;
     Real predictForLabel(Label label, SparseVector& features, Args& args) override;
+    std::vector<std::vector<Prediction>> predictBatch(SRMatrix& features, Args& args) override;
 
     void load(Args& args, std::string infile) override;
 
@@ -42,14 +43,41 @@ protected:
     Matrix outputW; // Tree node vectors
     int dims;
 
-    Real update(Real lr, const SparseVector& features, const SparseVector& labels, const Args& args);
-    Real updateNode(TreeNode* node, Real label, Vector& hidden, Vector& gradient, Real lr, Real l2);
+    // Buffers of a training thread, reused for all its updates
+    struct UpdateBuffers {
+        std::vector<Real> hidden;
+        std::vector<Real> gradient;
+        std::vector<TreeNode*> nPositive;
+        std::vector<TreeNode*> nNegative;
+        std::vector<unsigned int> nodesMarks; // Nodes on paths of the current update are marked with its mark
+        unsigned int mark;
+    };
+
+    Real update(Real lr, const SparseVector& features, const SparseVector& labels, UpdateBuffers& buffers, const Args& args);
+    Real updateNode(TreeNode* node, Real label, const Real* hidden, Real* gradient, Real lr, Real l2);
+    void getNodesToUpdate(UpdateBuffers& buffers, const SparseVector& labels);
 
-    SparseVector computeHidden(const SparseVector& features);
+    // Computes hidden (dims size) as average of features' input vectors, returns sum of features' values
+    Real computeHidden(const SparseVector& features, Real* hidden);
 
     inline Real predictForNode(TreeNode* node, SparseVector& features) override {
         return 1.0 / (1.0 + std::exp(-outputW[node->index].dot(features)));
     };
+    inline Real predictForNode(TreeNode* node, const Real* hidden) {
+        return 1.0 / (1.0 + std::exp(-dotVectors(outputW[node->index].data(), hidden, dims)));
+    };
+
+    // Exact search for the top labels, children of an expanded node are scored together
+    void predictForHidden(std::vector<Prediction>& prediction, const Real* hidden, Args& args);
+
+    // Level of beam search is scored as products of item's hidden rows and children's output vectors
+    void beamSearchScore(BeamSearchItem& item, std::vector<TreeNode*>& children, SRMatrix& features, const Real* hidden,
+                         Real* scores, Vector*& tmpW, Args& args) override;
+
+    // Batched prediction, hidden vectors of a block of rows are rows of a dense matrix (rows x dims) starting at blockStart
+    static void computeHiddenThread(ExtremeText* model, SRMatrix& features, Real* hidden, int blockStart, int startRow, int stopRow);
+    static void predictForHiddenThread(int threadId, ExtremeText* model, std::vector<std::vector<Prediction>>& predictions,
+                                       const Real* hidden, int blockStart, Args& args, int startRow, int stopRow);
 
     static void trainThread(int threadId, ExtremeText* model, SRMatrix& labels,
                                   SRMatrix& features, Args& args, const int startRow, const int stopRow);
@@ -40,21 +40,47 @@ HSM::HSM() {
 
 void HSM::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vector<std::vector<Feature*>>& binFeatures,
                            std::vector<std::vector<Real>>& binWeights, SRMatrix& labels,
-                           SRMatrix& features, Args& args) {
-    Log(CERR) << "Assigning data points to nodes ...\n";
-
+                           SRMatrix& features, Args& args, int nStart, int nStop) {
     // Positive and negative nodes
     UnorderedSet<TreeNode*> nPositive;
     UnorderedSet<TreeNode*> nNegative;
 
-    // Gather examples for each node
+    // Gather examples for each node in [nStart, nStop) range
     int rows = features.rows();
     for (int r = 0; r < rows; ++r) {
         printProgress(r, rows);
 
+        SparseVector& rLabels = labels[r];
+        int rSize = rLabels.nonZero();
+
         nPositive.clear();
         nNegative.clear();
 
+        for (auto &l : labels[r]){
+            getNodesToUpdate(nPositive, nNegative, l.index);
+            addNodesLabelsAndFeatures(binLabels, binFeatures, nPositive, nNegative, features[r], nStart, nStop);
+            if (args.pickOneLabelWeighting) {
+                Real w = 1.0 / rSize;
+                for (const auto& n : nPositive) if (n->index >= nStart && n->index < nStop) binWeights[n->index - nStart].push_back(w);
+                for (const auto& n : nNegative) if (n->index >= nStart && n->index < nStop) binWeights[n->index - nStart].push_back(w);
+            }
+        }
+    }
+}
+
+std::vector<unsigned long long> HSM::countDataPoints(SRMatrix& labels, Args& args) {
+    Log(CERR) << "Counting data points for nodes ...\n";
+
+    std::vector<unsigned long long> nodesCounts(tree->size(), 0);
+
+    // Positive and negative nodes
+    UnorderedSet<TreeNode*> nPositive;
+    UnorderedSet<TreeNode*> nNegative;
+
+    int rows = labels.rows();
+    for (int r = 0; r < rows; ++r) {
+        printProgress(r, rows);
+
         SparseVector& rLabels = labels[r];
         int rSize = rLabels.nonZero();
 
@@ -62,29 +88,29 @@ void HSM::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vecto
         if (!args.pickOneLabelWeighting && rSize != 1)
             throw std::invalid_argument("Encountered example with " + std::to_string(rSize) + " labels. HSM is multi-class classifier, use PLT or --pickOneLabelWeighting option instead.");
 
+        nPositive.clear();
+        nNegative.clear();
+
         for (auto &l : labels[r]){
-            getNodesToUpdate(nPositive, nNegative, l.index);
-            addNodesLabelsAndFeatures(binLabels, binFeatures, nPositive, nNegative, features[r]);
-            if (args.pickOneLabelWeighting) {
-                Real w = 1.0 / rSize;
-                for (const auto& n : nPositive) binWeights[n->index].push_back(w);
-                for (const auto& n : nNegative) binWeights[n->index].push_back(w);
-            }
+            pathLength += getNodesToUpdate(nPositive, nNegative, l.index);
+            for (const auto& n : nPositive) ++nodesCounts[n->index];
+            for (const auto& n : nNegative) ++nodesCounts[n->index];
 
-            nodeUpdateCount += nPositive.size() + nNegative.size();
+            stats.local().addNodeUpdates(nPositive.size() + nNegative.size());
         }
-        ++dataPointCount;
+        stats.local().addDataPoints();
     }
+
+    return nodesCounts;
 }
 
-void HSM::getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, int label) {
+int HSM::getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, int label) {
 
     std::vector<TreeNode*> path;
 
-    auto ni = tree->leaves.find(label);
-    if (ni == tree->leaves.end())
+    TreeNode* n = tree->getLeaf(label);
+    if (n == nullptr)
         throw std::invalid_argument("Encountered example with " + std::to_string(label) + " that does not exists in the tree.");
-    TreeNode* n = ni->second;
     path.push_back(n);
     while (n->parent) {
         n = n->parent;
@@ -110,7 +136,7 @@ void HSM::getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<Tree
         }
     }
 
-    pathLength += path.size();
+    return path.size();
 }
 
 Prediction HSM::predictNextLabel(
@@ -123,23 +149,26 @@ Prediction HSM::predictNextLabel(
 
         if (!nVal.node->children.empty()) {
             if (nVal.node->children.size() == 2) {
-                Real value = bases[nVal.node->children[0]->index]->predictProbability(features);
+                Real value = predictForNode(nVal.node->children[0], features);
                 addToQueue(ifAddToQueue, calculateValue, nQueue, nVal.node->children[0], nVal.value * value);
                 addToQueue(ifAddToQueue, calculateValue, nQueue, nVal.node->children[1], nVal.value * (1.0 - value));
-                ++nodeEvaluationCount;
+                stats.local().addNodeEvaluations(nVal.node->children[0]->index);
             } else {
                 Real sum = 0;
-                std::vector<Real> values;
-                values.reserve(nVal.node->children.size());
-                for (const auto& child : nVal.node->children) {
-                    values.emplace_back(std::exp(bases[child->index]->predictValue(features))); // Softmax normalization
-                    sum += values.back();
+                std::vector<Real> values(nVal.node->children.size());
+                SiblingsBlock* block = getChildrenBlock(nVal.node);
+                if (block != nullptr) block->predictValues(features, values.data()); // All children in one pass
+                else for (int i = 0; i < values.size(); ++i) values[i] = predictValueForNode(nVal.node->children[i], features);
+                for (auto& v : values) {
+                    v = std::exp(v); // Softmax normalization
+                    sum += v;
                 }
 
-                for (int i = 0; i < nVal.node->children.size(); ++i)
+                ThreadStats& stats = this->stats.local();
+                for (int i = 0; i < nVal.node->children.size(); ++i) {
                     addToQueue(ifAddToQueue, calculateValue, nQueue, nVal.node->children[i], nVal.value * values[i] / sum);
-
-                nodeEvaluationCount += nVal.node->children.size();
+                    stats.addNodeEvaluations(nVal.node->children[i]->index);
+                }
             }
         }
         if (nVal.node->label >= 0) return {nVal.node->label, nVal.value};
@@ -148,28 +177,39 @@ Prediction HSM::predictNextLabel(
     return {-1, 0};
 }
 
+void HSM::scoresToProbabilities(TreeNode* node, Real* scores) {
+    int size = node->children.size();
+    if (size == 2) scores[1] = 1.0 - scores[0];
+    else {
+        Real sum = 0;
+        for (int i = 0; i < size; ++i) sum += scores[i];
+        for (int i = 0; i < size; ++i) scores[i] /= sum;
+    }
+}
+
 Real HSM::predictForLabel(Label label, SparseVector& features, Args& args) {
-    Real value = 0;
-    TreeNode* n = tree->leaves[label];
+    Real value = 1;
+    TreeNode* n = tree->getLeaf(label);
+    if (n == nullptr) return 0;
     while (n->parent) {
         if (n->parent->children.size() == 2) {
             if (n == n->parent->children[0])
-                value *= bases[n->children[0]->index]->predictProbability(features);
+                value *= predictForNode(n->parent->children[0], features);
             else
-                value *= 1.0 - bases[n->children[0]->index]->predictProbability(features);
-            ++nodeEvaluationCount;
+                value *= 1.0 - predictForNode(n->parent->children[0], features);
+            stats.local().addNodeEvaluations(n->parent->children[0]->index);
         } else {
             Real sum = 0;
             Real tmpValue = 0;
             for (const auto& child : n->parent->children) {
                 if (child == n) {
-                    tmpValue = std::exp(bases[child->index]->predictValue(features)); // Softmax normalization
+                    tmpValue = std::exp(predictValueForNode(child, features)); // Softmax normalization
                     sum += tmpValue;
                 } else
-                    sum += std::exp(bases[child->index]->predictValue(features));
+                    sum += std::exp(predictValueForNode(child, features));
             }
             value *= tmpValue / sum;
-            nodeEvaluationCount += n->parent->children.size();
+            for (const auto& child : n->parent->children) stats.local().addNodeEvaluations(child->index);
         }
         n = n->parent;
     }
@@ -180,5 +220,5 @@ Real HSM::predictForLabel(Label label, SparseVector& features, Args& args) {
 void HSM::printInfo() {
     PLT::printInfo();
     if(pathLength > 0)
-        Log(COUT) << "  Path length: " << static_cast<Real>(pathLength) / dataPointCount << "\n";
+        Log(COUT) << "  Path length: " << static_cast<Real>(pathLength) / getStats().dataPoints << "\n";
 }
@@ -46,11 +46,28 @@ protected:
     void assignDataPoints(std::vector<std::vector<Real>>& binLabels,
                           std::vector<std::vector<Feature*>>& binFeatures,
                           std::vector<std::vector<Real>>& binWeights,
-                          SRMatrix& labels, SRMatrix& features, Args& args) override;
-    void getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, int rLabel);
+                          SRMatrix& labels, SRMatrix& features, Args& args, int nStart, int nStop) override;
+    std::vector<unsigned long long> countDataPoints(SRMatrix& labels, Args& args) override;
+    int getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, int rLabel);
     Prediction predictNextLabel(
         std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue,
         TopKQueue<TreeNodeValue>& nQueue, SparseVector& features) override;
 
+    // Second child of binary node is not scored, its probability is a complement of the first one
+    inline bool isScoredInBeamSearch(TreeNode* node) override {
+        return !node->parent || node->parent->children.size() != 2 || node == node->parent->children[0];
+    }
+    inline Real predictScoreForNode(TreeNode* node, Base* base, SparseVector& features, AbstractVector* W) override {
+        if (node->parent && node->parent->children.size() != 2)
+            return std::exp(base->predictValue(features, W)); // Softmax normalization
+        return base->predictProbability(features, W);
+    }
+    inline void blockValuesToScores(TreeNode* node, SiblingsBlock* block, Real* values) override {
+        if (node->children.size() != 2)
+            for (int c = 0; c < block->size(); ++c) values[c] = std::exp(values[c]); // Softmax normalization
+        else values[0] = block->toProbability(0, values[0]);
+    }
+    void scoresToProbabilities(TreeNode* node, Real* scores) override;
+
     int pathLength;   // Length of the path
 };
@@ -45,7 +45,8 @@ LabelTree::~LabelTree() {
 void LabelTree::clear() {
     for (auto n : nodes) delete n;
     nodes.clear();
-    leaves = UnorderedMap<int, TreeNode*>();
+    leaves = std::vector<TreeNode*>();
+    leavesCount = 0;
 }
 
 void LabelTree::buildTreeStructure(int labelCount, Args& args) {
@@ -104,7 +105,7 @@ void LabelTree::buildTreeStructure(SRMatrix& labels, SRMatrix& features, Args& a
 
     //printTree();
     //validateTree();
-    Log(CERR) << "  Nodes: " << nodes.size() << ", leaves: " << leaves.size() << "\n";
+    Log(CERR) << "  Nodes: " << nodes.size() << ", leaves: " << leavesCount << "\n";
 }
 
 TreeNodePartition LabelTree::buildKmeansTreeThread(TreeNodePartition nPart, SRMatrix& labelsFeatures, Args& args,
@@ -301,7 +302,7 @@ void LabelTree::buildOnlineTree(SRMatrix& labels, SRMatrix& features, Args& args
 
         // Check row
         for (int i = 0; i < rSize; ++i) {
-            if (!leaves.count(rLabels[i])) {
+            if (!hasLeaf(rLabels[i])) {
 
                 int newLabel = rLabels[i];
 
@@ -392,24 +393,23 @@ void LabelTree::setTreeStructure(std::vector<std::tuple<int, int, int>> treeStru
         }
 
         if (label >= 0) {
-            assert(leaves.count(label) == 0);
+            assert(!hasLeaf(label));
             assert(label < k);
-            n->label = label;
-            leaves[n->label] = n;
+            setLabel(n, label);
         }
     }
 
     validateTree();
 
     assert(nodes.size() == t);
-    assert(leaves.size() == k);
+    assert(leavesCount == k);
 }
 
 void LabelTree::saveTreeStructure(std::string file) {
     Log(CERR) << "Saving tree structure to: " << file << "...\n";
 
     std::ofstream out(file);
-    out << leaves.size() << " " << nodes.size() << "\n";
+    out << leavesCount << " " << nodes.size() << "\n";
     for (auto& n : nodes) {
         if (n->parent != nullptr) out << n->parent->index;
         else out << -1;
@@ -447,8 +447,9 @@ void LabelTree::flattenTree(int levels){
 
     UnorderedSet<TreeNode*> currentLevel;
     UnorderedSet<TreeNode*> nextLevel;
-    currentLevel.reserve(leaves.size());
-    for(auto l : leaves) currentLevel.insert(l.second->parent);
+    currentLevel.reserve(leavesCount);
+    for(auto l : leaves)
+        if(l != nullptr) currentLevel.insert(l->parent);
 
     while(currentLevel.size() > 1){
         for(auto n : currentLevel) {
@@ -505,7 +506,7 @@ TreeNode* LabelTree::createTreeNode(TreeNode* parent, int label) {
 void LabelTree::save(std::ofstream& out) {
     Log(CERR) << "Saving tree ...\n";
 
-    int k = leaves.size();
+    int k = leavesCount;
     int t = nodes.size();
 
     out.write((char*)&k, sizeof(k));
@@ -541,13 +542,15 @@ void LabelTree::load(std::ifstream& in) {
     int k, t;
     in.read((char*)&k, sizeof(k));
     in.read((char*)&t, sizeof(t));
+    nodes.reserve(t);
+    leaves.reserve(k);
     for (size_t i = 0; i < t; ++i) {
         TreeNode* n = new TreeNode();
         in.read((char*)&n->index, sizeof(n->index));
         in.read((char*)&n->label, sizeof(n->label));
 
         nodes.push_back(n);
-        if (n->label >= 0) leaves[n->label] = n;
+        if (n->label >= 0) setLabel(n, n->label);
     }
 
     int rootN;
@@ -565,7 +568,7 @@ void LabelTree::load(std::ifstream& in) {
         }
     }
 
-    Log(CERR) << "  Nodes: " << nodes.size() << ", leaves: " << leaves.size() << "\n";
+    Log(CERR) << "  Nodes: " << nodes.size() << ", leaves: " << leavesCount << "\n";
 }
 
 void LabelTree::printTree(TreeNode* rootNode, bool printNodes) {
@@ -604,7 +607,7 @@ void LabelTree::printTree(TreeNode* rootNode, bool printNodes) {
 
 int LabelTree::getNumberOfLeaves(TreeNode* rootNode) {
     if (rootNode == nullptr) // Root node
-        return leaves.size();
+        return leavesCount;
 
     int lCount = 0;
     std::queue<TreeNode*> nQueue;
@@ -624,9 +627,10 @@ int LabelTree::getNumberOfLeaves(TreeNode* rootNode) {
 void LabelTree::setLabel(TreeNode* n, int label) {
     n->label = label;
     if (label >= 0) {
-        auto f = leaves.find(label);
-        if (f != leaves.end()) f->second->label = -1;
-        leaves[n->label] = n;
+        if (label >= leaves.size()) leaves.resize(label + 1, nullptr);
+        if (leaves[label] == nullptr) ++leavesCount;
+        else if (leaves[label] != n) leaves[label]->label = -1;
+        leaves[label] = n;
     }
 }
 
@@ -115,11 +115,17 @@ public:
         else return nullptr;
     };
     inline size_t size() const { return nodes.size(); };
-    inline size_t labelsSize() const { return leaves.size(); };
+    inline size_t labelsSize() const { return leavesCount; };
+    inline TreeNode* getLeaf(int label) const {
+        if(label >= 0 && label < leaves.size()) return leaves[label];
+        else return nullptr;
+    };
+    inline bool hasLeaf(int label) const { return getLeaf(label) != nullptr; };
 
     TreeNode* root;                      // Pointer to root node
     std::vector<TreeNode*> nodes;        // Pointers to tree nodes
-    UnorderedMap<int, TreeNode*> leaves; // Leaves map;
+    std::vector<TreeNode*> leaves;       // Label to leaf index, nullptr for labels without a leaf
+    size_t leavesCount = 0;              // Number of labels with a leaf
 
     // Tree utils
     void printTree(TreeNode* rootNode = nullptr, bool printNodes = false);
@@ -67,34 +67,55 @@ void MACH::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string o
     int size = hashes.size() * bucketCount;
 
     int rows = features.rows();
-    int lCols = labels.cols();
     assert(rows == labels.rows());
 
-    std::vector<std::vector<Real>> binLabels(size);
-    for (int i = 0; i < binLabels.size(); ++i) binLabels[i].reserve(rows);
+    // Split base estimators into parts that fit into the memory limit
+    unsigned long long dataMem = labels.mem() + features.mem();
+    unsigned long long tmpDataMem = static_cast<unsigned long long>(size) * rows * sizeof(Real);
+    unsigned long long baseMem = args.threads * baseTrainingMem(features.cols(), args);
+    unsigned long long availableMem = freeMem(args);
+    unsigned long long tmpDataLimit = (availableMem > baseMem) ? availableMem - baseMem : 0;
+    Log(CERR) << "Required memory to train: " << formatMem(tmpDataMem + baseMem) << " (data: " << formatMem(dataMem)
+              << ", weights: " << formatMem(baseMem) << ", tmp data: " << formatMem(tmpDataMem) << "), available memory: " << formatMem(availableMem) << "\n";
 
-    for (int r = 0; r < rows; ++r) {
-        printProgress(r, rows);
+    int parts = std::min<unsigned long long>(size, tmpDataMem / std::max<unsigned long long>(tmpDataLimit, 1) + 1);
+    int range = size / parts + (size % parts != 0);
 
-        for (int i = 0; i < binLabels.size(); ++i) binLabels[i].push_back(0.0);
-
-        for (auto &l : labels[r]){
-            for (int j = 0; j < hashes.size(); ++j)
-                binLabels[baseForLabel(l.index, j)].back() = 1.0;
-        }
-    }
-
-
-
-    // Train bases
-    std::vector<ProblemData> binProblemData;
     std::vector<Real> binWeights(features.rows(), 1);
     std::vector<Feature*> binFeatures(features.rows());
     for(int i = 0; i < features.rows(); ++i)
         binFeatures[i] = features[i].data();
 
-    for(int i = 0; i < size; ++i) binProblemData.emplace_back(binLabels[i], binFeatures, features.cols(), binWeights);
-    trainBases(joinPath(output, "weights.bin"), binProblemData, args);
+    out.open(joinPath(output, "weights.bin"), std::ios::out | std::ios::binary);
+    saveVar(out, size);
+
+    for (int p = 0; p < parts; ++p) {
+        int bStart = p * range;
+        int bStop = std::min((p + 1) * range, size);
+
+        if (parts > 1)
+            Log(CERR) << "Assigning labels for base estimators [" << bStart << ", " << bStop << ") (" << p + 1 << "/" << parts << ") ...\n";
+        else
+            Log(CERR) << "Assigning labels for base estimators ...\n";
+
+        std::vector<std::vector<Real>> binLabels(bStop - bStart, std::vector<Real>(rows, 0.0));
+        for (int r = 0; r < rows; ++r) {
+            printProgress(r, rows);
+            for (auto &l : labels[r]) {
+                for (int j = 0; j < hashes.size(); ++j) {
+                    int b = baseForLabel(l.index, j);
+                    if (b >= bStart && b < bStop) binLabels[b - bStart][r] = 1.0;
+                }
+            }
+        }
+
+        // Train bases
+        std::vector<ProblemData> binProblemData;
+        for (int i = 0; i < binLabels.size(); ++i) binProblemData.emplace_back(binLabels[i], binFeatures, features.cols(), binWeights);
+        trainBases(out, binProblemData, args);
+    }
+
+    out.close();
 }
 
 void MACH::predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) {
@@ -136,7 +157,7 @@ Real MACH::predictForLabel(Label label, SparseVector& features, Args& args) {
 
 void MACH::load(Args& args, std::string infile) {
     Log(CERR) << "Loading weights ...\n";
-    bases = loadBases(joinPath(infile, "weights.bin"));
+    bases = loadBases(joinPath(infile, "weights.bin"), false, map, args.threads);
 
     Log(CERR) << "Loading hashes ...\n";
     std::ifstream in(joinPath(infile, "hashes.bin"));
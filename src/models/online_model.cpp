@@ -32,6 +32,14 @@ void OnlineModel::onlineTrainThread(int threadId, OnlineModel* model, SRMatrix&
     const int examples = rowsRange * args.epochs;
     for (int i = 0; i < examples; ++i) {
         if (!threadId) printProgress(i, examples);
+        if (model->memLimitExceeded || isInterrupted()) break;
+
+        // Online models grow with the number of seen labels and features, stop all threads when the memory limit is exceeded
+        if (!threadId && i % 10000 == 0 && model->freeMem(args) == 0) {
+            model->memLimitExceeded = true;
+            break;
+        }
+
         int r = startRow + i % rowsRange;
         int e = i / rowsRange;
         model->update(e, r, labels[r], features[r], args);
@@ -54,6 +62,7 @@ void OnlineModel::train(SRMatrix& labels, SRMatrix& features, Args& args, std::s
     else init(labels, features, args);
 
     // Iterate over rows
+    memLimitExceeded = false;
     Log(CERR) << "Training online for " << args.epochs << " epochs in " << args.threads << " threads ...\n";
 
     ThreadSet tSet;
@@ -62,6 +71,9 @@ void OnlineModel::train(SRMatrix& labels, SRMatrix& features, Args& args, std::s
         tSet.add(onlineTrainThread, t, this, std::ref(labels), std::ref(features), std::ref(args), t * tRows,
                  std::min((t + 1) * tRows, features.rows()));
     tSet.joinAll();
+    checkInterrupted();
+    if (memLimitExceeded)
+        throw std::runtime_error("Memory limit of " + formatMem(args.memLimit) + " exceeded during online training, increase --memLimit");
 
     // Save training output
     save(args, output);
@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "model.h"
 
 
@@ -35,6 +37,8 @@ public:
     virtual void save(Args& args, std::string output) = 0;
 
 private:
+    std::atomic<bool> memLimitExceeded;
+
     static void onlineTrainThread(int threadId, OnlineModel* model, SRMatrix& labels,
                                   SRMatrix& features, Args& args, const int startRow, const int stopRow);
 };
@@ -73,7 +73,7 @@ void OnlinePLT::update(const int epoch, const int row, SparseVector& labels, Spa
 
         if(args.threads == 1) {
             for (auto &l : labels)
-                if (!tree->leaves.count(l.index)) newLabels.push_back(l.index);
+                if (!tree->hasLeaf(l.index)) newLabels.push_back(l.index);
 
             if (!newLabels.empty()) // Expand tree in case of the new label
                 expandTree(newLabels, features, args);
@@ -81,7 +81,7 @@ void OnlinePLT::update(const int epoch, const int row, SparseVector& labels, Spa
             {
                 std::shared_lock<std::shared_timed_mutex> lock(treeMtx);
                 for (auto &l : labels)
-                    if (!tree->leaves.count(l.index)) newLabels.push_back(l.index);
+                    if (!tree->hasLeaf(l.index)) newLabels.push_back(l.index);
             }
 
             if (!newLabels.empty()) { // Expand tree in case of the new label
@@ -140,7 +140,7 @@ void OnlinePLT::load(Args& args, std::string infile){
     PLT::load(args, infile);
 
     if(args.resume){
-        auxBases = loadBases(joinPath(infile, "aux_weights.bin"), args.resume, args.loadAs);
+        auxBases = loadBases(joinPath(infile, "aux_weights.bin"), args.resume, args.loadAs, args.threads);
         assert(bases.size() == auxBases.size());
     }
 
@@ -24,39 +24,47 @@
 #include <cassert>
 #include <climits>
 #include <cmath>
+#include <filesystem>
 #include <list>
+#include <random>
 #include <vector>
 
+#include "checkpoint.h"
 #include "plt.h"
+#include "threads.h"
 
 
 PLT::PLT() {
-    nodeEvaluationCount = 0;
-    nodeUpdateCount = 0;
-    dataPointCount = 0;
     type = plt;
     name = "PLT";
     tree = nullptr;
+    cachedNodesDepth = 0;
 }
 
 void PLT::unload() {
     for (auto b : bases) delete b;
     bases.clear();
     bases.shrink_to_fit();
+    for (auto b : childrenBlocks) delete b;
+    childrenBlocks.clear();
+    nodesColumns.clear();
+    basesCache = nullptr;
     delete tree;
     tree = nullptr;
+    nodeCache = nullptr;
+    cachedNodes.clear();
+    cachedNodesPos.clear();
     Model::unload();
 }
 
 void PLT::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vector<std::vector<Feature*>>& binFeatures,
-                           std::vector<std::vector<Real>>& binWeights, SRMatrix& labels, SRMatrix& features, Args& args) {
-    Log(CERR) << "Assigning data points to nodes ...\n";
-
+                           std::vector<std::vector<Real>>& binWeights, SRMatrix& labels, SRMatrix& features, Args& args,
+                           int nStart, int nStop) {
     // Positive and negative nodes
     UnorderedSet<TreeNode*> nPositive;
     UnorderedSet<TreeNode*> nNegative;
 
-    // Gather examples for each node
+    // Gather examples for each node in [nStart, nStop) range
     int rows = features.rows();
     for (int r = 0; r < rows; ++r) {
         printProgress(r, rows);
@@ -65,24 +73,44 @@ void PLT::assignDataPoints(std::vector<std::vector<Real>>& binLabels, std::vecto
         nNegative.clear();
 
         getNodesToUpdate(nPositive, nNegative, labels[r]);
-        addNodesLabelsAndFeatures(binLabels, binFeatures, nPositive, nNegative, features[r]);
+        addNodesLabelsAndFeatures(binLabels, binFeatures, nPositive, nNegative, features[r], nStart, nStop);
+    }
+}
+
+std::vector<unsigned long long> PLT::countDataPoints(SRMatrix& labels, Args& args) {
+    Log(CERR) << "Counting data points for nodes ...\n";
+
+    std::vector<unsigned long long> nodesCounts(tree->size(), 0);
+
+    // Positive and negative nodes
+    UnorderedSet<TreeNode*> nPositive;
+    UnorderedSet<TreeNode*> nNegative;
+
+    int rows = labels.rows();
+    for (int r = 0; r < rows; ++r) {
+        printProgress(r, rows);
+
+        nPositive.clear();
+        nNegative.clear();
+
+        getNodesToUpdate(nPositive, nNegative, labels[r]);
+        for (const auto& n : nPositive) ++nodesCounts[n->index];
+        for (const auto& n : nNegative) ++nodesCounts[n->index];
 
-        nodeUpdateCount += nPositive.size() + nNegative.size();
-        ++dataPointCount;
+        stats.local().addNodeUpdates(nPositive.size() + nNegative.size());
+        stats.local().addDataPoints();
     }
 
-    unsigned long long usedMem = nodeUpdateCount * (sizeof(Real) + sizeof(Feature*)) + binLabels.size() * (sizeof(binLabels) + sizeof(binFeatures));
-    Log(CERR) << "  Temporary data size: " << formatMem(usedMem) << "\n";
+    return nodesCounts;
 }
 
 void PLT::getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, const SparseVector& labels) {
     for (auto &l : labels) {
-        auto ni = tree->leaves.find(l.index);
-        if (ni == tree->leaves.end()) {
+        TreeNode* n = tree->getLeaf(l.index);
+        if (n == nullptr) {
             Log(CERR) << "Encountered example with label " << l.index << " that does not exists in the tree\n";
             continue;
         }
-        TreeNode* n = ni->second;
         nPositive.insert(n);
         while (n->parent) {
             n = n->parent;
@@ -105,17 +133,108 @@ void PLT::getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<Tree
 
 void PLT::addNodesLabelsAndFeatures(std::vector<std::vector<Real>>& binLabels, std::vector<std::vector<Feature*>>& binFeatures,
                       UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative,
-                      SparseVector& features) {
+                      SparseVector& features, int nStart, int nStop) {
     Feature* featuresData = features.data();
 
     for (const auto& n : nPositive) {
-        binLabels[n->index].push_back(1.0);
-        binFeatures[n->index].push_back(featuresData);
+        if (n->index < nStart || n->index >= nStop) continue;
+        binLabels[n->index - nStart].push_back(1.0);
+        binFeatures[n->index - nStart].push_back(featuresData);
     }
 
     for (const auto& n : nNegative) {
-        binLabels[n->index].push_back(0.0);
-        binFeatures[n->index].push_back(featuresData);
+        if (n->index < nStart || n->index >= nStop) continue;
+        binLabels[n->index - nStart].push_back(0.0);
+        binFeatures[n->index - nStart].push_back(featuresData);
+    }
+}
+
+void PLT::sampleNegatives(std::vector<std::vector<Real>>& binLabels, std::vector<std::vector<Feature*>>& binFeatures,
+                          std::vector<std::vector<Real>>& binWeights, Args& args, int nStart) {
+    Log(CERR) << "Sampling negative examples ...\n";
+
+    unsigned long long negatives = 0, keptNegatives = 0, keptUpdates = 0;
+
+    int nodes = binLabels.size();
+    for (int i = 0; i < nodes; ++i) {
+        printProgress(i, nodes);
+
+        auto& nLabels = binLabels[i];
+        auto& nFeatures = binFeatures[i];
+        auto& nWeights = binWeights[i];
+        int size = nLabels.size();
+        if (nWeights.empty()) nWeights.resize(size, 1);
+
+        int nNegatives = std::count(nLabels.begin(), nLabels.end(), 0.0);
+        int nPositives = size - nNegatives;
+        negatives += nNegatives;
+
+        // Number of negatives to keep for this node
+        long long toKeep = nNegatives;
+        if (args.negSamplingRatio > 0)
+            toKeep = std::min<long long>(toKeep, std::ceil(args.negSamplingRatio * std::max(nPositives, 1)));
+        if (args.negSamplingMax > 0)
+            toKeep = std::min<long long>(toKeep, args.negSamplingMax);
+
+        if (toKeep < nNegatives) {
+            // Each node has its own seed, so its negatives do not depend on the other sampled nodes
+            std::seed_seq seed{args.seed, nStart + i};
+            std::default_random_engine rng(seed);
+
+            // Selection sampling keeps the original order of examples
+            Real negWeight = static_cast<Real>(nNegatives) / toKeep;
+            long long negSeen = 0, negKept = 0;
+            int j = 0;
+            for (int k = 0; k < size; ++k) {
+                if (nLabels[k] == 0.0) {
+                    std::uniform_int_distribution<long long> dist(0, nNegatives - negSeen - 1);
+                    ++negSeen;
+                    if (dist(rng) >= toKeep - negKept) continue;
+                    ++negKept;
+                    nWeights[k] *= negWeight;
+                }
+                nLabels[j] = nLabels[k];
+                nFeatures[j] = nFeatures[k];
+                nWeights[j] = nWeights[k];
+                ++j;
+            }
+
+            nLabels.resize(j);
+            nLabels.shrink_to_fit();
+            nFeatures.resize(j);
+            nFeatures.shrink_to_fit();
+            nWeights.resize(j);
+            nWeights.shrink_to_fit();
+        }
+
+        keptNegatives += std::min<long long>(toKeep, nNegatives);
+        keptUpdates += nLabels.size();
+    }
+
+    unsigned long long usedMem = keptUpdates * (2 * sizeof(Real) + sizeof(Feature*)) + binLabels.size() * (sizeof(binLabels) + sizeof(binFeatures) + sizeof(binWeights));
+    Log(CERR) << "  Kept negative examples: " << keptNegatives << " / " << negatives << " ("
+              << (negatives ? 100.0 * keptNegatives / negatives : 100.0) << "%)\n"
+              << "  Temporary data size after sampling: " << formatMem(usedMem) << "\n";
+}
+
+void PLT::initCaches(Args& args) {
+    Model::initCaches(args);
+    if (args.nodeCache > 0 && args.nodeCacheDepth > 0 && nodeCache == nullptr && tree != nullptr && type != hsm) {
+        // Nodes above the cached depth in breadth-first order, values of nodes are kept in the cache in the same order
+        cachedNodesPos.assign(tree->size(), -1);
+        std::vector<TreeNode*> level = {tree->root};
+        std::vector<TreeNode*> nextLevel;
+        for (int d = 0; d < args.nodeCacheDepth && !level.empty(); ++d) {
+            for (auto& n : level) {
+                cachedNodesPos[n->index] = cachedNodes.size();
+                cachedNodes.push_back(n);
+                nextLevel.insert(nextLevel.end(), n->children.begin(), n->children.end());
+            }
+            level.swap(nextLevel);
+            nextLevel.clear();
+        }
+        cachedNodesDepth = args.nodeCacheDepth;
+        nodeCache = std::make_shared<FeaturesCache<std::vector<Real>>>(args.nodeCache);
     }
 }
 
@@ -125,126 +244,247 @@ std::vector<std::vector<Prediction>> PLT::predictBatch(SRMatrix& features, Args&
     else throw std::invalid_argument("Unknown tree search type");
 }
 
-std::vector<std::vector<Prediction>> PLT::predictWithBeamSearch(SRMatrix& features, Args& args){
-    Log(CERR) << "Starting prediction in 1 thread ...\n";
+void PLT::beamSearchThread(int threadId, PLT* model, std::vector<BeamSearchItem>& items, std::atomic<int>& nextItem,
+                           SRMatrix& features, const Real* hidden, Args& args){
+    std::vector<TreeNode*> rootGroup = {model->tree->root};
+    std::vector<Real> scores;
+    Vector* tmpW = nullptr; // Thread's own buffer for unpacked weights
+
+    for(int i = nextItem++; i < items.size() && !isInterrupted(); i = nextItem++){
+        auto& item = items[i];
+        auto& children = item.node ? item.node->children : rootGroup;
+        auto& entries = *item.entries;
+        int k = children.size();
+        int size = item.stop - item.start;
+        scores.resize(size * k);
+
+        model->beamSearchScore(item, children, features, hidden, scores.data(), tmpW, args);
+
+        item.results.clear();
+        item.results.reserve(size * k);
+        for(int e = 0; e < size; ++e){
+            auto& entry = entries[item.start + e];
+            Real* nodeScores = scores.data() + e * k;
+            if(item.node) model->scoresToProbabilities(item.node, nodeScores);
+
+            for(int c = 0; c < k; ++c){
+                Real prob = entry.value * nodeScores[c];
+                Real value = prob;
+
+                // Reweight score
+                if (!model->labelsWeights.empty()) value *= model->nodesWeights[children[c]->index].weight;
+
+                item.results.push_back({entry.label, {children[c], prob, value}});
+            }
+        }
+    }
+
+    delete tmpW;
+}
+
+void PLT::beamSearchScore(BeamSearchItem& item, std::vector<TreeNode*>& children, SRMatrix& features, const Real* hidden,
+                          Real* scores, Vector*& tmpW, Args& args){
+    auto& entries = *item.entries;
+    int k = children.size();
+    int size = item.stop - item.start;
+    ThreadStats& stats = this->stats.local();
+
+    SiblingsBlock* block = item.node ? getChildrenBlock(item.node) : nullptr;
+    if(block != nullptr){
+        // Packed children are scored together with one pass over features of each row
+        for(int e = 0; e < size; ++e){
+            Real* rowScores = scores + e * k;
+            block->predictValues(features[entries[item.start + e].label], rowScores);
+            blockValuesToScores(item.node, block, rowScores);
+        }
+        for(auto& child : children)
+            if(isScoredInBeamSearch(child)) stats.addNodeEvaluations(child->index, size);
+    }
+    else {
+        // Score rows child by child, so weights of each child have to be unpacked only once
+        for(int c = 0; c < k; ++c){
+            TreeNode* child = children[c];
+            if(!isScoredInBeamSearch(child)) continue;
+
+            BaseRef base = getBase(child->index);
+            AbstractVector* W = base->getW();
+            bool unpack = W != nullptr && base->getType() == sparse && args.beamSearchUnpack;
+            if(unpack){
+                if(tmpW == nullptr || tmpW->size() < W->size()){
+                    delete tmpW;
+                    tmpW = new Vector(std::max(W->size(), static_cast<size_t>(features.cols())));
+                }
+                tmpW->add(*W);
+                W = tmpW;
+            }
+
+            for(int e = 0; e < size; ++e)
+                scores[e * k + c] = predictScoreForNode(child, base.get(), features[entries[item.start + e].label], W);
+            stats.addNodeEvaluations(child->index, size);
+
+            if(unpack) tmpW->zero(*base->getW());
+        }
+    }
+}
+
+void PLT::beamSearchMergeThread(PLT* model, std::vector<BeamSearchItem>& items, std::vector<std::vector<Prediction>>& prediction,
+                                std::vector<std::vector<TreeNodeValue>>& levelPredictions, Args& args, int startRow, int stopRow){
+    auto& thresholds = model->thresholds;
+    auto& nodesThr = model->nodesThr;
+
+    // Results of each item are sorted by rows, so the thread can find its range using binary search
+    for(auto& item : items){
+        auto& results = item.results;
+        auto it = std::lower_bound(results.begin(), results.end(), startRow,
+                                   [](const std::pair<int, TreeNodeValue>& r, int row){ return r.first < row; });
+        for(; it != results.end() && it->first < stopRow; ++it){
+            auto& nv = it->second;
+            if(nv.node->label >= 0){ // Label prediction
+                bool belowThreshold = (args.threshold > 0 && nv.prob < args.threshold)
+                                      || (!thresholds.empty() && nv.prob < nodesThr[nv.node->index].th);
+                if(!belowThreshold) prediction[it->first].emplace_back(nv.node->label, nv.value);
+            }
+            if(!nv.node->children.empty()) levelPredictions[it->first].push_back(nv); // Internal node prediction
+        }
+    }
+
+    // Keep top predictions
+    for(int rIdx = startRow; rIdx < stopRow; ++rIdx){
+        auto &v = levelPredictions[rIdx];
+
+        if(!thresholds.empty()){
+            int j = 0;
+            for(int i = 0; i < v.size(); ++i){
+                if(v[i].value > nodesThr[v[i].node->index].th)
+                    v[j++] = v[i];
+            }
+            v.resize(j);
+        }
+        else {
+            std::sort(v.rbegin(), v.rend());
+
+            if(args.threshold > 0){
+                int i = 0;
+                while (i < v.size() && v[i].value > args.threshold) ++i;
+                v.resize(i);
+            }
+            else v.resize(std::min(v.size(), (size_t)args.beamSearchWidth));
+        }
+    }
+}
+
+std::vector<std::vector<Prediction>> PLT::predictWithBeamSearch(SRMatrix& features, Args& args, const Real* hidden){
+    Log(CERR) << "Starting prediction in " << args.threads << " threads ...\n";
 
     int rows = features.rows();
     int nodes = tree->nodes.size();
+    int threads = args.threads;
+    int chunkSize = std::max(256, rows / (4 * threads));
 
     std::vector<std::vector<Prediction>> prediction(rows);
     std::vector<std::vector<TreeNodeValue>> levelPredictions(rows);
     std::vector<std::vector<Prediction>> nodePredictions(nodes);
+    std::vector<Prediction> rootPredictions;
+    for(int i = 0; i < rows; ++i) rootPredictions.emplace_back(i, 1.0);
 
-    auto nextLevelQueue = new std::queue<TreeNode*>();
-    nextLevelQueue->push(tree->root);
-    for(int i = 0; i < rows; ++i) nodePredictions[tree->root->index].emplace_back(i, 1.0);
-    AbstractVector* tmpW = new Vector(features.cols());
-    AbstractVector* originalW = nullptr;
+    // Level is a list of nodes which children are evaluated, nullptr stands for evaluation of the root itself
+    std::vector<TreeNode*> level = {nullptr};
+    std::vector<TreeNode*> nextLevel;
+    std::vector<BeamSearchItem> items;
 
     int nCount = 0;
-    while(!nextLevelQueue->empty()){
-
-        auto levelQueue = nextLevelQueue;
-        nextLevelQueue = new std::queue<TreeNode*>();
+    int tRows = ceil(static_cast<Real>(rows) / threads);
+    while(!level.empty()){
+
+        // Split rows of each node into work items
+        items.clear();
+        for(auto& n : level){
+            auto& entries = n ? nodePredictions[n->index] : rootPredictions;
+            for(int start = 0; start < entries.size(); start += chunkSize)
+                items.push_back({n, &entries, start, std::min(start + chunkSize, static_cast<int>(entries.size())), {}});
+        }
 
         // Predict for level
-        while(!levelQueue->empty()){
+        std::atomic<int> nextItem(0);
+        ThreadSet tSet;
+        for (int t = 0; t < threads; ++t)
+            tSet.add(beamSearchThread, t, this, std::ref(items), std::ref(nextItem), std::ref(features), hidden, std::ref(args));
+        tSet.joinAll();
+        checkInterrupted();
+
+        // Gather predictions for each row
+        for (int t = 0; t < threads; ++t)
+            tSet.add(beamSearchMergeThread, this, std::ref(items), std::ref(prediction), std::ref(levelPredictions),
+                     std::ref(args), t * tRows, std::min((t + 1) * tRows, rows));
+        tSet.joinAll();
+
+        // Prepare next level
+        for(auto& n : level) {
+            if(n) nodePredictions[n->index].clear();
+            else rootPredictions.clear();
             printProgress(nCount++, nodes);
-
-            auto n = levelQueue->front();
-            levelQueue->pop();
-            int nIdx = n->index;
-
-            if(!nodePredictions[nIdx].empty()){
-                auto base = bases[nIdx];
-                auto type = base->getType();
-                if(type == sparse && args.beamSearchUnpack){
-                    originalW = base->getW();
-                    tmpW->add(*originalW);
-                    base->setW(tmpW);
-                }
-
-                for(auto &e : nodePredictions[nIdx]){
-                    int rIdx = e.label;
-                    Real prob = bases[nIdx]->predictProbability(features[rIdx]) * e.value;
-                    Real value = prob;
-
-                    // Reweight score
-                    if (!labelsWeights.empty()) value *= nodesWeights[nIdx].weight;
-
-                    if(n->label >= 0) prediction[rIdx].emplace_back(n->label, value); // Label prediction
-                    if(n->children.size() > 0) levelPredictions[rIdx].emplace_back(n, prob, value); // Internal node prediction
-                }
-                nodeEvaluationCount += nodePredictions[nIdx].size();
-                nodePredictions[nIdx].clear();
-
-                if(type == sparse && args.beamSearchUnpack){
-                    tmpW->zero(*originalW);
-                    base->setW(originalW);
-                }
-            }
-
-            for(auto &c : n->children)
-                nextLevelQueue->push(c);
         }
-        delete levelQueue;
 
-        // Keep top predictions and prepare next level
+        nextLevel.clear();
         for(int rIdx = 0; rIdx < rows; ++rIdx){
-            auto &v = levelPredictions[rIdx];
-
-            if(!thresholds.empty()){
-                int j = 0;
-                for(int i = 0; i < v.size(); ++i){
-                    if(v[i].value > nodesThr[v[i].node->index].th)
-                        v[j++] = v[i];
-                }
-                v.resize(j - 1);
-            }
-            else {
-                std::sort(v.rbegin(), v.rend());
-
-                if(args.threshold > 0){
-                    int i = 0;
-                    while (i < v.size() && v[i++].value > args.threshold);
-                    v.resize(i - 1);
-                }
-                else v.resize(std::min(v.size(), (size_t)args.beamSearchWidth));
+            for(auto &nv : levelPredictions[rIdx]){
+                auto& entries = nodePredictions[nv.node->index];
+                if(entries.empty()) nextLevel.push_back(nv.node);
+                entries.emplace_back(rIdx, nv.prob);
             }
-
-            for(auto &nv : v)
-                for(auto &c : nv.node->children)
-                    nodePredictions[c->index].emplace_back(rIdx, nv.prob);
-            v.clear();
+            levelPredictions[rIdx].clear();
         }
+        level.swap(nextLevel);
     }
-    delete nextLevelQueue;
-    delete tmpW;
 
     for(int rIdx = 0; rIdx < rows; ++rIdx){
         auto &v = prediction[rIdx];
         std::sort(v.rbegin(), v.rend());
+        if(args.topK > 0 && v.size() > args.topK) v.resize(args.topK);
     }
 
-    dataPointCount = rows;
+    stats.local().addDataPoints(rows);
     return prediction;
 }
 
 void PLT::predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) {
-    int topK = args.topK;
-    Real threshold = args.threshold;
+    if (nodeCache != nullptr) {
+        // Values of nodes of top levels do not depend on top k, thresholds and labels weights,
+        // so they are reused by all queries with the same features, the search continues from the frontier nodes
+        std::vector<Real> nodesValues;
+        if (!nodeCache->get(features, cachedNodesDepth, nodesValues)) {
+            ThreadStats& stats = this->stats.local();
+            nodesValues.resize(cachedNodes.size());
+            for (int i = 0; i < cachedNodes.size(); ++i) {
+                nodesValues[i] = predictForNode(cachedNodes[i], features);
+                stats.addNodeEvaluations(cachedNodes[i]->index);
+            }
+            nodeCache->put(features, cachedNodesDepth, nodesValues);
+        }
 
-    if(topK > 0) prediction.reserve(topK);
-    TopKQueue<TreeNodeValue> nQueue(args.topK);
+        std::vector<TreeNodeValue> frontier;
+        predictTopLevels(prediction, frontier, features, cachedNodesDepth, args, &nodesValues);
+        std::vector<Prediction> frontierPrediction;
+        predictFromNodes(frontierPrediction, features, frontier, args);
+        prediction.insert(prediction.end(), frontierPrediction.begin(), frontierPrediction.end());
+        std::sort(prediction.rbegin(), prediction.rend());
+        if (args.topK > 0 && prediction.size() > args.topK) prediction.resize(args.topK);
+    } else {
+        std::vector<TreeNodeValue> startNodes = {{tree->root, 1.0}};
+        predictFromNodes(prediction, features, startNodes, args);
+    }
+    stats.local().addDataPoints();
+}
 
+void PLT::setPredictionFunctions(std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue, Args& args) {
+    Real threshold = args.threshold;
 
-    // Set functions
-    std::function<bool(TreeNode*, Real)> ifAddToQueue = [&] (TreeNode* node, Real prob) {
+    ifAddToQueue = [] (TreeNode* node, Real prob) {
         return true;
     };
 
-    if(args.threshold > 0)
-        ifAddToQueue = [&] (TreeNode* node, Real prob) {
+    if(threshold > 0)
+        ifAddToQueue = [threshold] (TreeNode* node, Real prob) {
             return (prob >= threshold);
         };
     else if(thresholds.size())
@@ -252,7 +492,7 @@ void PLT::predict(std::vector<Prediction>& prediction, SparseVector& features, A
             return (prob >= nodesThr[node->index].th);
         };
 
-    std::function<Real(TreeNode*, Real)> calculateValue = [&] (TreeNode* node, Real prob) {
+    calculateValue = [] (TreeNode* node, Real prob) {
         return prob;
     };
 
@@ -260,12 +500,26 @@ void PLT::predict(std::vector<Prediction>& prediction, SparseVector& features, A
         calculateValue = [&] (TreeNode* node, Real prob) {
             return prob * nodesWeights[node->index].weight;
         };
+}
+
+void PLT::predictFromNodes(std::vector<Prediction>& prediction, SparseVector& features, std::vector<TreeNodeValue>& startNodes, Args& args) {
+    int topK = args.topK;
 
-    // Predict for root
-    Real rootProb = predictForNode(tree->root, features);
-    addToQueue(ifAddToQueue, calculateValue, nQueue, tree->root, rootProb);
-    ++nodeEvaluationCount;
-    ++dataPointCount;
+    if(topK > 0) prediction.reserve(topK);
+    TopKQueue<TreeNodeValue> nQueue(args.topK);
+
+    // Set functions
+    std::function<bool(TreeNode*, Real)> ifAddToQueue;
+    std::function<Real(TreeNode*, Real)> calculateValue;
+    setPredictionFunctions(ifAddToQueue, calculateValue, args);
+
+    // Predict for start nodes, their prob is the probability of their parent
+    ThreadStats& stats = this->stats.local();
+    for(auto& n : startNodes) {
+        Real prob = n.prob * predictForNode(n.node, features);
+        addToQueue(ifAddToQueue, calculateValue, nQueue, n.node, prob);
+        stats.addNodeEvaluations(n.node->index);
+    }
 
     Prediction p = predictNextLabel(ifAddToQueue, calculateValue, nQueue, features);
     while ((prediction.size() < topK || topK == 0) && p.label != -1) {
@@ -274,6 +528,40 @@ void PLT::predict(std::vector<Prediction>& prediction, SparseVector& features, A
     }
 }
 
+void PLT::predictTopLevels(std::vector<Prediction>& prediction, std::vector<TreeNodeValue>& frontier, SparseVector& features, int depth, Args& args,
+                           const std::vector<Real>* nodesValues) {
+    std::function<bool(TreeNode*, Real)> ifAddToQueue;
+    std::function<Real(TreeNode*, Real)> calculateValue;
+    setPredictionFunctions(ifAddToQueue, calculateValue, args);
+
+    // Values of nodes are taken from the node cache if given
+    ThreadStats& stats = this->stats.local();
+    auto nodeValue = [&](TreeNode* n) {
+        if (nodesValues != nullptr) return (*nodesValues)[cachedNodesPos[n->index]];
+        stats.addNodeEvaluations(n->index);
+        return predictForNode(n, features);
+    };
+
+    // Evaluate all nodes above given depth that pass the thresholds
+    std::vector<TreeNodeValue> level = {{tree->root, nodeValue(tree->root)}};
+    std::vector<TreeNodeValue> nextLevel;
+    for(int d = 0; d < depth && !level.empty(); ++d) {
+        for (auto& nv : level) {
+            if (!ifAddToQueue(nv.node, nv.prob)) continue;
+            if (nv.node->label >= 0) prediction.emplace_back(nv.node->label, calculateValue(nv.node, nv.prob));
+            for (auto& child : nv.node->children) {
+                if (d + 1 == depth) frontier.emplace_back(child, nv.prob);
+                else nextLevel.emplace_back(child, nv.prob * nodeValue(child));
+            }
+        }
+        level.swap(nextLevel);
+        nextLevel.clear();
+    }
+
+    std::sort(prediction.rbegin(), prediction.rend());
+    if (args.topK > 0 && prediction.size() > args.topK) prediction.resize(args.topK);
+}
+
 Prediction PLT::predictNextLabel(
     std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue,
     TopKQueue<TreeNodeValue>& nQueue, SparseVector& features) {
@@ -282,9 +570,24 @@ Prediction PLT::predictNextLabel(
         nQueue.pop();
 
         if (!nVal.node->children.empty()) {
-            for (const auto& child : nVal.node->children)
-                addToQueue(ifAddToQueue, calculateValue, nQueue, child, nVal.prob * predictForNode(child, features));
-            nodeEvaluationCount += nVal.node->children.size();
+            ThreadStats& stats = this->stats.local();
+            SiblingsBlock* block = getChildrenBlock(nVal.node);
+            if (block != nullptr) {
+                // All children are evaluated with one pass over the features
+                thread_local std::vector<Real> values;
+                values.resize(block->size());
+                block->predictValues(features, values.data());
+                for (int c = 0; c < values.size(); ++c) {
+                    TreeNode* child = nVal.node->children[c];
+                    addToQueue(ifAddToQueue, calculateValue, nQueue, child, nVal.prob * block->toProbability(c, values[c]));
+                    stats.addNodeEvaluations(child->index);
+                }
+            } else {
+                for (const auto& child : nVal.node->children) {
+                    addToQueue(ifAddToQueue, calculateValue, nQueue, child, nVal.prob * predictForNode(child, features));
+                    stats.addNodeEvaluations(child->index);
+                }
+            }
         }
         if (nVal.node->label >= 0) return {nVal.node->label, nVal.value};
     }
@@ -299,10 +602,10 @@ void PLT::calculateNodesLabels(){
         nodesLabels.clear();
         nodesLabels.resize(tree->size());
 
-        for (auto& l : tree->leaves) {
-            TreeNode* n = l.second;
+        for (int l = 0; l < tree->leaves.size(); ++l) {
+            TreeNode* n = tree->leaves[l];
             while (n != nullptr) {
-                nodesLabels[n->index].push_back(l.first);
+                nodesLabels[n->index].push_back(l);
                 n = n->parent;
             }
         }
@@ -351,34 +654,45 @@ void PLT::setLabelsWeights(std::vector<Real> lw){
     for (auto& n : tree->nodes) setNodeWeight(n);
 }
 
-void PLT::updateThresholds(UnorderedMap<int, Real> thToUpdate){
-    for(auto& th : thToUpdate)
-        thresholds[th.first] = th.second;
+void PLT::updateThresholds(const UnorderedMap<int, Real>& thToUpdate){
+    Model::updateThresholds(thToUpdate);
 
+    // Threshold of a node is the minimum of thresholds of its labels, so only nodes on the paths
+    // from updated leaves to the root change. Each of them is recomputed once from its children, the deepest first.
+    std::vector<std::pair<int, TreeNode*>> toUpdate;
+    UnorderedSet<int> added;
     for(auto& th : thToUpdate){
-        TreeNode* n = tree->leaves[th.first];
-        TreeNodeThrExt& nTh = nodesThr[n->index];
-        while(n != tree->root){
-            if(th.second < nTh.th){
-                nTh.th = th.second;
-                nTh.label = th.first;
-            } else if (th.first == nTh.label && th.second > nTh.th){
-                setNodeThreshold(n);
-            }
-            n = n->parent;
+        for(TreeNode* n = tree->getLeaf(th.first); n != nullptr && added.insert(n->index).second; n = n->parent)
+            toUpdate.emplace_back(0, n);
+    }
+    for(auto& u : toUpdate)
+        for(TreeNode* n = u.second->parent; n != nullptr; n = n->parent) ++u.first;
+    std::sort(toUpdate.begin(), toUpdate.end(), [](const std::pair<int, TreeNode*>& a, const std::pair<int, TreeNode*>& b) {
+        return a.first > b.first;
+    });
+
+    for(auto& u : toUpdate){
+        TreeNode* n = u.second;
+        if(n->children.empty()) setNodeThreshold(n);
+        else {
+            TreeNodeThrExt& nTh = nodesThr[n->index];
+            nTh.th = 1;
+            for(auto& c : n->children)
+                if(nodesThr[c->index].th < nTh.th) nTh = nodesThr[c->index];
         }
     }
 }
 
 Real PLT::predictForLabel(Label label, SparseVector& features, Args& args) {
-    auto fn = tree->leaves.find(label);
-    if(fn == tree->leaves.end()) return 0;
-    TreeNode* n = fn->second;
-    Real value = bases[n->index]->predictProbability(features);
+    TreeNode* n = tree->getLeaf(label);
+    if(n == nullptr) return 0;
+    Real value = predictForNode(n, features);
+    ThreadStats& stats = this->stats.local();
+    stats.addNodeEvaluations(n->index);
     while (n->parent) {
         n = n->parent;
         value *= predictForNode(n, features);
-        ++nodeEvaluationCount;
+        stats.addNodeEvaluations(n->index);
     }
 
     if(!labelsWeights.empty())
@@ -391,29 +705,112 @@ void PLT::preload(Args& args, std::string infile){
     delete tree;
     tree = new LabelTree();
     tree->loadFromFile(joinPath(infile, "tree.bin"));
+    initStats(args);
     preloaded = true;
 }
 
+void PLT::initStats(Args& args){
+    // Depth of each node for per-depth counters
+    std::vector<int> nodesDepth(tree->size(), 0);
+    std::vector<TreeNode*> level = {tree->root};
+    std::vector<TreeNode*> nextLevel;
+    for(int d = 0; !level.empty(); ++d){
+        for(auto& n : level){
+            nodesDepth[n->index] = d;
+            nextLevel.insert(nextLevel.end(), n->children.begin(), n->children.end());
+        }
+        level.swap(nextLevel);
+        nextLevel.clear();
+    }
+    stats.setNodes(nodesDepth, args.nodeStats);
+}
+
 void PLT::load(Args& args, std::string infile) {
     Log(CERR) << "Loading " << name << " model ...\n";
 
     preload(args, infile);
-    bases = loadBases(joinPath(infile, "weights.bin"), args.resume, args.loadAs);
+    std::string weightsFile = joinPath(infile, "weights.bin");
+    if (args.lazyLoading && !args.resume) {
+        // Only bases of the top levels are loaded now, the other ones on their first use
+        basesCache = std::make_shared<BasesCache>(weightsFile, args.basesCacheMem, args.loadAs);
+        std::vector<bool> pinned(tree->size(), false);
+        for (auto& n : tree->nodes) pinned[n->index] = tree->getNodeDepth(n) <= args.pinLevels; // Root is at depth 1
+        bases = basesCache->loadPinned(pinned);
+    } else bases = loadBases(weightsFile, args.resume, args.loadAs, args.threads);
 
     assert(bases.size() == tree->nodes.size());
     m = tree->getNumberOfLeaves();
 
+    if (args.siblingBlocks && !args.resume) {
+        if (basesCache != nullptr) Log(CERR) << "Sibling blocks are not used with lazy loading\n";
+        else packSiblings(args);
+    }
+
     loaded = true;
 }
 
+void PLT::packSiblings(Args& args) {
+    Log(CERR) << "Packing siblings into blocks ...\n";
+
+    int size = tree->nodes.size();
+    childrenBlocks.resize(size, nullptr);
+    nodesColumns.resize(size, -1);
+    int blocksCount = 0, denseCount = 0, packedCount = 0;
+    unsigned long long basesMem = 0, blocksMem = 0;
+    std::vector<Base*> childrenBases;
+    for (int i = 0; i < size; ++i) {
+        printProgress(i, size);
+        TreeNode* n = tree->nodes[i];
+        if (n->children.empty()) continue;
+
+        childrenBases.clear();
+        for (auto& c : n->children) childrenBases.push_back(bases[c->index]);
+        SiblingsBlock* block = SiblingsBlock::pack(childrenBases, args.siblingBlocksMinFill);
+        if (block == nullptr) continue;
+
+        childrenBlocks[n->index] = block;
+        for (int c = 0; c < n->children.size(); ++c) {
+            int index = n->children[c]->index;
+            nodesColumns[index] = c;
+            basesMem += bases[index]->mem();
+            delete bases[index];
+            bases[index] = nullptr;
+        }
+
+        ++blocksCount;
+        if (block->isDense()) ++denseCount;
+        packedCount += n->children.size();
+        blocksMem += block->mem();
+    }
+
+    Log(CERR) << "  Packed nodes: " << packedCount << "/" << size << ", blocks: " << blocksCount << " (dense: " << denseCount
+              << "), size: " << formatMem(basesMem) << " -> " << formatMem(blocksMem) << "\n";
+}
+
 void PLT::printInfo() {
     Log(COUT) << name << " additional stats:"
               << "\n  Tree size: " << tree->nodes.size()
               << "\n  Tree depth: " << tree->getTreeDepth() << "\n";
-    if(nodeUpdateCount > 0)
-        Log(COUT) << "  Updated estimators / data point: " << static_cast<Real>(nodeUpdateCount) / dataPointCount << "\n";
-    if(nodeEvaluationCount > 0)
-        Log(COUT) << "  Evaluated estimators / data point: " << static_cast<Real>(nodeEvaluationCount) / dataPointCount << "\n";
+    auto summary = getStats();
+    if(summary.nodeUpdates > 0)
+        Log(COUT) << "  Updated estimators / data point: " << static_cast<Real>(summary.nodeUpdates) / summary.dataPoints << "\n";
+    if(summary.nodeEvaluations > 0)
+        Log(COUT) << "  Evaluated estimators / data point: " << static_cast<Real>(summary.nodeEvaluations) / summary.dataPoints << "\n";
+}
+
+std::vector<std::pair<std::string, unsigned long long>> PLT::getCacheStats() {
+    auto stats = Model::getCacheStats();
+    if (nodeCache != nullptr) {
+        stats.emplace_back("node_cache_hits", nodeCache->hits());
+        stats.emplace_back("node_cache_misses", nodeCache->misses());
+    }
+    if (basesCache != nullptr) {
+        stats.emplace_back("bases_cache_hits", basesCache->hits());
+        stats.emplace_back("bases_cache_misses", basesCache->misses());
+        stats.emplace_back("bases_cache_evictions", basesCache->evictions());
+        stats.emplace_back("bases_cache_mem", basesCache->mem());
+    }
+    return stats;
 }
 
 void PLT::buildTree(SRMatrix& labels, SRMatrix& features, Args& args, std::string output){
@@ -496,31 +893,116 @@ std::vector<std::tuple<int, int, int>> PLT::getTreeStructure(){
 }
 
 void BatchPLT::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
+    // Resumed training has to use the same tree as the checkpoint
+    if(!tree && args.resume && args.checkpoint > 0 && std::filesystem::exists(joinPath(output, "tree.bin"))) {
+        Log(CERR) << "Loading tree to resume training ...\n";
+        preload(args, output);
+        m = tree->getNumberOfLeaves();
+    }
     if(!tree) buildTree(labels, features, args, output);
 
     Log(CERR) << "Training tree ...\n";
 
-    // Examples selected for each node
-    std::vector<std::vector<Real>> binLabels(tree->size());
-    std::vector<std::vector<Feature*>> binFeatures(tree->size());
-    std::vector<std::vector<Real>> binWeights;
+    bool negSampling = args.negSamplingRatio > 0 || args.negSamplingMax > 0;
+    bool nodesWeights = (type == hsm && args.pickOneLabelWeighting) || negSampling;
 
-    if (type == hsm && args.pickOneLabelWeighting) binWeights.resize(tree->size());
-    else binWeights.emplace_back(features.rows(), 1);
+    // Calculate required memory and split nodes into parts that fit into the memory limit
+    std::vector<unsigned long long> nodesCounts = countDataPoints(labels, args);
+    std::vector<std::pair<int, int>> parts = splitNodesIntoParts(nodesCounts, features.cols(), nodesWeights, args);
+
+    std::string weightsFile = joinPath(output, "weights.bin");
+    std::ofstream out(weightsFile, std::ios::out | std::ios::binary);
+    int size = tree->size();
+    saveVar(out, size);
+    std::shared_ptr<BasesCheckpoint> checkpoint = createCheckpoint(weightsFile, checkpointFingerprint(labels, features, args), args);
+
+    for (int p = 0; p < parts.size(); ++p) {
+        int nStart = parts[p].first;
+        int nStop = parts[p].second;
+        int range = nStop - nStart;
+
+        // Skip the whole part if it is already in the checkpoint
+        if (checkpoint && checkpoint->countTrained(nStart, nStop) == range) {
+            Log(CERR) << "Base estimators for nodes [" << nStart << ", " << nStop << ") already trained in the checkpoint\n";
+            checkpoint->copyTo(out, nStart, nStop);
+            continue;
+        }
 
-    assignDataPoints(binLabels, binFeatures, binWeights, labels, features, args);
+        if (parts.size() > 1)
+            Log(CERR) << "Assigning data points to nodes [" << nStart << ", " << nStop << ") (" << p + 1 << "/" << parts.size() << ") ...\n";
+        else
+            Log(CERR) << "Assigning data points to nodes ...\n";
 
-    // Train bases
-    std::vector<ProblemData> binProblemData;
-    if (type == hsm && args.pickOneLabelWeighting)
-        for(int i = 0; i < tree->size(); ++i) binProblemData.emplace_back(binLabels[i], binFeatures[i], features.cols(), binWeights[i]);
-    else
-        for (int i = 0; i < tree->size(); ++i) binProblemData.emplace_back(binLabels[i], binFeatures[i], features.cols(), binWeights[0]);
+        // Examples selected for each node
+        std::vector<std::vector<Real>> binLabels(range);
+        std::vector<std::vector<Feature*>> binFeatures(range);
+        std::vector<std::vector<Real>> binWeights;
 
-    for (auto &pb: binProblemData) {
-        pb.r = features.rows();
-        pb.invPs = 1;
+        if (nodesWeights) binWeights.resize(range);
+        else binWeights.emplace_back(features.rows(), 1);
+
+        for (int i = 0; i < range; ++i) {
+            binLabels[i].reserve(nodesCounts[nStart + i]);
+            binFeatures[i].reserve(nodesCounts[nStart + i]);
+        }
+
+        assignDataPoints(binLabels, binFeatures, binWeights, labels, features, args, nStart, nStop);
+        if (negSampling) sampleNegatives(binLabels, binFeatures, binWeights, args, nStart);
+
+        // Train bases
+        std::vector<ProblemData> binProblemData;
+        if (nodesWeights)
+            for (int i = 0; i < range; ++i) binProblemData.emplace_back(binLabels[i], binFeatures[i], features.cols(), binWeights[i]);
+        else
+            for (int i = 0; i < range; ++i) binProblemData.emplace_back(binLabels[i], binFeatures[i], features.cols(), binWeights[0]);
+
+        for (auto &pb: binProblemData) {
+            pb.r = features.rows();
+            pb.invPs = 1;
+        }
+
+        trainBases(out, binProblemData, args, checkpoint.get(), nStart);
     }
-    
-    trainBases(joinPath(output, "weights.bin"), binProblemData, args);
+
+    out.close();
+    if (checkpoint) checkpoint->remove();
+}
+
+std::vector<std::pair<int, int>> BatchPLT::splitNodesIntoParts(std::vector<unsigned long long>& nodesCounts, int n, bool nodesWeights, Args& args) {
+    unsigned long long pointMem = sizeof(Real) + sizeof(Feature*);
+    if (nodesWeights) pointMem += sizeof(Real);
+    unsigned long long nodeMem = sizeof(std::vector<Real>) + sizeof(std::vector<Feature*>) + sizeof(ProblemData);
+
+    unsigned long long tmpDataMem = 0;
+    for (const auto& c : nodesCounts) tmpDataMem += c * pointMem + nodeMem;
+    unsigned long long baseMem = args.threads * baseTrainingMem(n, args);
+    unsigned long long availableMem = freeMem(args);
+    unsigned long long tmpDataLimit = (availableMem > baseMem) ? availableMem - baseMem : 0;
+
+    Log(CERR) << "  Required memory to train: " << formatMem(tmpDataMem + baseMem) << " (weights: " << formatMem(baseMem)
+              << ", tmp data: " << formatMem(tmpDataMem) << "), available memory: " << formatMem(availableMem) << "\n";
+
+    std::vector<std::pair<int, int>> parts;
+    if (tmpDataMem <= tmpDataLimit) {
+        parts.emplace_back(0, nodesCounts.size());
+        return parts;
+    }
+
+    // Contiguous ranges of nodes, so base estimators are still saved in order
+    int nStart = 0;
+    unsigned long long partMem = 0;
+    for (int i = 0; i < nodesCounts.size(); ++i) {
+        unsigned long long mem = nodesCounts[i] * pointMem + nodeMem;
+        if (i > nStart && partMem + mem > tmpDataLimit) {
+            parts.emplace_back(nStart, i);
+            nStart = i;
+            partMem = 0;
+        }
+        partMem += mem;
+    }
+    parts.emplace_back(nStart, nodesCounts.size());
+
+    Log(CERR) << "  Training will be split into " << parts.size() << " parts to fit into memory limit\n";
+
+    return parts;
 }
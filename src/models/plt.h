@@ -22,9 +22,13 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "base.h"
+#include "bases_cache.h"
 #include "label_tree.h"
 #include "model.h"
+#include "siblings_block.h"
 
 // Additional node information for prediction with thresholds
 struct TreeNodeThrExt {
@@ -46,16 +50,25 @@ public:
     void predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) override;
     Real predictForLabel(Label label, SparseVector& features, Args& args) override;
     std::vector<std::vector<Prediction>> predictBatch(SRMatrix& features, Args& args) override;
-    std::vector<std::vector<Prediction>> predictWithBeamSearch(SRMatrix& features, Args& args);
+    std::vector<std::vector<Prediction>> predictWithBeamSearch(SRMatrix& features, Args& args, const Real* hidden = nullptr);
+    void initCaches(Args& args) override;
+
+    // Helpers for sharded models
+    void predictFromNodes(std::vector<Prediction>& prediction, SparseVector& features, std::vector<TreeNodeValue>& startNodes, Args& args);
+    Real predictForNodeIndex(int index, SparseVector& features) { return predictForNode(tree->nodes[index], features); };
+    void predictTopLevels(std::vector<Prediction>& prediction, std::vector<TreeNodeValue>& frontier, SparseVector& features, int depth, Args& args,
+                          const std::vector<Real>* nodesValues = nullptr);
+    void setNodesLabels(std::vector<std::vector<int>> labels) { nodesLabels = std::move(labels); }; // For trees without leaves of all labels
 
     void setThresholds(std::vector<Real> th) override;
-    void updateThresholds(UnorderedMap<int, Real> thToUpdate) override;
+    void updateThresholds(const UnorderedMap<int, Real>& thToUpdate) override;
     void setLabelsWeights(std::vector<Real> lw) override;
 
     void load(Args& args, std::string infile) override;
     void unload() override;
 
     void printInfo() override;
+    std::vector<std::pair<std::string, unsigned long long>> getCacheStats() override;
 
     void setTree(LabelTree*t) { tree = t; };
     LabelTree* getTree() { return tree; };
@@ -73,32 +86,95 @@ public:
 protected:
     LabelTree* tree;
     std::vector<Base*> bases;
+    std::shared_ptr<BasesCache> basesCache; // For lazy loading, bases not loaded at start are nullptr
+
+    // Weights of children packed into blocks, bases of packed nodes are nullptr
+    std::vector<SiblingsBlock*> childrenBlocks; // nullptr for nodes which children are not packed
+    std::vector<int> nodesColumns; // Column of a node in the block of its parent
 
     std::vector<std::vector<int>> nodesLabels;
     std::vector<TreeNodeThrExt> nodesThr; // For prediction with thresholds
     std::vector<TreeNodeWeightsExt> nodesWeights; // For prediction with labels weights
 
+    // Cache of values of nodes of top levels of the tree, keyed by features only
+    std::shared_ptr<FeaturesCache<std::vector<Real>>> nodeCache;
+    std::vector<TreeNode*> cachedNodes;
+    std::vector<int> cachedNodesPos; // Position of a node in the cached values, -1 for nodes below the cached depth
+    int cachedNodesDepth;
+
     void calculateNodesLabels();
+    void packSiblings(Args& args);
     void setNodeThreshold(TreeNode* n);
     void setNodeWeight(TreeNode* n);
 
     virtual void assignDataPoints(std::vector<std::vector<Real>>& binLabels,
                                   std::vector<std::vector<Feature*>>& binFeatures,
                                   std::vector<std::vector<Real>>& binWeights,
-                                  SRMatrix& labels, SRMatrix& features, Args& args);
+                                  SRMatrix& labels, SRMatrix& features, Args& args, int nStart, int nStop);
+    virtual std::vector<unsigned long long> countDataPoints(SRMatrix& labels, Args& args);
 
     void getNodesToUpdate(UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, const SparseVector& labels);
     static void addNodesLabelsAndFeatures(std::vector<std::vector<Real>>& binLabels, std::vector<std::vector<Feature*>>& binFeatures,
-                                          UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, SparseVector& features);
+                                          UnorderedSet<TreeNode*>& nPositive, UnorderedSet<TreeNode*>& nNegative, SparseVector& features,
+                                          int nStart, int nStop);
+    void sampleNegatives(std::vector<std::vector<Real>>& binLabels, std::vector<std::vector<Feature*>>& binFeatures,
+                         std::vector<std::vector<Real>>& binWeights, Args& args, int nStart);
 
     // Helper methods for prediction
+    void setPredictionFunctions(std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue, Args& args);
     virtual Prediction predictNextLabel(std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue,
                                         TopKQueue<TreeNodeValue>& nQueue, SparseVector& features);
 
+    inline BaseRef getBase(int index){
+        Base* base = bases[index];
+        if (base != nullptr || basesCache == nullptr) return BaseRef(base);
+        return BaseRef(basesCache->get(index));
+    }
+
+    inline SiblingsBlock* getChildrenBlock(TreeNode* node){
+        return childrenBlocks.empty() ? nullptr : childrenBlocks[node->index];
+    }
+
     virtual inline Real predictForNode(TreeNode* node, SparseVector& features){
-        return bases[node->index]->predictProbability(features);
+        SiblingsBlock* block = node->parent ? getChildrenBlock(node->parent) : nullptr;
+        if (block != nullptr) return block->predictProbability(nodesColumns[node->index], features);
+        return getBase(node->index)->predictProbability(features);
     }
 
+    inline Real predictValueForNode(TreeNode* node, SparseVector& features){
+        SiblingsBlock* block = node->parent ? getChildrenBlock(node->parent) : nullptr;
+        if (block != nullptr) return block->predictValue(nodesColumns[node->index], features);
+        return getBase(node->index)->predictValue(features);
+    }
+
+    // Helper methods for beam search, children of a node are scored one by one (or together if they are packed
+    // into a block) and then their scores are turned into probabilities of children given the node
+    struct BeamSearchItem {
+        TreeNode* node; // Node which children are evaluated, nullptr for evaluation of the root
+        std::vector<Prediction>* entries; // Rows (as labels) that reached the node with node's probabilities
+        int start;
+        int stop;
+        std::vector<std::pair<int, TreeNodeValue>> results; // Evaluated children for each row
+    };
+
+    // Scores children for all rows of the item, scores are stored row by row, tmpW is thread's buffer for unpacked weights,
+    // hidden are dense vectors of rows (rows x dims) for models that score them instead of features, nullptr otherwise
+    virtual void beamSearchScore(BeamSearchItem& item, std::vector<TreeNode*>& children, SRMatrix& features, const Real* hidden,
+                                 Real* scores, Vector*& tmpW, Args& args);
+    virtual inline bool isScoredInBeamSearch(TreeNode* node){ return true; }
+    virtual inline Real predictScoreForNode(TreeNode* node, Base* base, SparseVector& features, AbstractVector* W){
+        return base->predictProbability(features, W);
+    }
+    virtual inline void blockValuesToScores(TreeNode* node, SiblingsBlock* block, Real* values){
+        for (int c = 0; c < block->size(); ++c) values[c] = block->toProbability(c, values[c]);
+    }
+    virtual inline void scoresToProbabilities(TreeNode* node, Real* scores){ }
+
+    static void beamSearchThread(int threadId, PLT* model, std::vector<BeamSearchItem>& items, std::atomic<int>& nextItem,
+                                 SRMatrix& features, const Real* hidden, Args& args);
+    static void beamSearchMergeThread(PLT* model, std::vector<BeamSearchItem>& items, std::vector<std::vector<Prediction>>& prediction,
+                                      std::vector<std::vector<TreeNodeValue>>& levelPredictions, Args& args, int startRow, int stopRow);
+
     inline void addToQueue(std::function<bool(TreeNode*, Real)>& ifAddToQueue, std::function<Real(TreeNode*, Real)>& calculateValue,
                            TopKQueue<TreeNodeValue>& nQueue, TreeNode* node, Real prob){
         Real value = calculateValue(node, prob);
@@ -106,13 +182,13 @@ protected:
 
     }
 
-    // Additional statistics
-    int nodeEvaluationCount; // Number of visited nodes during training prediction (updated/evaluated classifiers)
-    int nodeUpdateCount; // Number of visited nodes during training or prediction
-    int dataPointCount; // Data points count
+    void initStats(Args& args);
 };
 
 class BatchPLT : public PLT {
 public:
     void train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
+
+protected:
+    std::vector<std::pair<int, int>> splitNodesIntoParts(std::vector<unsigned long long>& nodesCounts, int n, bool nodesWeights, Args& args);
 };
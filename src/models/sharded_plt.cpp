@@ -0,0 +1,394 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+
+#include "sharded_plt.h"
+#include "weights_file.h"
+
+
+ShardedPLT::ShardedPLT() {
+    type = plt;
+    name = "Sharded PLT";
+    shardLevel = 1;
+}
+
+void ShardedPLT::train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) {
+    throw std::invalid_argument("Sharded PLT cannot be trained directly, train PLT model and split it using shard command");
+}
+
+void ShardedPLT::scatter(std::vector<std::vector<TreeNodeValue>>& shardsStartNodes, std::vector<Prediction>& prediction,
+                         SparseVector& features, Args& args) {
+    std::vector<TreeNodeValue> frontier;
+    top->predictTopLevels(prediction, frontier, features, shardLevel, args);
+
+    // Frontier nodes are leaves of the top tree and roots of the subtrees in the shards
+    shardsStartNodes.resize(shards.size());
+    for (auto& s : shardsStartNodes) s.clear();
+    for (auto& nv : frontier) {
+        int index = topNodes[nv.node->index];
+        int s = nodesShard[index];
+        shardsStartNodes[s].emplace_back(shards[s]->getTree()->nodes[nodesShardIndex[index]], nv.prob);
+    }
+}
+
+void ShardedPLT::merge(std::vector<Prediction>& prediction, std::vector<Prediction>& shardPrediction, Args& args) {
+    // Each shard returns its top predictions, so top k of their union is exact
+    prediction.insert(prediction.end(), shardPrediction.begin(), shardPrediction.end());
+    std::sort(prediction.rbegin(), prediction.rend());
+    if (args.topK > 0 && prediction.size() > args.topK) prediction.resize(args.topK);
+}
+
+void ShardedPLT::predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) {
+    std::vector<std::vector<TreeNodeValue>> shardsStartNodes;
+    scatter(shardsStartNodes, prediction, features, args);
+
+    for (int s = 0; s < shards.size(); ++s) {
+        if (shardsStartNodes[s].empty()) continue;
+        std::vector<Prediction> shardPrediction;
+        shards[s]->predictFromNodes(shardPrediction, features, shardsStartNodes[s], args);
+        merge(prediction, shardPrediction, args);
+    }
+    stats.local().addDataPoints();
+}
+
+std::vector<std::vector<Prediction>> ShardedPLT::predictBatch(SRMatrix& features, Args& args) {
+    if (args.treeSearchType != exact) throw std::invalid_argument("Sharded PLT supports only exact tree search");
+
+    // Rows are split between the threads, each of them passes its rows through the top levels and the shards
+    return Model::predictBatch(features, args);
+}
+
+TreeNode* ShardedPLT::getTopNode(int shard, TreeNode* node) {
+    // Root of the subtree is a child of the additional root of the shard and a leaf of the top tree
+    LabelTree* tree = shards[shard]->getTree();
+    while (node->parent != tree->root) node = node->parent;
+    return top->getTree()->nodes[nodesTopIndex[shardsNodes[shard][node->index]]];
+}
+
+Real ShardedPLT::predictForLabel(Label label, SparseVector& features, Args& args) {
+    auto fs = labelsShard.find(label);
+    if (fs == labelsShard.end()) return 0;
+
+    Real value = 1;
+    TreeNode* n;
+    if (fs->second < 0) n = top->getTree()->getLeaf(label);
+    else {
+        // Path of the label in the shard ends at the root of its subtree, the rest of it is in the top tree
+        int s = fs->second;
+        TreeNode* leaf = shards[s]->getTree()->getLeaf(label);
+        for (TreeNode* sn = leaf; sn != shards[s]->getTree()->root; sn = sn->parent)
+            value *= shards[s]->predictForNodeIndex(sn->index, features);
+        n = getTopNode(s, leaf)->parent;
+    }
+    for (; n != nullptr; n = n->parent) value *= top->predictForNodeIndex(n->index, features);
+
+    if(!labelsWeights.empty())
+        value *= labelsWeights[label];
+
+    return value;
+}
+
+void ShardedPLT::setTopNodesLabels() {
+    // Top tree does not have the leaves of the labels of the shards, so its nodes get them from the subtrees
+    std::vector<std::vector<int>> nodesLabels(top->getTree()->size());
+    for (auto& ls : labelsShard) {
+        TreeNode* n;
+        if (ls.second < 0) n = top->getTree()->getLeaf(ls.first);
+        else n = getTopNode(ls.second, shards[ls.second]->getTree()->getLeaf(ls.first));
+        for (; n != nullptr; n = n->parent) nodesLabels[n->index].push_back(ls.first);
+    }
+    top->setNodesLabels(nodesLabels);
+}
+
+void ShardedPLT::setThresholds(std::vector<Real> th) {
+    Model::setThresholds(th);
+    setTopNodesLabels();
+    top->setThresholds(th);
+    for (auto& s : shards) s->setThresholds(th);
+}
+
+void ShardedPLT::updateThresholds(const UnorderedMap<int, Real>& thToUpdate) {
+    Model::updateThresholds(thToUpdate);
+
+    // Labels of the shards do not have leaves in the top tree, so thresholds of all its nodes are recalculated,
+    // each shard updates only the thresholds of its own labels
+    top->setThresholds(thresholds);
+    std::vector<UnorderedMap<int, Real>> shardsThToUpdate(shards.size());
+    for (auto& th : thToUpdate) {
+        auto fs = labelsShard.find(th.first);
+        if (fs != labelsShard.end() && fs->second >= 0) shardsThToUpdate[fs->second].insert(th);
+    }
+    for (int s = 0; s < shards.size(); ++s)
+        if (!shardsThToUpdate[s].empty()) shards[s]->updateThresholds(shardsThToUpdate[s]);
+}
+
+void ShardedPLT::setLabelsWeights(std::vector<Real> lw) {
+    Model::setLabelsWeights(lw);
+    setTopNodesLabels();
+    top->setLabelsWeights(lw);
+    for (auto& s : shards) s->setLabelsWeights(lw);
+}
+
+void ShardedPLT::load(Args& args, std::string infile) {
+    if (args.treeSearchType != exact) throw std::invalid_argument("Sharded PLT supports only exact tree search");
+
+    std::string shardsDir = joinPath(infile, "shards");
+    std::ifstream in(joinPath(shardsDir, "shards.bin"), std::ios::in | std::ios::binary);
+    if (!in.good()) throw std::invalid_argument("Model in " + infile + " is not sharded, use shard command first");
+
+    int shardsCount;
+    loadVar(in, shardsCount);
+    loadVar(in, shardLevel);
+    int size;
+    loadVar(in, size);
+    nodesShard.resize(size);
+    nodesShardIndex.resize(size);
+    nodesTopIndex.resize(size);
+    for (int i = 0; i < size; ++i) {
+        loadVar(in, nodesShard[i]);
+        loadVar(in, nodesShardIndex[i]);
+        loadVar(in, nodesTopIndex[i]);
+    }
+    in.close();
+
+    if (args.shards != shardsCount)
+        throw std::invalid_argument("Model is split into " + std::to_string(shardsCount) + " shards, but --shards "
+                                    + std::to_string(args.shards) + " was given");
+
+    Log(CERR) << "Loading " << name << " model with " << shardsCount << " shards ...\n";
+
+    top = std::make_shared<BatchPLT>();
+    top->load(args, joinPath(shardsDir, "top"));
+    for (int s = 0; s < shardsCount; ++s) {
+        shards.push_back(std::make_shared<BatchPLT>());
+        shards.back()->load(args, joinPath(shardsDir, "shard_" + std::to_string(s)));
+    }
+
+    topNodes.assign(top->getTree()->size(), -1);
+    shardsNodes.resize(shardsCount);
+    for (int s = 0; s < shardsCount; ++s) shardsNodes[s].assign(shards[s]->getTree()->size(), -1);
+    for (int i = 0; i < size; ++i) {
+        if (nodesTopIndex[i] >= 0) topNodes[nodesTopIndex[i]] = i;
+        if (nodesShard[i] >= 0) shardsNodes[nodesShard[i]][nodesShardIndex[i]] = i;
+    }
+
+    // Each label has a leaf in exactly one of the trees
+    auto& topLeaves = top->getTree()->leaves;
+    for (int l = 0; l < topLeaves.size(); ++l)
+        if (topLeaves[l] != nullptr) labelsShard[l] = -1;
+    for (int s = 0; s < shardsCount; ++s) {
+        auto& shardLeaves = shards[s]->getTree()->leaves;
+        for (int l = 0; l < shardLeaves.size(); ++l)
+            if (shardLeaves[l] != nullptr) labelsShard[l] = s;
+    }
+
+    m = labelsShard.size();
+    loaded = true;
+}
+
+void ShardedPLT::unload() {
+    top = nullptr;
+    shards.clear();
+    nodesShard.clear();
+    nodesShardIndex.clear();
+    nodesTopIndex.clear();
+    topNodes.clear();
+    shardsNodes.clear();
+    labelsShard.clear();
+    Model::unload();
+}
+
+void ShardedPLT::printInfo() {
+    // Trees of the shards have additional root above the subtrees
+    int depth = top->getTree()->getTreeDepth();
+    for (auto& s : shards) depth = std::max(depth, shardLevel + s->getTree()->getTreeDepth() - 1);
+
+    Log(COUT) << name << " additional stats:"
+              << "\n  Shards: " << shards.size() << ", shard level: " << shardLevel
+              << "\n  Tree size: " << nodesShard.size()
+              << "\n  Tree depth: " << depth << "\n";
+
+    auto summary = getStats();
+    if(summary.dataPoints > 0)
+        Log(COUT) << "  Evaluated estimators / data point: " << static_cast<Real>(summary.nodeEvaluations) / summary.dataPoints << "\n";
+}
+
+StatsSummary ShardedPLT::getStats() {
+    auto summary = Model::getStats();
+    if (top == nullptr) return summary;
+
+    // Per-node and per-depth counters of the top tree and the shards are mapped to the nodes of the whole tree
+    for (int p = -1; p < static_cast<int>(shards.size()); ++p) {
+        StatsSummary part = (p < 0 ? top : shards[p])->getStats();
+        std::vector<int>& nodes = (p < 0 ? topNodes : shardsNodes[p]);
+
+        if (p >= 0 && !part.depthEvaluations.empty())
+            part.depthEvaluations.insert(part.depthEvaluations.begin(), shardLevel - 1, 0);
+
+        if (!part.nodesEvaluations.empty()) {
+            std::vector<unsigned long long> nodesEvaluations(nodesShard.size(), 0);
+            for (int i = 0; i < nodes.size() && i < part.nodesEvaluations.size(); ++i)
+                if (nodes[i] >= 0) nodesEvaluations[nodes[i]] += part.nodesEvaluations[i];
+            part.nodesEvaluations.swap(nodesEvaluations);
+        }
+
+        summary.merge(part);
+    }
+
+    return summary;
+}
+
+void ShardedPLT::createShards(Args& args, std::string infile) {
+    if (args.modelType != plt && args.modelType != oplt)
+        throw std::invalid_argument("Only PLT models can be split into shards");
+    if (args.shards < 1) throw std::invalid_argument("Number of shards has to be positive");
+    if (args.shardLevel < 1) throw std::invalid_argument("Shard level has to be greater than 0");
+
+    LabelTree tree;
+    tree.loadFromFile(joinPath(infile, "tree.bin"));
+    int size = tree.size();
+
+    // Find subtree of each node rooted at the shard level
+    std::vector<int> nodesDepth(size);
+    std::vector<int> nodesSubtree(size, -1);
+    std::vector<int> subtreesRoots;
+    for (auto& n : tree.nodes) {
+        TreeNode* s = n;
+        int depth = tree.getNodeDepth(n) - 1;
+        nodesDepth[n->index] = depth;
+        if (depth < args.shardLevel) continue;
+        while (depth-- > args.shardLevel) s = s->parent;
+        nodesSubtree[n->index] = s->index;
+        if (s == n) subtreesRoots.push_back(n->index);
+    }
+
+    if (subtreesRoots.empty())
+        throw std::invalid_argument("Tree does not have nodes at level " + std::to_string(args.shardLevel));
+    if (subtreesRoots.size() < args.shards)
+        Log(CERR) << "Warning: Tree has only " << subtreesRoots.size() << " nodes at level " << args.shardLevel
+                  << ", some of the shards will be empty\n";
+
+    // Calculate size of subtrees
+    Log(CERR) << "Calculating size of subtrees ...\n";
+    std::vector<unsigned long long> subtreesMem(size, 0);
+    std::string weightsFile = joinPath(infile, "weights.bin");
+    WeightsReader sizeReader(weightsFile);
+    if (sizeReader.size() != size) throw std::invalid_argument("Number of base estimators does not match the tree size");
+    for (int i = 0; i < size; ++i) {
+        printProgress(i, size);
+        Base base;
+        sizeReader.read(base, false, sparse);
+        if (nodesSubtree[i] >= 0) subtreesMem[nodesSubtree[i]] += base.mem();
+    }
+    sizeReader.close();
+
+    // Assign the biggest subtrees first to the least loaded shard
+    std::sort(subtreesRoots.begin(), subtreesRoots.end(), [&](int a, int b) { return subtreesMem[a] > subtreesMem[b]; });
+    std::vector<unsigned long long> shardsMem(args.shards, 0);
+    std::vector<int> subtreesShard(size, -1);
+    for (auto& r : subtreesRoots) {
+        int s = std::min_element(shardsMem.begin(), shardsMem.end()) - shardsMem.begin();
+        subtreesShard[r] = s;
+        shardsMem[s] += subtreesMem[r];
+    }
+
+    std::vector<int> nodesShard(size, -1);
+    for (int i = 0; i < size; ++i)
+        if (nodesSubtree[i] >= 0) nodesShard[i] = subtreesShard[nodesSubtree[i]];
+
+    // Top tree has the nodes of the top levels and the roots of the subtrees as its unlabeled leaves,
+    // tree of each shard has only its subtrees under an additional unlabeled root.
+    // Nodes are added in the order of the whole tree, so the order of the children is kept.
+    std::vector<std::shared_ptr<LabelTree>> trees(args.shards + 1); // Top tree is the first one
+    for (auto& t : trees) t = std::make_shared<LabelTree>();
+    for (int t = 1; t < trees.size(); ++t) trees[t]->root = trees[t]->createTreeNode();
+
+    std::vector<TreeNode*> topCopies(size, nullptr);
+    std::vector<TreeNode*> shardCopies(size, nullptr);
+    for (int i = 0; i < size; ++i) {
+        TreeNode* n = tree.nodes[i];
+        if (nodesDepth[i] <= args.shardLevel)
+            topCopies[i] = trees[0]->createTreeNode(nullptr, nodesDepth[i] < args.shardLevel ? n->label : -1);
+        if (nodesShard[i] >= 0) shardCopies[i] = trees[nodesShard[i] + 1]->createTreeNode(nullptr, n->label);
+    }
+    for (int i = 0; i < size; ++i) {
+        TreeNode* parent = tree.nodes[i]->parent;
+        if (topCopies[i] != nullptr) {
+            if (parent == nullptr) trees[0]->root = topCopies[i];
+            else trees[0]->setParent(topCopies[i], topCopies[parent->index]);
+        }
+        if (shardCopies[i] != nullptr) {
+            auto& t = trees[nodesShard[i] + 1];
+            t->setParent(shardCopies[i], nodesDepth[i] == args.shardLevel ? t->root : shardCopies[parent->index]);
+        }
+    }
+
+    // Save shards, each is a regular PLT model, only the frontier nodes of the top tree and the roots of the shards
+    // get dummy base estimators, because they are never evaluated
+    Log(CERR) << "Saving " << args.shards << " shards ...\n";
+    std::string shardsDir = joinPath(infile, "shards");
+    std::vector<std::string> dirs = {joinPath(shardsDir, "top")};
+    for (int s = 0; s < args.shards; ++s) dirs.push_back(joinPath(shardsDir, "shard_" + std::to_string(s)));
+
+    // Shards keep the format of the model weights
+    WeightsReader reader(weightsFile);
+    std::vector<std::shared_ptr<WeightsWriter>> outs;
+    for (int t = 0; t < dirs.size(); ++t) {
+        makeDir(dirs[t]);
+        std::filesystem::copy_file(joinPath(infile, "args.bin"), joinPath(dirs[t], "args.bin"), std::filesystem::copy_options::overwrite_existing);
+        trees[t]->saveToFile(joinPath(dirs[t], "tree.bin"));
+        outs.push_back(std::make_shared<WeightsWriter>(joinPath(dirs[t], "weights.bin"), trees[t]->size(), reader.format(), reader.precision()));
+    }
+
+    Base dummy;
+    for (int t = 1; t < outs.size(); ++t) outs[t]->write(dummy);
+    for (int i = 0; i < size; ++i) {
+        printProgress(i, size);
+        Base base;
+        reader.read(base, false, sparse);
+        if (topCopies[i] != nullptr) outs[0]->write(nodesDepth[i] < args.shardLevel ? base : dummy);
+        if (shardCopies[i] != nullptr) outs[nodesShard[i] + 1]->write(base);
+    }
+    reader.close();
+    for (auto& out : outs) out->close();
+
+    std::ofstream out(joinPath(shardsDir, "shards.bin"), std::ios::out | std::ios::binary);
+    saveVar(out, args.shards);
+    saveVar(out, args.shardLevel);
+    saveVar(out, size);
+    for (int i = 0; i < size; ++i) {
+        int shardIndex = shardCopies[i] != nullptr ? shardCopies[i]->index : -1;
+        int topIndex = topCopies[i] != nullptr ? topCopies[i]->index : -1;
+        saveVar(out, nodesShard[i]);
+        saveVar(out, shardIndex);
+        saveVar(out, topIndex);
+    }
+    out.close();
+
+    Log(COUT) << "Shards:\n  Top levels nodes: " << std::count(nodesShard.begin(), nodesShard.end(), -1) << "\n";
+    for (int s = 0; s < args.shards; ++s)
+        Log(COUT) << "  Shard " << s << " nodes: " << std::count(nodesShard.begin(), nodesShard.end(), s)
+                  << ", size: " << formatMem(shardsMem[s]) << "\n";
+}
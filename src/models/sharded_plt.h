@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include "plt.h"
+
+
+// PLT split into shards by subtrees rooted at the given tree level, top levels of the tree are evaluated by
+// the coordinator, that passes the probabilities of frontier nodes to the shards and merges their predictions
+class ShardedPLT : public Model {
+public:
+    ShardedPLT();
+
+    void train(SRMatrix& labels, SRMatrix& features, Args& args, std::string output) override;
+    void predict(std::vector<Prediction>& prediction, SparseVector& features, Args& args) override;
+    Real predictForLabel(Label label, SparseVector& features, Args& args) override;
+    std::vector<std::vector<Prediction>> predictBatch(SRMatrix& features, Args& args) override;
+
+    void setThresholds(std::vector<Real> th) override;
+    void updateThresholds(const UnorderedMap<int, Real>& thToUpdate) override;
+    void setLabelsWeights(std::vector<Real> lw) override;
+
+    void load(Args& args, std::string infile) override;
+    void unload() override;
+    void printInfo() override;
+    StatsSummary getStats() override;
+
+    // Splits trained PLT model into shards saved in shards subdirectory of the model
+    static void createShards(Args& args, std::string infile);
+
+private:
+    int shardLevel;
+    std::shared_ptr<BatchPLT> top;
+    std::vector<std::shared_ptr<BatchPLT>> shards;
+
+    // Top tree and trees of the shards index their nodes anew, these map them to the nodes of the whole tree
+    std::vector<int> nodesShard; // Shard of each node, -1 for the nodes of the top levels
+    std::vector<int> nodesShardIndex; // Index of each node in the tree of its shard, -1 for the nodes of the top levels
+    std::vector<int> nodesTopIndex; // Index of each node in the top tree, -1 for the nodes below the shard level
+    std::vector<int> topNodes; // Node of the whole tree for each node of the top tree
+    std::vector<std::vector<int>> shardsNodes; // Node of the whole tree for each node of the shards, -1 for their roots
+    UnorderedMap<int, int> labelsShard; // Shard of each label, -1 for the labels of the top levels
+
+    void scatter(std::vector<std::vector<TreeNodeValue>>& shardsStartNodes, std::vector<Prediction>& prediction,
+                 SparseVector& features, Args& args);
+    static void merge(std::vector<Prediction>& prediction, std::vector<Prediction>& shardPrediction, Args& args);
+    TreeNode* getTopNode(int shard, TreeNode* node);
+    void setTopNodesLabels();
+};
@@ -0,0 +1,67 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "prediction_stream.h"
+
+PredictionStream::PredictionStream(std::shared_ptr<Model> model, Args& args)
+    : model(model), args(args), reader(args), rows(0), fCells(0), lCells(0) {
+    if (args.chunkSize <= 0) throw std::invalid_argument("Chunk size must be greater than 0");
+    if (args.relabel) labelsMap.loadFromFile(joinPath(args.output, "labels_map.bin"));
+    readNextChunk();
+}
+
+PredictionStream::~PredictionStream() {
+    // Background read has to finish before the reader is destroyed
+    if (nextChunk.valid()) nextChunk.wait();
+}
+
+void PredictionStream::readNextChunk() {
+    nextChunk = std::async(std::launch::async, [this]() {
+        auto chunk = std::make_shared<DataChunk>();
+        reader.readChunk(chunk->labels, chunk->features, args.chunkSize);
+        return chunk;
+    });
+}
+
+bool PredictionStream::next(std::vector<std::vector<Prediction>>& predictions, SRMatrix& labels) {
+    if (!nextChunk.valid()) return false;
+
+    auto chunk = nextChunk.get();
+    if (chunk->features.rows() == 0) {
+        reader.close();
+        return false;
+    }
+
+    // Start reading the next chunk before predicting for the current one
+    if (!reader.eof()) readNextChunk();
+
+    rows += chunk->features.rows();
+    fCells += chunk->features.cells();
+    lCells += chunk->labels.cells();
+
+    predictions = model->predictBatch(chunk->features, args);
+    if (!labelsMap.empty()) labelsMap.restore(predictions);
+    labels = std::move(chunk->labels);
+
+    if (!nextChunk.valid()) reader.close();
+    return true;
+}
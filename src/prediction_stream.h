@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "args.h"
+#include "basic_types.h"
+#include "labels_map.h"
+#include "matrix.h"
+#include "model.h"
+#include "read_data.h"
+
+// Predicts for a data file chunk by chunk. Reading of the next chunk runs in the background while
+// the current one is being predicted, so only a couple of chunks are kept in memory at any time.
+// Predictions of models trained with relabeling are returned with original label ids.
+class PredictionStream {
+public:
+    PredictionStream(std::shared_ptr<Model> model, Args& args);
+    ~PredictionStream();
+
+    // Predicts for the next chunk and sets its labels, returns false if the whole file has been processed
+    bool next(std::vector<std::vector<Prediction>>& predictions, SRMatrix& labels);
+
+    inline int rowsCount() const { return rows; }
+    inline int outputSize() const { return labelsMap.empty() ? model->outputSize() : labelsMap.originalSize(); }
+    inline unsigned long long featuresCells() const { return fCells; }
+    inline unsigned long long labelsCells() const { return lCells; }
+
+private:
+    struct DataChunk {
+        SRMatrix labels;
+        SRMatrix features;
+    };
+
+    std::shared_ptr<Model> model;
+    Args& args;
+    LabelsMap labelsMap;
+    DataReader reader;
+    std::future<std::shared_ptr<DataChunk>> nextChunk;
+
+    int rows;
+    unsigned long long fCells;
+    unsigned long long lCells;
+
+    void readNextChunk();
+};
@@ -0,0 +1,148 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <charconv>
+#include <cstdint>
+
+#include "log.h"
+#include "prediction_writer.h"
+
+// Number of chunks waiting to be written before write() blocks
+const int maxQueuedChunks = 4;
+
+PredictionWriter::PredictionWriter(Args& args, bool print)
+    : print(print && logLevel >= COUT), format(args.predictionFormat), k(args.topK), rows(0), finished(false) {
+    if (!args.prediction.empty()) {
+        if (format == binaryFormat && k <= 0)
+            throw std::invalid_argument("Binary prediction format requires top k greater than 0");
+
+        out.open(args.prediction, std::ios::out | std::ios::binary);
+        if (!out.is_open()) throw std::invalid_argument("Cannot open prediction file: " + args.prediction);
+
+        if (format == binaryFormat) {
+            uint32_t version = 1;
+            uint32_t uk = k;
+            out.write("NXCP", 4);
+            out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+            out.write(reinterpret_cast<const char*>(&uk), sizeof(uk));
+            out.write(reinterpret_cast<const char*>(&rows), sizeof(rows)); // Updated on close
+        }
+    }
+
+    writer = std::thread(&PredictionWriter::writeThread, this);
+}
+
+PredictionWriter::~PredictionWriter() {
+    try {
+        close();
+    } catch (const std::exception& e) {
+        Log(CERR) << "Failed to write predictions: " << e.what() << "\n";
+    }
+}
+
+void PredictionWriter::write(std::vector<std::vector<Prediction>>&& predictions) {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        condition.wait(lock, [this] { return queue.size() < maxQueuedChunks; });
+        queue.push_back(std::move(predictions));
+    }
+    condition.notify_all();
+}
+
+void PredictionWriter::close() {
+    if (!writer.joinable()) return;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        finished = true;
+    }
+    condition.notify_all();
+    writer.join();
+
+    if (!out.is_open()) return;
+    if (format == binaryFormat) {
+        out.seekp(12);
+        out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    }
+    out.close();
+    if (!out) throw std::runtime_error("Failed to write predictions file");
+}
+
+void PredictionWriter::writeThread() {
+    while (true) {
+        std::vector<std::vector<Prediction>> predictions;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            condition.wait(lock, [this] { return finished || !queue.empty(); });
+            if (queue.empty()) break;
+            predictions = std::move(queue.front());
+            queue.pop_front();
+        }
+        condition.notify_all();
+
+        // Each chunk is formatted into one buffer and written at once
+        if (out.is_open() && format == binaryFormat) {
+            formatBinary(predictions);
+            out.write(buffer.data(), buffer.size());
+        }
+        if (out.is_open() && format == textFormat) {
+            formatText(predictions, 6);
+            out.write(buffer.data(), buffer.size());
+        }
+        if (print) {
+            formatText(predictions, 5);
+            Log(COUT) << buffer;
+        }
+        rows += predictions.size();
+    }
+}
+
+void PredictionWriter::formatText(const std::vector<std::vector<Prediction>>& predictions, int precision) {
+    // Values are formatted with given number of significant digits, as with setprecision of streams
+    char number[32];
+    buffer.clear();
+    for (const auto& p : predictions) {
+        for (const auto& l : p) {
+            buffer.append(number, std::to_chars(number, number + sizeof(number), l.label).ptr);
+            buffer += ':';
+            buffer.append(number, std::to_chars(number, number + sizeof(number), l.value, std::chars_format::general, precision).ptr);
+            buffer += ' ';
+        }
+        buffer += '\n';
+    }
+}
+
+void PredictionWriter::formatBinary(const std::vector<std::vector<Prediction>>& predictions) {
+    buffer.resize(predictions.size() * k * (sizeof(int32_t) + sizeof(float)));
+    char* ptr = buffer.data();
+    for (const auto& p : predictions) {
+        int size = std::min<int>(k, p.size());
+        auto labels = reinterpret_cast<int32_t*>(ptr);
+        auto values = reinterpret_cast<float*>(ptr + k * sizeof(int32_t));
+        for (int i = 0; i < size; ++i) {
+            labels[i] = p[i].label;
+            values[i] = p[i].value;
+        }
+        std::fill(labels + size, labels + k, -1);
+        std::fill(values + size, values + k, 0);
+        ptr += k * (sizeof(int32_t) + sizeof(float));
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "args.h"
+#include "basic_types.h"
+
+// Writes predictions in a dedicated thread, chunks of predictions are written in the order they are added.
+// Text format is the same as one printed by predict command: "<label>:<value> <label>:<value> ...\n".
+// Binary format starts with a header: "NXCP" magic, uint32 version, uint32 k, uint64 number of rows,
+// followed by rows of k int32 labels and k float32 values, padded with -1 labels and 0 values.
+class PredictionWriter {
+public:
+    // Writes to args.prediction if given and to the COUT log if print is true
+    PredictionWriter(Args& args, bool print = false);
+    ~PredictionWriter();
+
+    // Queues chunk of predictions, blocks if too many chunks are waiting to be written
+    void write(std::vector<std::vector<Prediction>>&& predictions);
+
+    // Waits for all queued chunks to be written and closes the output
+    void close();
+
+private:
+    std::ofstream out;
+    bool print;
+    PredictionFormat format;
+    int k;
+    unsigned long long rows;
+
+    std::thread writer;
+    std::deque<std::vector<std::vector<Prediction>>> queue;
+    std::mutex mtx;
+    std::condition_variable condition;
+    bool finished;
+
+    std::string buffer;
+
+    void writeThread();
+    void formatText(const std::vector<std::vector<Prediction>>& predictions, int precision);
+    void formatBinary(const std::vector<std::vector<Prediction>>& predictions);
+};
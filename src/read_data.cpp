@@ -29,82 +29,97 @@
 
 // Reads train/test data to sparse matrix
 void readData(SRMatrix& labels, SRMatrix& features, Args& args) {
+    DataReader reader(args);
+    reader.readChunk(labels, features);
+    reader.close();
+
+    // Print info about loaded data
+    Log(CERR) << "  Loaded: rows: " << labels.rows() << ", features: " << features.cols() - 2
+              << ", labels: " << labels.cols() << "\n  Data size: " << formatMem(labels.mem() + features.mem()) << "\n";
+}
+
+DataReader::DataReader(Args& args): args(args) {
     if (args.input.empty())
         throw std::invalid_argument("Empty input path");
 
     Log(CERR) << "Loading data from: " << args.input << "\n";
 
-    std::ifstream in;
     in.open(args.input);
-    std::string line;
+    if (!in.is_open())
+        throw std::invalid_argument("Cannot open input file: " + args.input);
 
     // Check header
-    int i = 1; // Line counter
-    int hLabels = 0, hFeatures = 0, hRows = 0;
-    getline(in, line);
+    lineNumber = 1;
+    hLabels = 0, hFeatures = 0, hRows = 0;
+    rows = 0, maxFeatures = 0, maxLabels = 0;
+    hasLine = static_cast<bool>(getline(in, line));
 
     auto hTokens = split(line, ' ');
     if(hTokens.size() == 2 || hTokens.size() == 3) {
         hRows = std::stoi(hTokens[0]);
         hFeatures = std::stoi(hTokens[1]);
-        getline(in, line);
-        ++i;
+        hasLine = static_cast<bool>(getline(in, line));
+        ++lineNumber;
         if(hTokens.size() == 3) {
             hLabels = std::stoi(hTokens[2]);
             Log(CERR) << "  Header: rows: " << hRows << ", features: " << hFeatures << ", labels: " << hLabels << "\n";
         } else Log(CERR) << "  Header: rows: " << hRows << ", features: " << hFeatures << "\n";
     }
     if (args.hash) hFeatures = args.hash;
-
-    // Read data points
-    std::vector<IRVPair> lLabels;
-    std::vector<IRVPair> lFeatures;
     if (!hRows) Log(CERR) << "  ?%\r";
-    do {
-        if (hRows) printProgress(i, hRows); // If the number of rows is know, print progress
+}
+
+DataReader::~DataReader() {
+    if (in.is_open()) in.close();
+}
+
+int DataReader::readChunk(SRMatrix& labels, SRMatrix& features, int chunkSize) {
+    int read = 0;
+    while (hasLine && (chunkSize <= 0 || read < chunkSize)) {
+        if (hRows) printProgress(lineNumber, hRows); // If the number of rows is know, print progress
         lLabels.clear();
         lFeatures.clear();
 
         if(args.processData) prepareFeaturesVector(lFeatures, args.bias);
 
+        bool failed = false;
         try {
             readLine(line, lLabels, lFeatures);
         } catch (const std::exception& e) {
-            Log(CERR) << "  Failed to read line " << i << ", skipping!\n";
-            continue;
+            Log(CERR) << "  Failed to read line " << lineNumber << ", skipping!\n";
+            failed = true;
         }
 
-        if(args.processData) processFeaturesVector(lFeatures, args.norm, args.hash, args.featuresThreshold);
+        if(!failed) {
+            if (args.processData) processFeaturesVector(lFeatures, args.norm, args.hash, args.featuresThreshold, args.hashSign);
+
+            labels.appendRow(lLabels);
+            features.appendRow(lFeatures);
+            maxLabels = std::max(maxLabels, labels.cols());
+            maxFeatures = std::max(maxFeatures, features.cols());
 
-        labels.appendRow(lLabels);
-        features.appendRow(lFeatures);
+            ++lineNumber;
+            ++read;
+        }
+
+        hasLine = static_cast<bool>(getline(in, line));
+    }
 
-        ++i;
-    } while (getline(in, line));
+    rows += read;
+    return read;
+}
 
+void DataReader::close() {
+    if (!in.is_open()) return;
     in.close();
 
     // Checks
-    assert(labels.rows() == features.rows());
-    if (hRows && hRows != features.rows())
+    if (hRows && hRows != rows)
         Log(CERR) << "  Warning: Number of lines does not match number in the file header!\n";
-    if (hLabels && hFeatures < features.cols() - 2)
+    if (hLabels && hFeatures < maxFeatures - 2)
         Log(CERR) << "  Warning: Number of features is bigger then number in the file header!\n";
-    if (hFeatures && hLabels < labels.cols())
+    if (hFeatures && hLabels < maxLabels)
         Log(CERR) << "  Warning: Number of labels is bigger then number in the file header!\n";
-
-    // Print data
-    /*
-    for (int r = 0; r < features.rows(); ++r){
-        for(int c = 0; c < features.size(r); ++c)
-            Log(CERR) << features.row(r)[c].index << ":" << features.row(r)[c].value << " ";
-        Log(CERR) << "\n";
-    }
-    */
-
-    // Print info about loaded data
-    Log(CERR) << "  Loaded: rows: " << labels.rows() << ", features: " << features.cols() - 2
-              << ", labels: " << labels.cols() << "\n  Data size: " << formatMem(labels.mem() + features.mem()) << "\n";
 }
 
 // Reads line in LibSvm format label,label,... feature(:value) feature(:value) ...
@@ -135,19 +150,26 @@ void prepareFeaturesVector(std::vector<IRVPair> &lFeatures, Real bias) {
     lFeatures.emplace_back(1, bias);
 }
 
-void processFeaturesVector(std::vector<IRVPair> &lFeatures, bool norm, size_t hashSize, Real featuresThreshold) {
+void processFeaturesVector(std::vector<IRVPair> &lFeatures, bool norm, size_t hashSize, Real featuresThreshold, bool hashSign) {
     //Shift index by 2 because LibLinear ignore feature 0 and feature 1 is reserved for bias
     //assert(!lFeatures.empty());
     shift(lFeatures.begin() + 1, lFeatures.end(), 2);
 
-    // Hash features
+    // Hash features in place, then sort and merge features that fall into the same bucket
     if (hashSize) {
-        UnorderedMap<int, double> lHashed;
-        for (int j = 1; j < lFeatures.size(); ++j)
-            lHashed[hash(lFeatures[j].index) % hashSize] += lFeatures[j].value;
+        for (auto f = lFeatures.begin() + 1; f != lFeatures.end(); ++f) {
+            // Sign comes from a separate hash, so it does not depend on the bucket for any hash size
+            if (hashSign && (mixHash(f->index) >> 31)) f->value = -f->value;
+            f->index = hash(f->index) % hashSize + 2;
+        }
+        std::sort(lFeatures.begin() + 1, lFeatures.end(), IRVPairIndexComp());
 
-        lFeatures.erase(lFeatures.begin() + 1, lFeatures.end()); // Keep bias feature
-        for (const auto& f : lHashed) lFeatures.emplace_back(f.first + 2, f.second);
+        auto last = lFeatures.begin();
+        for (auto f = lFeatures.begin() + 1; f != lFeatures.end(); ++f) {
+            if (last != lFeatures.begin() && last->index == f->index) last->value += f->value;
+            else *(++last) = *f;
+        }
+        lFeatures.erase(last + 1, lFeatures.end());
     }
 
     // Norm row
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <fstream>
 #include <string>
 
 #include "args.h"
@@ -32,7 +33,36 @@
 
 // Libsvm, XMLCRepo and numeric VW file reader
 void readData(SRMatrix& labels, SRMatrix& features, Args& args);
+
+// Reads data file in chunks of rows, so the whole file does not have to be kept in memory
+class DataReader {
+public:
+    DataReader(Args& args);
+    ~DataReader();
+
+    // Appends up to chunkSize rows (all remaining rows if chunkSize <= 0), returns the number of appended rows
+    int readChunk(SRMatrix& labels, SRMatrix& features, int chunkSize = 0);
+
+    // Closes file and prints warnings about inconsistencies with the header
+    void close();
+
+    inline bool eof() const { return !hasLine; }
+    inline int rowsRead() const { return rows; }
+
+private:
+    Args& args;
+    std::ifstream in;
+    std::string line;
+    bool hasLine;
+    int lineNumber;
+    int hRows, hFeatures, hLabels;
+    int rows, maxFeatures, maxLabels;
+    std::vector<IRVPair> lLabels;
+    std::vector<IRVPair> lFeatures;
+};
+
 void readLine(std::string& line, std::vector<IRVPair>& lLabels, std::vector<IRVPair>& lFeatures);
 
 void prepareFeaturesVector(std::vector<IRVPair> &lFeatures, Real bias = 1.0);
-void processFeaturesVector(std::vector<IRVPair> &lFeatures, bool norm = true, size_t hashSize = 0, Real featuresThreshold = 0);
+void processFeaturesVector(std::vector<IRVPair> &lFeatures, bool norm = true, size_t hashSize = 0, Real featuresThreshold = 0,
+                           bool hashSign = false);
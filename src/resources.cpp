@@ -24,6 +24,8 @@
 
 #include "resources.h"
 
+#include <cerrno>
+#include <cstring>
 #include <fstream>
 
 
@@ -32,6 +34,73 @@
 #include <unistd.h>
 #endif
 
+static std::string perfError;
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+static int perfFds[perfCountersCount] = {-1, -1, -1, -1, -1};
+
+static int openPerfCounter(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1; // Count also threads created later
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    if (fd < 0 && perfError.empty()) perfError = std::strerror(errno);
+    return fd;
+}
+
+static double readPerfCounter(int fd) {
+    if (fd < 0) return -1;
+    uint64_t values[3]; // Value, time enabled, time running
+    if (read(fd, values, sizeof(values)) != sizeof(values)) return -1;
+
+    // Scale the value if the counter was multiplexed with other events, never scheduled counter is not available
+    if (values[2] == 0) return -1;
+    return static_cast<double>(values[0]) * values[1] / values[2];
+}
+#endif
+
+int enablePerfCounters() {
+    int available = 0;
+#ifdef __linux__
+    const uint64_t cacheMiss = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    if (perfFds[perfInstructions] < 0) perfFds[perfInstructions] = openPerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    if (perfFds[perfCycles] < 0) perfFds[perfCycles] = openPerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    if (perfFds[perfLLCMisses] < 0) perfFds[perfLLCMisses] = openPerfCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cacheMiss);
+    if (perfFds[perfDTLBMisses] < 0) perfFds[perfDTLBMisses] = openPerfCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | cacheMiss);
+    if (perfFds[perfBranchMisses] < 0) perfFds[perfBranchMisses] = openPerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    for (auto fd : perfFds) available += fd >= 0;
+#else
+    perfError = "not supported on this platform";
+#endif
+    return available;
+}
+
+std::string perfCountersError() {
+    return perfError;
+}
+
+std::string perfCounterName(int counter) {
+    switch (counter) {
+        case perfInstructions: return "Instructions";
+        case perfCycles: return "Cycles";
+        case perfLLCMisses: return "LLC misses";
+        case perfDTLBMisses: return "dTLB misses";
+        case perfBranchMisses: return "Branch misses";
+        default: return "";
+    }
+}
+
 #ifdef _WIN32
 #include <windows.h>
 #endif
@@ -51,6 +120,11 @@ Resources getResources() {
     rc.dataMemory = 0;
     rc.stackMemory = 0;
 
+    for (int i = 0; i < perfCountersCount; ++i) rc.perfCounters[i] = -1;
+#ifdef __linux__
+    for (int i = 0; i < perfCountersCount; ++i) rc.perfCounters[i] = readPerfCounter(perfFds[i]);
+#endif
+
     // Time - TODO: Windows
 #if defined(__linux__) || defined(__APPLE__)
     const long ticks = sysconf(_SC_CLK_TCK);
@@ -23,8 +23,18 @@
 // Time & resources utils
 
 #include <chrono>
+#include <string>
 #include <thread>
 
+// Hardware performance counters
+enum PerfCounter {
+    perfInstructions,
+    perfCycles,
+    perfLLCMisses,
+    perfDTLBMisses,
+    perfBranchMisses,
+    perfCountersCount
+};
 
 struct Resources {
     std::chrono::steady_clock::time_point timePoint;
@@ -37,11 +47,19 @@ struct Resources {
     double peakVirtualMem;
     double dataMemory;
     double stackMemory;
+    double perfCounters[perfCountersCount]; // Values of enabled performance counters, -1 if not available
 };
 
 // Returns Resources structure
 Resources getResources();
 
+// Opens performance counters (Linux perf events) for the process and all threads created after this call,
+// so it should be called before any threads are started. Returns the number of available counters,
+// counters may be unavailable e.g. in containers or due to kernel.perf_event_paranoid setting.
+int enablePerfCounters();
+std::string perfCountersError();
+std::string perfCounterName(int counter);
+
 // Returns number of available cpus
 int getCpuCount();
 
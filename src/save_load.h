@@ -21,7 +21,10 @@
  */
 
 #pragma once
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 // Simple save/load utils
 class FileHelper {
@@ -48,3 +51,81 @@ inline void loadVar(std::ifstream& in, std::string& var) {
     var.resize(size);
     in.read((char*)&var[0], size);
 }
+
+// Compact coding utils, used by the compact weights format
+inline void saveVarint(std::vector<uint8_t>& out, uint64_t var) {
+    while (var >= 0x80) {
+        out.push_back(static_cast<uint8_t>(var) | 0x80);
+        var >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(var));
+}
+
+inline uint64_t loadVarint(const uint8_t*& in) {
+    uint64_t var = *in & 0x7f;
+    for (int shift = 7; *in++ & 0x80; shift += 7) var |= static_cast<uint64_t>(*in & 0x7f) << shift;
+    return var;
+}
+
+// Float to 16-bit floats conversions with rounding to nearest even
+inline uint16_t floatToHalf(float var) {
+    uint32_t x;
+    std::memcpy(&x, &var, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    int exp = static_cast<int>((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+
+    if (((x >> 23) & 0xff) == 0xff) return sign | 0x7c00 | (mant ? 0x200 : 0); // Inf or NaN
+    if (exp >= 0x1f) return sign | 0x7c00; // Overflow to Inf
+    if (exp <= 0) { // Subnormal or zero
+        if (exp < -10) return sign;
+        mant |= 0x800000;
+        int shift = 14 - exp;
+        uint32_t half = mant >> shift;
+        uint32_t rest = mant & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rest > mid || (rest == mid && (half & 1))) ++half;
+        return sign | half;
+    }
+
+    uint32_t half = (exp << 10) | (mant >> 13);
+    uint32_t rest = mant & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half; // Carry may round up to Inf, which is correct
+    return sign | half;
+}
+
+inline float halfToFloat(uint16_t var) {
+    uint32_t sign = static_cast<uint32_t>(var & 0x8000) << 16;
+    uint32_t exp = (var >> 10) & 0x1f;
+    uint32_t mant = var & 0x3ff;
+    uint32_t x;
+    if (exp == 0x1f) x = sign | 0x7f800000 | (mant << 13); // Inf or NaN
+    else if (exp != 0) x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    else if (mant == 0) x = sign;
+    else { // Subnormal, normalize it
+        exp = 127 - 15 + 1;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            --exp;
+        }
+        x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+inline uint16_t floatToBFloat16(float var) {
+    uint32_t x;
+    std::memcpy(&x, &var, sizeof(x));
+    if ((x & 0x7fffffff) > 0x7f800000) return static_cast<uint16_t>((x >> 16) | 0x40); // Keep NaN a NaN
+    x += 0x7fff + ((x >> 16) & 1);
+    return static_cast<uint16_t>(x >> 16);
+}
+
+inline float bfloat16ToFloat(uint16_t var) {
+    uint32_t x = static_cast<uint32_t>(var) << 16;
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
@@ -0,0 +1,101 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "siblings_block.h"
+
+
+SiblingsBlock* SiblingsBlock::pack(const std::vector<Base*>& bases, Real minFill) {
+    int k = bases.size();
+    size_t maxSize = 0;
+    unsigned long long nonZero = 0;
+    UnorderedMap<int, int> rows;
+    for (auto& b : bases) {
+        AbstractVector* W = b->getW();
+        if (b->isDummy() || W == nullptr) continue;
+        maxSize = std::max(maxSize, W->size());
+        W->forEachIV([&](const int& i, Real& v) {
+            rows.insert({i, static_cast<int>(rows.size())});
+            ++nonZero;
+        });
+    }
+
+    // Dense block doesn't need a lookup of rows, so it's preferred if it's not much larger
+    bool dense = nonZero >= minFill * maxSize * k;
+    if (!dense && nonZero < minFill * rows.size() * k) return nullptr;
+
+    auto block = new SiblingsBlock();
+    block->k = k;
+    block->dense = dense;
+    block->rowsCount = dense ? maxSize : rows.size();
+    block->W.resize(block->rowsCount * k, 0);
+    if (!dense) block->rows = std::move(rows);
+
+    SparseVector empty;
+    for (int c = 0; c < k; ++c) {
+        Base* b = bases[c];
+        AbstractVector* W = b->getW();
+        bool dummy = b->isDummy() || W == nullptr;
+        block->signs.push_back(b->getFirstClass() == 0 ? -1 : 1);
+        block->biases.push_back(dummy ? b->predictValue(empty) : 0);
+        block->losses.push_back(b->getLoss());
+        if (dummy) continue;
+
+        W->forEachIV([&](const int& i, Real& v) {
+            size_t r = dense ? i : block->rows[i];
+            block->W[r * k + c] = v;
+        });
+    }
+
+    return block;
+}
+
+void SiblingsBlock::predictValues(SparseVector& features, Real* values) const {
+    std::fill(values, values + k, 0);
+    for (auto& f : features) {
+        const Real* r = row(f.index);
+        if (r == nullptr) continue;
+        for (int c = 0; c < k; ++c) values[c] += f.value * r[c];
+    }
+    for (int c = 0; c < k; ++c) values[c] = values[c] * signs[c] + biases[c];
+}
+
+Real SiblingsBlock::predictValue(int column, SparseVector& features) const {
+    Real val = 0;
+    for (auto& f : features) {
+        const Real* r = row(f.index);
+        if (r != nullptr) val += f.value * r[column];
+    }
+    return val * signs[column] + biases[column];
+}
+
+unsigned long long SiblingsBlock::mem() const {
+    unsigned long long mem = sizeof(SiblingsBlock) + W.capacity() * sizeof(Real)
+                             + (signs.capacity() + biases.capacity()) * sizeof(Real) + losses.capacity() * sizeof(LossType);
+    if (!dense) {
+        size_t mapSize = sizeof(uint64_t);
+        while (mapSize < rows.size()) mapSize *= 2;
+        mem += mapSize * (2 * sizeof(int) + 1);
+    }
+    return mem;
+}
@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "base.h"
+#include "basic_types.h"
+#include "vector.h"
+
+
+// Weights of sibling nodes packed into one feature-major block, a row of each feature keeps weights of all siblings,
+// so all of them are evaluated with a single pass over example's features.
+class SiblingsBlock {
+public:
+    // Returns nullptr if less than minFill of the block's weights would be non-zero
+    static SiblingsBlock* pack(const std::vector<Base*>& bases, Real minFill);
+
+    // Same values as Base::predictValue of the packed bases
+    void predictValues(SparseVector& features, Real* values) const;
+    Real predictValue(int column, SparseVector& features) const;
+
+    inline Real toProbability(int column, Real value) const { return Base::valueToProbability(value, losses[column]); }
+    inline Real predictProbability(int column, SparseVector& features) const {
+        return toProbability(column, predictValue(column, features));
+    }
+
+    inline int size() const { return k; }
+    inline bool isDense() const { return dense; }
+    unsigned long long mem() const;
+
+private:
+    int k;
+    bool dense; // Rows of dense blocks are indexed directly by features
+    size_t rowsCount;
+    std::vector<Real> W; // rowsCount x k
+    UnorderedMap<int, int> rows; // Feature to row index, for sparse blocks
+
+    // Per column (base) values
+    std::vector<Real> signs;
+    std::vector<Real> biases; // Constant values of dummy bases
+    std::vector<LossType> losses;
+
+    inline const Real* row(int index) const {
+        if (dense) return index < rowsCount ? W.data() + static_cast<size_t>(index) * k : nullptr;
+        auto r = rows.find(index);
+        return r != rows.end() ? W.data() + static_cast<size_t>(r->second) * k : nullptr;
+    }
+};
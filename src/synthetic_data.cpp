@@ -0,0 +1,264 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <numeric>
+
+#include "log.h"
+#include "misc.h"
+#include "read_data.h"
+#include "synthetic_data.h"
+#include "threads.h"
+
+
+// Average size of clusters of co-occurring labels
+const int labelsPerCluster = 32;
+
+// Fraction of features that are not related to the labels
+const double noiseFeatures = 0.2;
+
+// Mixing function of SplitMix64, used for seeding and hashing
+inline uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+inline double toUnit(uint64_t x) { return static_cast<double>(x >> 11) * 0x1.0p-53; }
+
+// Small generator that is cheap to seed for every row, unlike std distributions
+// its results are the same with every standard library
+class RowRng {
+public:
+    RowRng(uint64_t seed): state(seed) { }
+
+    inline uint64_t next() {
+        state += 0x9E3779B97F4A7C15ULL;
+        return mix64(state);
+    }
+
+    inline double uniform() { return toUnit(next()); }
+
+    inline int uniformInt(int n) { return static_cast<int>(uniform() * n); }
+
+    int poisson(double mean) {
+        if (mean <= 0) return 0;
+        if (mean > 64) { // Normal approximation
+            double g = std::sqrt(-2.0 * std::log(1.0 - uniform())) * std::cos(2.0 * M_PI * uniform());
+            return std::max(0, static_cast<int>(std::round(mean + std::sqrt(mean) * g)));
+        }
+        double l = std::exp(-mean), p = uniform();
+        int k = 0;
+        while (p > l) {
+            p *= uniform();
+            ++k;
+        }
+        return k;
+    }
+
+private:
+    uint64_t state;
+};
+
+// Inverse CDF of the continuous approximation of Zipf distribution with exponent s over n ranks
+inline int zipfRank(double u, int n, double s) {
+    double x;
+    if (std::abs(s - 1.0) < 1e-6) x = std::exp(u * std::log(n + 1.0));
+    else x = std::pow(1.0 + u * (std::pow(n + 1.0, 1.0 - s) - 1.0), 1.0 / (1.0 - s));
+    return std::min(n - 1, std::max(0, static_cast<int>(x) - 1));
+}
+
+// Multiplier of bijection rank -> (rank * a + b) mod n, used to not order indices by frequency
+int permutationMultiplier(int n, uint64_t seed) {
+    if (n <= 2) return 1;
+    int a = static_cast<int>(mix64(seed) % (n - 1)) + 1;
+    while (std::gcd(a, n) != 1) a = a % (n - 1) + 1;
+    return a;
+}
+
+inline int permute(int rank, int n, int a, int b) {
+    return static_cast<int>((static_cast<long long>(rank) * a + b) % n);
+}
+
+SyntheticDataGenerator::SyntheticDataGenerator(Args& args): args(args) {
+    rows = args.genRows;
+    labelsCount = args.genLabels;
+    featuresCount = args.genFeatures;
+    if (rows < 0 || labelsCount < 1 || featuresCount < 1)
+        throw std::invalid_argument("Number of rows cannot be negative, numbers of labels and features have to be positive");
+    if (args.genLabelsPerRow < 1 || args.genFeaturesPerRow < 1)
+        throw std::invalid_argument("Average numbers of labels and features per row have to be at least 1");
+
+    // Each label has its own pool of informative features
+    labelFeatures = std::max(10, static_cast<int>(2 * args.genFeaturesPerRow));
+
+    // Labels that co-occur are grouped into random clusters of similar size, ordered by label frequency
+    int clustersCount = std::max(1, labelsCount / labelsPerCluster);
+    labelCluster.resize(labelsCount);
+    clusters.resize(clustersCount);
+    for (int l = 0; l < labelsCount; ++l) {
+        labelCluster[l] = static_cast<int>(mix64(args.seed ^ mix64(l)) % clustersCount);
+        clusters[labelCluster[l]].push_back(l);
+    }
+
+    labelsA = permutationMultiplier(labelsCount, args.seed + 1);
+    labelsB = static_cast<int>(mix64(args.seed + 2) % labelsCount);
+    featuresA = permutationMultiplier(featuresCount, args.seed + 3);
+    featuresB = static_cast<int>(mix64(args.seed + 4) % featuresCount);
+}
+
+void SyntheticDataGenerator::generateRow(std::vector<IRVPair>& rLabels, std::vector<IRVPair>& rFeatures, long long row) {
+    RowRng rng(mix64(static_cast<uint64_t>(args.seed) * 0x9E3779B97F4A7C15ULL + row));
+    size_t fStart = rFeatures.size();
+
+    // Labels are sampled as ranks, the first one from the power-law distribution
+    // and the next ones from the cluster of the first one with cooccurrence probability
+    std::vector<int> ranks;
+    int labelsPerRow = std::min(labelsCount, 1 + rng.poisson(args.genLabelsPerRow - 1));
+    int first = zipfRank(rng.uniform(), labelsCount, args.genLabelsPower);
+    auto& cluster = clusters[labelCluster[first]];
+    ranks.push_back(first);
+    for (int i = 0; ranks.size() < labelsPerRow && i < 4 * labelsPerRow; ++i) {
+        int rank;
+        if (rng.uniform() < args.genCooccurrence)
+            rank = cluster[zipfRank(rng.uniform(), cluster.size(), args.genLabelsPower)];
+        else rank = zipfRank(rng.uniform(), labelsCount, args.genLabelsPower);
+        if (std::find(ranks.begin(), ranks.end(), rank) == ranks.end()) ranks.push_back(rank);
+    }
+
+    // Features are sampled from pools of row's labels or as a noise from the power-law distribution,
+    // pools are also drawn from power-law distribution, so the most frequent features are shared between labels
+    std::vector<int> fRanks;
+    int featuresPerRow = 1 + rng.poisson(args.genFeaturesPerRow - 1);
+    for (int i = 0; i < featuresPerRow; ++i) {
+        uint64_t h;
+        if (rng.uniform() < noiseFeatures) h = rng.next();
+        else h = mix64(mix64(args.seed ^ mix64(ranks[rng.uniformInt(ranks.size())])) + rng.uniformInt(labelFeatures));
+        fRanks.push_back(zipfRank(toUnit(h), featuresCount, args.genFeaturesPower));
+    }
+    std::sort(fRanks.begin(), fRanks.end());
+
+    // TF-IDF like values with unit norm, IDF is estimated from the rank of the feature
+    Real norm = 0;
+    for (int i = 0; i < fRanks.size();) {
+        int j = i;
+        while (j < fRanks.size() && fRanks[j] == fRanks[i]) ++j;
+        Real tf = 1 + std::log(static_cast<Real>(j - i));
+        Real idf = 1 + args.genFeaturesPower * std::log(static_cast<Real>(fRanks[i] + 1));
+        rFeatures.emplace_back(permute(fRanks[i], featuresCount, featuresA, featuresB), tf * idf);
+        norm += tf * idf * tf * idf;
+        i = j;
+    }
+    norm = std::sqrt(norm);
+    for (auto f = rFeatures.begin() + fStart; f != rFeatures.end(); ++f) f->value /= norm;
+    std::sort(rFeatures.begin() + fStart, rFeatures.end(), IRVPairIndexComp());
+
+    for (auto& r : ranks) rLabels.emplace_back(permute(r, labelsCount, labelsA, labelsB), 1.0);
+    std::sort(rLabels.begin(), rLabels.end(), IRVPairIndexComp());
+}
+
+void SyntheticDataGenerator::generateRows(SRMatrix& labels, SRMatrix& features, long long start, int count) {
+    std::vector<IRVPair> rLabels;
+    std::vector<IRVPair> rFeatures;
+    for (long long r = start; r < start + count; ++r) {
+        rLabels.clear();
+        rFeatures.clear();
+        if (args.processData) prepareFeaturesVector(rFeatures, args.bias);
+        generateRow(rLabels, rFeatures, r);
+        if (args.processData) processFeaturesVector(rFeatures, args.norm, args.hash, args.featuresThreshold, args.hashSign);
+
+        labels.appendRow(rLabels);
+        features.appendRow(rFeatures);
+    }
+}
+
+void SyntheticDataGenerator::generate(SRMatrix& labels, SRMatrix& features) {
+    Log(CERR) << "Generating " << rows << " rows of synthetic data ...\n";
+    generateRows(labels, features, 0, rows);
+}
+
+void SyntheticDataGenerator::generateRowsText(std::string& text, long long start, int count) {
+    std::vector<IRVPair> rLabels;
+    std::vector<IRVPair> rFeatures;
+    char buffer[32];
+    for (long long r = start; r < start + count; ++r) {
+        rLabels.clear();
+        rFeatures.clear();
+        generateRow(rLabels, rFeatures, r);
+
+        for (int i = 0; i < rLabels.size(); ++i) {
+            if (i > 0) text += ',';
+            text.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), rLabels[i].index).ptr);
+        }
+        for (auto& f : rFeatures) {
+            text += ' ';
+            text.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), f.index).ptr);
+            text += ':';
+            text.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), f.value, std::chars_format::general, 4).ptr);
+        }
+        text += '\n';
+    }
+}
+
+void SyntheticDataGenerator::save(const std::string& outfile) {
+    Log(CERR) << "Generating " << rows << " rows of synthetic data to: " << outfile << "\n";
+
+    std::ofstream out(outfile);
+    if (!out.is_open())
+        throw std::invalid_argument("Cannot open output file: " + outfile);
+
+    // Header as in the XMLC repository format
+    out << rows << " " << featuresCount << " " << labelsCount << "\n";
+
+    // Chunks are generated in parallel and written in order, the number of chunks in flight is limited to bound memory
+    const int chunkRows = 10000;
+    int chunks = (rows + chunkRows - 1) / chunkRows;
+    int threads = std::max(1, args.threads);
+    ThreadPool tPool(threads);
+    std::deque<std::future<std::string>> pending;
+    int nextChunk = 0;
+    for (int c = 0; c < chunks; ++c) {
+        while (nextChunk < chunks && pending.size() < 2 * threads) {
+            long long start = static_cast<long long>(nextChunk) * chunkRows;
+            int count = std::min<long long>(chunkRows, rows - start);
+            pending.push_back(tPool.enqueue([this, start, count]() {
+                std::string text;
+                generateRowsText(text, start, count);
+                return text;
+            }));
+            ++nextChunk;
+        }
+
+        out << pending.front().get();
+        pending.pop_front();
+        printProgress(c, chunks);
+    }
+
+    out.close();
+    if (!out) throw std::runtime_error("Failed to write output file: " + outfile);
+    Log(CERR) << "  Done\n";
+}
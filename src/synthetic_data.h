@@ -0,0 +1,66 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "args.h"
+#include "basic_types.h"
+#include "matrix.h"
+
+// Generator of synthetic multi-label data shaped like extreme classification datasets:
+// power-law label frequencies, co-occurring labels, and sparse TF-IDF-like features
+// drawn from power-law distributed vocabulary, with more frequent features shared between labels.
+// Each row is generated by its own rng seeded with args.seed and row index,
+// so the generated data does not depend on the number of threads or chunks.
+class SyntheticDataGenerator {
+public:
+    SyntheticDataGenerator(Args& args);
+
+    // Generates a single row, features and labels indices are not shifted (as in a data file)
+    void generateRow(std::vector<IRVPair>& rLabels, std::vector<IRVPair>& rFeatures, long long row);
+
+    // Appends rows [start, start + count) processed in the same way as by readData
+    void generateRows(SRMatrix& labels, SRMatrix& features, long long start, int count);
+    void generate(SRMatrix& labels, SRMatrix& features);
+
+    // Writes data in the LibSVM/XMLC repository format, rows are generated in parallel
+    void save(const std::string& outfile);
+
+private:
+    Args& args;
+    int rows;
+    int labelsCount;
+    int featuresCount;
+    int labelFeatures;
+    std::vector<int> labelCluster;
+    std::vector<std::vector<int>> clusters;
+
+    // Permutations of labels and features ranks
+    int labelsA, labelsB;
+    int featuresA, featuresB;
+
+    void generateRowsText(std::string& text, long long start, int count);
+};
@@ -21,6 +21,8 @@
 #include <functional>
 #include <stdexcept>
 
+#include "misc.h"
+
 
 // Simple pool of threads
 class ThreadPool {
@@ -86,7 +88,11 @@ auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::res
         // Don't allow enqueueing after stopping the pool
         if(stop) throw std::runtime_error("Enqueue on stopped ThreadPool!");
 
-        tasks.emplace([task](){ (*task)(); });
+        std::atomic<bool>* interruptFlag = getInterruptFlag();
+        tasks.emplace([task, interruptFlag](){
+            setInterruptFlag(interruptFlag);
+            (*task)();
+        });
     }
     condition.notify_one();
     return res;
@@ -132,7 +138,11 @@ auto ThreadSet::add(F&& f, Args&&... args) -> std::future<typename std::result_o
         );
 
     std::future<return_type> res = task->get_future();
-    workers.push_back(std::thread([task](){ (*task)(); }));
+    std::atomic<bool>* interruptFlag = getInterruptFlag();
+    workers.push_back(std::thread([task, interruptFlag](){
+        setInterruptFlag(interruptFlag);
+        (*task)();
+    }));
     return res;
 }
 
@@ -141,3 +151,36 @@ inline void ThreadSet::joinAll(){
         worker.join();
     workers.clear();
 }
+
+
+// Simple sliding window, blocks threads that work on items too far ahead of the first unfinished one
+class SlidingWindow {
+public:
+    SlidingWindow(size_t size): size(size), finished(0) { };
+
+    void waitFor(size_t i);
+    void advance();
+
+private:
+    size_t size;
+    size_t finished;
+
+    // Synchronization
+    std::mutex mtx;
+    std::condition_variable condition;
+};
+
+// Blocks until i-th item is in the window
+inline void SlidingWindow::waitFor(size_t i){
+    std::unique_lock<std::mutex> lock(mtx);
+    condition.wait(lock, [this, i]{ return i < finished + size; });
+}
+
+// Marks first unfinished item as finished
+inline void SlidingWindow::advance(){
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        ++finished;
+    }
+    condition.notify_all();
+}
@@ -131,6 +131,80 @@ void AbstractVector::skipLoad(std::ifstream& in){
     else in.seekg(s * sizeof(Real), std::ios::cur);
 }
 
+void AbstractVector::saveCompact(std::vector<uint8_t>& out, WeightsPrecision precision) {
+    checkD();
+
+    // Indices have to be ordered for delta coding
+    std::vector<IRVPair> values;
+    values.reserve(n0);
+    forEachIV([&](const int& i, Real& v) {
+        if(v != 0) values.push_back({i, v});
+    });
+    if(type() == map) std::sort(values.begin(), values.end(), IRVPairIndexComp());
+
+    saveVarint(out, s);
+    saveVarint(out, values.size());
+    int prev = -1;
+    for (auto& v : values) {
+        saveVarint(out, v.index - prev - 1);
+        prev = v.index;
+    }
+
+    size_t offset = out.size();
+    if(precision == fp32) {
+        out.resize(offset + values.size() * sizeof(float));
+        for (auto& v : values) {
+            float f = v.value;
+            std::memcpy(&out[offset], &f, sizeof(f));
+            offset += sizeof(f);
+        }
+    } else {
+        out.resize(offset + values.size() * sizeof(uint16_t));
+        for (auto& v : values) {
+            uint16_t h = (precision == fp16) ? floatToHalf(v.value) : floatToBFloat16(v.value);
+            std::memcpy(&out[offset], &h, sizeof(h));
+            offset += sizeof(h);
+        }
+    }
+}
+
+void AbstractVector::loadCompact(const uint8_t*& in, WeightsPrecision precision) {
+    s = loadVarint(in);
+    size_t n0ToLoad = loadVarint(in);
+
+    initD(); // Re-init data container
+    reserve(n0ToLoad);
+
+    // Indices are decoded to a buffer first, values follow all of them
+    std::vector<int> indices(n0ToLoad);
+    int index = -1;
+    for (auto& i : indices) {
+        index += loadVarint(in) + 1;
+        i = index;
+    }
+
+    if(precision == fp32) {
+        float value;
+        for (auto i : indices) {
+            std::memcpy(&value, in, sizeof(value));
+            in += sizeof(value);
+            insertD(i, value);
+        }
+    } else {
+        uint16_t value;
+        for (auto i : indices) {
+            std::memcpy(&value, in, sizeof(value));
+            in += sizeof(value);
+            insertD(i, (precision == fp16) ? halfToFloat(value) : bfloat16ToFloat(value));
+        }
+    }
+}
+
+void AbstractVector::peekCompact(const uint8_t* in, size_t& s, size_t& n0) {
+    s = loadVarint(in);
+    n0 = loadVarint(in);
+}
+
 Real MapVector::dot(SparseVector& vec) const {
     Real val = 0;
     for(auto &f : vec) val += f.value * at(f.index);
@@ -144,10 +218,7 @@ Real MapVector::dot(Feature* vec) const {
 }
 
 Real Vector::dot(Vector& vec) const {
-    size_t minS = std::min(s, vec.s);
-    Real val = 0;
-    for(size_t i = 0; i < minS; ++i) val += d[i] * vec.d[i];
-    return val;
+    return dotVectors(d, vec.d, std::min(s, vec.s));
 }
 
 Real Vector::dot(SparseVector& vec) const {
@@ -42,12 +42,28 @@ template <typename T> inline Real dotVectors(Feature* vector1, T* vector2) { //
     return val;
 }
 
-template <typename T> inline Real dotVectors(T* vector1, T* vector2, const size_t size) {
+// Dense vector dot dense vector, partial sums are kept in separate lanes, so the compiler can vectorize the loop
+template <typename T> inline Real dotVectors(const T* __restrict vector1, const T* __restrict vector2, const size_t size) {
+    constexpr size_t lanes = 8;
+    Real sums[lanes] = {0};
+    size_t i = 0;
+    for(; i + lanes <= size; i += lanes)
+        for(size_t l = 0; l < lanes; ++l) sums[l] += vector1[i + l] * vector2[i + l];
+
     Real val = 0;
-    for(size_t i = 0; i < size; ++i) val += vector1[i] * vector2[i];
+    for(size_t l = 0; l < lanes; ++l) val += sums[l];
+    for(; i < size; ++i) val += vector1[i] * vector2[i];
     return val;
 }
 
+// Dot products of all pairs of dense rows, result[i * bRows + j] = a[i] . b[j].
+// Rows of b are reused for every row of a, so for a small bRows they stay in cache.
+template <typename T> inline void dotRows(const T* const* a, const size_t aRows, const T* const* b, const size_t bRows,
+                                         const size_t size, Real* result) {
+    for(size_t i = 0; i < aRows; ++i)
+        for(size_t j = 0; j < bRows; ++j) result[i * bRows + j] = dotVectors(a[i], b[j], size);
+}
+
 template <typename T> inline Real dotVectors(T& vector1, T& vector2) {
     assert(vector1.size() == vector2.size());
     return dotVectors(vector1.data(), vector2.data(), vector2.size());
@@ -84,8 +100,8 @@ template <typename T> inline void setVectorToZeros(Feature* vector1, T& vector2)
 
 
 // Add values of vector 1 to vector 2 multiplied by scalar
-template <typename T> inline void addVector(T* vector1, Real scalar, T* vector2, const size_t size) {
-    for(int i = 0; i < size; ++i) vector2[i] += vector1[i] * scalar;
+template <typename T> inline void addVector(const T* __restrict vector1, Real scalar, T* __restrict vector2, const size_t size) {
+    for(size_t i = 0; i < size; ++i) vector2[i] += vector1[i] * scalar;
 }
 
 template <typename T> inline void addVector(T& vector1, Real scalar, T& vector2) {
@@ -250,6 +266,11 @@ public:
     virtual void load(std::ifstream& in);
     static void skipLoad(std::ifstream& in);
 
+    // Compact coding: size and non-zero count as varints, delta coded indices and values in given precision
+    void saveCompact(std::vector<uint8_t>& out, WeightsPrecision precision);
+    virtual void loadCompact(const uint8_t*& in, WeightsPrecision precision);
+    static void peekCompact(const uint8_t* in, size_t& s, size_t& n0);
+
     virtual RepresentationType type() const = 0;
 
     friend std::ostream& operator<<(std::ostream& os, const AbstractVector& vec) {
@@ -457,6 +478,11 @@ public:
         sort();
     }
 
+    void loadCompact(const uint8_t*& in, WeightsPrecision precision) override {
+        AbstractVector::loadCompact(in, precision);
+        sort();
+    }
+
     bool isSorted() {
         return sorted;
     }
@@ -606,7 +632,7 @@ public:
         vec.forEachIV([&](const int& i, Real& v) { d[i] = v; });
     }
     ~Vector() override{
-        delete d;
+        delete[] d;
     }
 
     void initD() override {
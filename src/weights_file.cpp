@@ -0,0 +1,168 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#include "misc.h"
+#include "weights_file.h"
+
+static const char weightsMagic[4] = {'N', 'X', 'C', 'W'};
+static const int weightsVersion = 1;
+
+WeightsReader::WeightsReader(std::string infile) {
+    in.open(infile, std::ios::in | std::ios::binary);
+    if (!in.good()) throw std::invalid_argument("Cannot open weights file: " + infile);
+
+    char magic[4];
+    in.read(magic, sizeof(magic));
+    if (std::equal(magic, magic + sizeof(magic), weightsMagic)) {
+        int version, precision;
+        loadVar(in, version);
+        if (version > weightsVersion)
+            throw std::invalid_argument("Unsupported version " + std::to_string(version) + " of weights file: " + infile);
+        loadVar(in, basesCount);
+        loadVar(in, precision);
+        weightsFormat = compactWeights;
+        weightsPrecision = static_cast<WeightsPrecision>(precision);
+    } else { // Legacy file starts with the number of bases
+        std::memcpy(&basesCount, magic, sizeof(basesCount));
+        weightsFormat = legacyWeights;
+        weightsPrecision = fp32;
+    }
+    basesOffset = in.tellg();
+}
+
+void WeightsReader::read(Base& base, bool loadGrads, RepresentationType loadAs) {
+    if (weightsFormat == legacyWeights) {
+        base.load(in, loadGrads, loadAs);
+        return;
+    }
+
+    uint64_t blockSize;
+    loadVar(in, blockSize);
+    buffer.resize(blockSize);
+    in.read((char*)buffer.data(), blockSize);
+    if (!in) throw std::runtime_error("Weights file is truncated");
+    base.loadCompact(buffer.data(), weightsPrecision, loadAs);
+}
+
+void WeightsReader::skip() {
+    if (weightsFormat == legacyWeights) {
+        Base::skipLoad(in);
+        return;
+    }
+
+    uint64_t blockSize;
+    loadVar(in, blockSize);
+    in.seekg(blockSize, std::ios::cur);
+}
+
+std::vector<unsigned long long> WeightsReader::buildIndex() {
+    seek(basesOffset);
+    std::vector<unsigned long long> offsets;
+    offsets.reserve(basesCount + 1);
+    for (int i = 0; i < basesCount; ++i) {
+        offsets.push_back(in.tellg());
+        skip();
+    }
+    offsets.push_back(in.tellg());
+    if (!in.good()) throw std::runtime_error("Weights file is truncated");
+    seek(basesOffset);
+    return offsets;
+}
+
+void WeightsReader::seek(unsigned long long offset) {
+    in.clear();
+    in.seekg(offset);
+}
+
+void WeightsReader::close() {
+    in.close();
+}
+
+WeightsWriter::WeightsWriter(std::string outfile, int size, WeightsFormat format, WeightsPrecision precision):
+    weightsFormat(format), weightsPrecision(precision) {
+    out.open(outfile, std::ios::out | std::ios::binary);
+    if (weightsFormat == compactWeights) {
+        out.write(weightsMagic, sizeof(weightsMagic));
+        int version = weightsVersion;
+        int precisionValue = weightsPrecision;
+        saveVar(out, version);
+        saveVar(out, size);
+        saveVar(out, precisionValue);
+    } else saveVar(out, size);
+}
+
+void WeightsWriter::write(Base& base, bool saveGrads) {
+    if (weightsFormat == legacyWeights) {
+        base.save(out, saveGrads);
+        return;
+    }
+
+    buffer.clear();
+    base.saveCompact(buffer, weightsPrecision);
+    uint64_t blockSize = buffer.size();
+    saveVar(out, blockSize);
+    out.write((char*)buffer.data(), blockSize);
+}
+
+void WeightsWriter::close() {
+    out.close();
+}
+
+void convertWeights(std::string infile, std::string outfile, WeightsFormat format, WeightsPrecision precision) {
+    WeightsReader reader(infile);
+    int size = reader.size();
+    std::string tmpFile = outfile + ".tmp";
+    WeightsWriter writer(tmpFile, size, format, precision);
+    for (int i = 0; i < size; ++i) {
+        printProgress(i, size);
+        Base base;
+        reader.read(base, true);
+
+        // Compact format does not store gradients, converting would silently drop the state of AdaGrad
+        if (format != legacyWeights && base.getG() != nullptr) {
+            reader.close();
+            writer.close();
+            std::remove(tmpFile.c_str());
+            throw std::invalid_argument("Weights in " + infile + " contain gradients saved with --saveGrads, "
+                                        "which are not stored by compact weights format, "
+                                        "use legacy format to keep them for further training");
+        }
+        writer.write(base, true);
+    }
+    reader.close();
+    writer.close();
+    std::rename(tmpFile.c_str(), outfile.c_str());
+}
+
+std::vector<std::string> findWeightsFiles(std::string modelDir) {
+    std::vector<std::string> files;
+    for (auto& entry : std::filesystem::recursive_directory_iterator(modelDir)) {
+        std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && (name == "weights.bin" || name == "aux_weights.bin"))
+            files.push_back(entry.path().string());
+    }
+    return files;
+}
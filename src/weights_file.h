@@ -0,0 +1,80 @@
+/*
+ Copyright (c) 2021 by Marek Wydmuch
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "base.h"
+#include "enums.h"
+
+// Files with base estimators (weights.bin). Legacy files start with the number of bases followed by bases
+// saved with Base::save. Compact files start with a header ("NXCW" magic, version, number of bases, precision
+// of values), followed by blocks with bases saved with Base::saveCompact, each prefixed with its size.
+class WeightsReader {
+public:
+    explicit WeightsReader(std::string infile);
+
+    inline int size() const { return basesCount; }
+    inline WeightsFormat format() const { return weightsFormat; }
+    inline WeightsPrecision precision() const { return weightsPrecision; }
+
+    // Reads the next base
+    void read(Base& base, bool loadGrads = false, RepresentationType loadAs = map);
+    void skip();
+    void close();
+
+    // Returns offsets of all bases and the end of the file, compact files are indexed by reading only
+    // the sizes of blocks, legacy ones by reading only the headers of bases
+    std::vector<unsigned long long> buildIndex();
+    void seek(unsigned long long offset);
+
+private:
+    std::ifstream in;
+    unsigned long long basesOffset;
+    int basesCount;
+    WeightsFormat weightsFormat;
+    WeightsPrecision weightsPrecision;
+    std::vector<uint8_t> buffer;
+};
+
+class WeightsWriter {
+public:
+    WeightsWriter(std::string outfile, int size, WeightsFormat format = legacyWeights, WeightsPrecision precision = fp32);
+
+    void write(Base& base, bool saveGrads = false);
+    void close();
+
+private:
+    std::ofstream out;
+    WeightsFormat weightsFormat;
+    WeightsPrecision weightsPrecision;
+    std::vector<uint8_t> buffer;
+};
+
+// Rewrites weights file in the given format
+void convertWeights(std::string infile, std::string outfile, WeightsFormat format, WeightsPrecision precision);
+
+// Returns all files with base estimators of the model, also the ones of its shards and ensemble members
+std::vector<std::string> findWeightsFiles(std::string modelDir);